@@ -2,7 +2,11 @@
 
 precision highp float;
 
-uniform mat4 proj_modelview;
+// shared by all programs, see FRAME_UNIFORMS_BINDING
+layout(std140) uniform frame_uniforms
+{
+    mat4 proj_modelview;
+};
 
 layout(location=0) in vec2 position;
 layout(location=1) in vec4 color;
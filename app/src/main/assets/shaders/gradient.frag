@@ -0,0 +1,28 @@
+#version 300 es
+
+precision highp float;
+
+uniform vec3 from_color;
+uniform vec3 to_color;
+uniform vec2 center;
+uniform float falloff;
+
+// radial: to_color at the center, fading to from_color as falloff/distance
+// linear: to_color at the center, from_color at falloff units along axis
+uniform bool radial;
+uniform vec2 axis;
+
+in vec2 frag_position;
+
+out vec4 out_color;
+
+void main(void)
+{
+	vec2 d = frag_position - center;
+	float s;
+	if (radial)
+		s = min(falloff/length(d), 1.);
+	else
+		s = clamp(1. - dot(d, axis)/falloff, 0., 1.);
+	out_color = vec4(mix(from_color, to_color, s), 1.);
+}
@@ -0,0 +1,20 @@
+#version 300 es
+
+precision highp float;
+
+// shared by all programs, see FRAME_UNIFORMS_BINDING
+layout(std140) uniform frame_uniforms
+{
+    mat4 proj_modelview;
+};
+
+layout(location=0) in vec2 position;
+layout(location=1) in vec4 color;
+
+out vec2 frag_position;
+
+void main(void)
+{
+    gl_Position = proj_modelview*vec4(position, 0., 1.);
+    frag_position = position;
+}
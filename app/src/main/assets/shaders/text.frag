@@ -0,0 +1,19 @@
+#version 300 es
+
+precision highp float;
+
+uniform sampler2D tex;
+
+in vec2 frag_texcoord;
+in vec4 frag_color;
+
+out vec4 out_color;
+
+void main(void)
+{
+    float d = texture(tex, frag_texcoord).r;
+    float w = .7*fwidth(d);
+    float inner = smoothstep(.5 - w, .5 + w, d);
+    float outer = smoothstep(.25 - w, .25 + w, d);
+    out_color = vec4(vec3(inner), outer)*frag_color;
+}
@@ -12,7 +12,10 @@ out vec4 out_color;
 
 void main(void)
 {
-	vec4 texel = texture(tex, frag_texcoord);
-	vec4 color = mix(frag_color0, frag_color1, texel.r);
-	out_color = vec4(color.rgb, color.a*texel.a);
+	float d = texture(tex, frag_texcoord).r;
+	float w = .7*fwidth(d);
+	float inner = smoothstep(.5 - w, .5 + w, d);
+	float outer = smoothstep(.25 - w, .25 + w, d);
+	vec4 color = mix(frag_color0, frag_color1, inner);
+	out_color = vec4(color.rgb, color.a*outer);
 }
@@ -11,6 +11,8 @@ out vec4 out_color;
 
 void main(void)
 {
-    float v = texture(tex, frag_texcoord).a;
+    float d = texture(tex, frag_texcoord).r;
+    float w = .7*fwidth(d);
+    float v = smoothstep(.25 - w, .25 + w, d);
     out_color = vec4(frag_color.rgb, frag_color.a*v);
 }
@@ -2,69 +2,99 @@
 
 #include "action.h"
 
-void timed_action::step(int dt)
+action_group *action_group::add(abstract_action *action)
 {
-    cur_tic = std::min(cur_tic + dt, tics);
-    set_properties();
+    actions_.emplace_back(action);
+    return this;
 }
 
-bool timed_action::done() const
+int parallel_action_group::compile(timeline &t, int start) const
 {
-    return cur_tic == tics;
-}
+    int end = start;
 
-action_group *action_group::add(abstract_action *action)
-{
-    actions_.emplace_back(action);
-    return this;
+    for (auto &p : actions_)
+        end = std::max(end, p->compile(t, start));
+
+    return end;
 }
 
-void action_group::reset()
+int sequential_action_group::compile(timeline &t, int start) const
 {
     for (auto &p : actions_)
-        p->reset();
+        start = p->compile(t, start);
+
+    return start;
 }
 
-bool action_group::done() const
+timeline::timeline(const abstract_action &action)
 {
-    for (auto &p : actions_) {
-        if (!p->done())
-            return false;
-    }
+    add(action);
+}
 
-    return true;
+void timeline::add(const abstract_action &action)
+{
+    tics_ = std::max(tics_, action.compile(*this, 0));
 }
 
-void parallel_action_group::step(int dt)
+void timeline::add(int start, int tics, tween_kind tween, float *property, float from, float to)
 {
-    for (auto &p : actions_)
-        p->step(dt);
+    tracks_.push_back({start, tics, tween, property, from, to});
+    tics_ = std::max(tics_, start + tics);
 }
 
-void parallel_action_group::set_properties() const
+void timeline::clear()
 {
-    for (auto &p : actions_) {
-        if (!p->done())
-            p->set_properties();
-    }
+    tracks_.clear();
+    tics_ = cur_tic_ = 0;
 }
 
-void sequential_action_group::step(int dt)
+void timeline::step(int dt)
 {
-    for (auto &p : actions_) {
-        if (!p->done()) {
-            p->step(dt);
-            break;
-        }
-    }
+    const int prev_tic = cur_tic_;
+    cur_tic_ = std::min(cur_tic_ + dt, tics_);
+
+    step_tracks(tracks_.data(), tracks_.data() + tracks_.size(), prev_tic, cur_tic_);
 }
 
-void sequential_action_group::set_properties() const
+void timeline::step_tracks(const track *first, const track *last, int prev_tic, int cur_tic)
 {
-    for (auto &p : actions_) {
-        if (!p->done()) {
-            p->set_properties();
-            break;
+    for (const auto *q = first; q != last; ++q) {
+        const auto &p = *q;
+
+        // skip tracks that haven't started yet or that were already finished
+        // (and set to their final value) on a previous step; on the first
+        // step nothing was, and tracks of no length at tic 0 still apply
+        if (p.start > cur_tic || (prev_tic > 0 && p.start + p.tics <= prev_tic))
+            continue;
+
+        const float t = p.tics > 0 ? std::min(static_cast<float>(cur_tic - p.start) / p.tics, 1.f) : 1.f;
+
+        float &v = *p.property;
+
+        switch (p.tween) {
+            case tween_kind::linear:
+                v = linear_tween<float>()(p.from, p.to, t);
+                break;
+
+            case tween_kind::quadratic:
+                v = quadratic_tween<float>()(p.from, p.to, t);
+                break;
+
+            case tween_kind::in_cos:
+                v = in_cos_tween<float>()(p.from, p.to, t);
+                break;
+
+            case tween_kind::out_cos:
+                v = out_cos_tween<float>()(p.from, p.to, t);
+                break;
+
+            case tween_kind::in_back:
+                v = in_back_tween<float>()(p.from, p.to, t);
+                break;
+
+            case tween_kind::out_bounce:
+                v = out_bounce_tween<float>()(p.from, p.to, t);
+                break;
         }
     }
 }
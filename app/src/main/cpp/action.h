@@ -1,33 +1,36 @@
 #pragma once
 
-#include <vector>
+#include "tween.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <memory>
+#include <type_traits>
+#include <vector>
+
+class timeline;
+
+// Action trees are only used to describe an animation: compile them into a
+// timeline, which is what actually gets stepped.
 
 struct abstract_action
 {
     virtual ~abstract_action() {}
 
-    virtual void step(int dt) = 0;
-    virtual bool done() const = 0;
-
-    virtual void set_properties() const = 0; // XXX remove this later
-    virtual void reset() = 0;
+    // appends the tracks of this action to t, starting at time start, and
+    // returns the time at which the action ends
+    virtual int compile(timeline &t, int start) const = 0;
 };
 
 struct timed_action : abstract_action
 {
     timed_action(int tics)
         : tics(tics)
-        , cur_tic(0)
     {
     }
 
-    void step(int dt);
-    bool done() const;
-
-    void reset() { cur_tic = 0; }
-
-    int tics, cur_tic;
+    int tics;
 };
 
 struct delay_action : timed_action
@@ -37,9 +40,7 @@ struct delay_action : timed_action
     {
     }
 
-    void execute(float) const {}
-
-    void set_properties() const {}
+    int compile(timeline &, int start) const override { return start + tics; }
 };
 
 template <class tweening_functor>
@@ -47,6 +48,8 @@ struct property_change_action : timed_action
 {
     using type = typename tweening_functor::type;
 
+    static_assert(std::is_same<type, float>::value, "timelines only animate float properties");
+
     property_change_action(type *property, const type &from, const type &to, int tics)
         : timed_action(tics)
         , from(from)
@@ -55,35 +58,102 @@ struct property_change_action : timed_action
     {
     }
 
-    void set_properties() const
-    {
-        const float t = static_cast<float>(cur_tic) / tics;
-        *property = tweener(from, to, t);
-    }
+    int compile(timeline &t, int start) const override;
 
     type from, to;
     type *property;
-    tweening_functor tweener;
 };
 
 struct action_group : abstract_action
 {
     action_group *add(abstract_action *action);
 
-    bool done() const;
-    void reset();
-
     std::vector<std::unique_ptr<abstract_action>> actions_;
 };
 
 struct parallel_action_group : action_group
 {
-    void step(int dt);
-    void set_properties() const;
+    int compile(timeline &t, int start) const override;
 };
 
 struct sequential_action_group : action_group
 {
+    int compile(timeline &t, int start) const override;
+};
+
+// A flat list of tweens, each with an absolute start time. Tracks are
+// evaluated in the order they were added, so when two tracks animate the same
+// property the one added last wins.
+
+class timeline
+{
+public:
+    struct track
+    {
+        int start, tics;
+        tween_kind tween;
+        float *property;
+        float from, to;
+    };
+
+    timeline() = default;
+    explicit timeline(const abstract_action &action);
+
+    void add(const abstract_action &action);
+    void add(int start, int tics, tween_kind tween, float *property, float from, float to);
+
     void step(int dt);
-    void set_properties() const;
+    bool done() const { return cur_tic_ == tics_; }
+    void reset() { cur_tic_ = 0; }
+
+    void clear();
+    void reserve(size_t num_tracks) { tracks_.reserve(num_tracks); }
+
+    int get_tics() const { return tics_; }
+
+    // sets the properties of the tracks in [first, last) for going from
+    // prev_tic to cur_tic
+    static void step_tracks(const track *first, const track *last, int prev_tic, int cur_tic);
+
+private:
+    std::vector<track> tracks_;
+    int tics_ = 0;
+    int cur_tic_ = 0;
+};
+
+// A timeline with room for up to N tracks inline, for things spawned so
+// often that allocating the tracks would show.
+
+template <size_t N>
+class fixed_timeline
+{
+public:
+    void add(int start, int tics, tween_kind tween, float *property, float from, float to)
+    {
+        assert(num_tracks_ < N);
+        tracks_[num_tracks_++] = {start, tics, tween, property, from, to};
+        tics_ = std::max(tics_, start + tics);
+    }
+
+    void step(int dt)
+    {
+        const int prev_tic = cur_tic_;
+        cur_tic_ = std::min(cur_tic_ + dt, tics_);
+        timeline::step_tracks(tracks_.data(), tracks_.data() + num_tracks_, prev_tic, cur_tic_);
+    }
+
+    bool done() const { return cur_tic_ == tics_; }
+
+private:
+    std::array<timeline::track, N> tracks_;
+    size_t num_tracks_ = 0;
+    int tics_ = 0;
+    int cur_tic_ = 0;
 };
+
+template <class tweening_functor>
+int property_change_action<tweening_functor>::compile(timeline &t, int start) const
+{
+    t.add(start, tics, tweening_functor::kind, property, from, to);
+    return start + tics;
+}
@@ -2,9 +2,13 @@
 #include <errno.h>
 #include <unistd.h>
 
+#include <thread>
+
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include <android/choreographer.h>
+
 #include <android_native_app_glue.h>
 
 #include "log.h"
@@ -15,11 +19,17 @@
 const char *options_file_path = "options";
 const char *leaderboard_file_path = "hiscores";
 const char *jukugo_hits_file_path = "jukugo-hits";
+const char *save_file_path = "save";
+const char *program_cache_path = "program-cache";
 
 AAssetManager *g_asset_manager;
 
 static android_app *g_app;
 
+// how long to block waiting for network events when there's nothing to draw;
+// input and lifecycle events wake the looper up anyway
+static const int IDLE_POLL_MS = 100;
+
 void
 start_sound(int id, bool loop)
 {
@@ -98,6 +108,9 @@ public:
 	static void handle_cmd(android_app *app, int32_t cmd);
 
 private:
+	static void on_vsync(long frame_time_nanos, void *data);
+
+	void schedule_frame();
 	void draw_frame();
 	int32_t handle_input(AInputEvent *event);
 	void handle_cmd(int32_t cmd);
@@ -114,6 +127,10 @@ private:
 
 	int viewport_width_;
 	int viewport_height_;
+
+	AChoreographer *choreographer_;
+	bool frame_requested_;
+	bool frame_due_;
 };
 
 demo::demo(android_app *app)
@@ -123,6 +140,9 @@ demo::demo(android_app *app)
 , context_(EGL_NO_CONTEXT)
 , viewport_width_(0)
 , viewport_height_(0)
+, choreographer_(AChoreographer_getInstance())
+, frame_requested_(false)
+, frame_due_(false)
 {
 	app->userData = this;
 	app->onAppCmd = handle_cmd;
@@ -222,6 +242,25 @@ demo::init_display()
 	return true;
 }
 
+void
+demo::on_vsync(long, void *data)
+{
+	auto self = static_cast<demo *>(data);
+	self->frame_requested_ = false;
+	self->frame_due_ = true;
+}
+
+// frames start on the display's vsync, like a Choreographer.FrameCallback,
+// instead of whenever the previous eglSwapBuffers happens to return
+void
+demo::schedule_frame()
+{
+	if (!frame_requested_ && !frame_due_) {
+		AChoreographer_postFrameCallback(choreographer_, on_vsync, this);
+		frame_requested_ = true;
+	}
+}
+
 void
 demo::draw_frame()
 {
@@ -327,6 +366,9 @@ demo::handle_cmd(int32_t cmd)
 			if (app_->window != NULL) {
 				init_display();
 				kasui::get_instance().resize(viewport_width_, viewport_height_);
+
+				// simulate on another core while this thread talks to GL
+				kasui::get_instance().set_pipelined(std::thread::hardware_concurrency() > 1);
 			}
 			break;
 
@@ -353,12 +395,31 @@ demo::run()
 	bool running = true;
 
 	while (running) {
+		auto& k = kasui::get_instance();
+
+		// with nothing to draw, sleep until an event arrives; the vsync
+		// callback comes in through the looper like everything else
+		int timeout;
+		if (frame_due_) {
+			timeout = 0;
+		} else if (display_ == EGL_NO_DISPLAY) {
+			timeout = -1;
+		} else if (k.needs_redraw()) {
+			schedule_frame();
+			timeout = -1;
+		} else {
+			timeout = IDLE_POLL_MS;
+		}
+
 		int ident;
 		int events;
 		android_poll_source *source;
 
-		while ((ident = ALooper_pollAll(0, NULL, &events, reinterpret_cast<void **>(&source))) >= 0) {
-			if (source)
+		// not ALooper_pollAll(), which runs callbacks without returning and
+		// would keep sleeping after the vsync one made a frame due
+		while ((ident = ALooper_pollOnce(timeout, NULL, &events, reinterpret_cast<void **>(&source))) >= 0 ||
+		       ident == ALOOPER_POLL_CALLBACK) {
+			if (ident >= 0 && source)
 				source->process(app_, source);
 
 			if (app_->destroyRequested) {
@@ -366,12 +427,20 @@ demo::run()
 				running = false;
 				break;
 			}
+
+			// drain whatever else is pending, then draw if a frame is due
+			timeout = 0;
 		}
 
 		if (!running)
 			break;
 
-		draw_frame();
+		if (frame_due_) {
+			frame_due_ = false;
+			draw_frame();
+		} else if (display_ != EGL_NO_DISPLAY && !k.needs_redraw()) {
+			k.idle(0);
+		}
 	}
 
 	term_display();
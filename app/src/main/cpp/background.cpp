@@ -1,68 +1,103 @@
+#include <algorithm>
 #include <cassert>
 
-#include <guava2d/pixmap.h>
+#include <guava2d/program.h>
 #include <guava2d/rgb.h>
-#include <guava2d/texture_manager.h>
+#include <guava2d/vec2.h>
 
 #include "background.h"
 #include "common.h"
+#include "programs.h"
 #include "render.h"
 
-enum
+namespace {
+
+enum class gradient_shape
+{
+    LINEAR,
+    RADIAL,
+};
+
+// gradient geometry in window space, as fractions of the window size
+struct gradient_params
 {
-    GRADIENT_TEXTURE_WIDTH = 32,
-    GRADIENT_TEXTURE_HEIGHT = 64,
+    gradient_shape shape;
+    g2d::vec2 center;
+    float falloff; // fraction of window width
+    g2d::vec2 axis;
 };
 
-static g2d::texture *gradient_texture = nullptr;
+// bright spot off the top left corner
+const gradient_params background_params = {gradient_shape::RADIAL, {-.4f, 1.2f}, .5f, {0.f, 0.f}};
 
-void background_draw_gradient()
+struct gradient_colors
 {
-    render::set_blend_mode(blend_mode::NO_BLEND);
+    g2d::rgb from, to;
+};
+
+const g2d::program *gradient_program = nullptr;
+
+gradient_colors fade_start, fade_end;
+uint32_t fade_duration, fade_tics;
+
+gradient_colors cur_colors()
+{
+    if (fade_tics >= fade_duration)
+        return fade_end;
+
+    const float t = static_cast<float>(fade_tics) / fade_duration;
+    return {fade_start.from + (fade_end.from - fade_start.from) * t,
+            fade_start.to + (fade_end.to - fade_start.to) * t};
+}
 
-    const float du = 1. / GRADIENT_TEXTURE_WIDTH;
-    const float u0 = du;
-    const float u1 = 1. - du;
+} // namespace
 
-    const float dv = 1. / GRADIENT_TEXTURE_HEIGHT;
-    const float v0 = dv;
-    const float v1 = 1. - dv;
+void background_draw_gradient()
+{
+    assert(gradient_program);
+
+    const auto colors = cur_colors();
+    const auto &params = background_params;
+    const g2d::vec2 center(params.center.x * window_width, params.center.y * window_height);
+    const float falloff = params.falloff * window_width;
+
+    // uniforms stay put until the batch is drawn, nothing else uses this program
+    render::defer([colors, params, center, falloff] {
+        gradient_program->use();
+        gradient_program->set_uniform("from_color", colors.from);
+        gradient_program->set_uniform("to_color", colors.to);
+        gradient_program->set_uniform("center", center);
+        gradient_program->set_uniform_f("falloff", falloff);
+        gradient_program->set_uniform_i("radial", params.shape == gradient_shape::RADIAL);
+        gradient_program->set_uniform("axis", params.axis);
+    });
 
+    render::set_blend_mode(blend_mode::NO_BLEND);
     render::set_color({1.f, 1.f, 1.f, 1.f});
-    render::draw_quad(gradient_texture, {{0, 0}, {0, window_height}, {window_width, window_height}, {window_width, 0}},
-                      {{u0, v0}, {u0, v1}, {u1, v1}, {u1, v0}}, -100);
+    render::draw_quad(gradient_program, nullptr,
+                      {{0, 0}, {0, window_height}, {window_width, window_height}, {window_width, 0}}, {}, -100);
 }
 
 void background_initialize()
 {
-    gradient_texture =
-        new g2d::texture(new g2d::pixmap(GRADIENT_TEXTURE_WIDTH, GRADIENT_TEXTURE_HEIGHT, g2d::pixmap::RGB));
-    g2d::put_texture("gradient-texture", gradient_texture);
+    gradient_program = get_program(program::gradient);
 }
 
 void background_initialize_gradient(const g2d::rgb &from_color, const g2d::rgb &to_color)
 {
-    assert(gradient_texture);
-
-    const float x0 = -.4 * GRADIENT_TEXTURE_WIDTH;
-    const float y0 = 1.2 * GRADIENT_TEXTURE_HEIGHT;
-
-    uint8_t *bits = gradient_texture->get_pixmap()->get_bits();
-
-    for (int y = 0; y < GRADIENT_TEXTURE_HEIGHT; y++) {
-        for (int x = 0; x < GRADIENT_TEXTURE_WIDTH; x++) {
-            const float r = sqrtf((x - x0) * (x - x0) + (y - y0) * (y - y0));
-
-            float s = .5 * GRADIENT_TEXTURE_WIDTH / r;
-            if (s > 1)
-                s = 1;
+    fade_end = {from_color, to_color};
+    fade_duration = fade_tics = 0;
+}
 
-            g2d::rgb color = from_color + (to_color - from_color) * s;
-            *bits++ = color.r * 255;
-            *bits++ = color.g * 255;
-            *bits++ = color.b * 255;
-        }
-    }
+void background_fade_gradient(const g2d::rgb &from_color, const g2d::rgb &to_color, uint32_t duration)
+{
+    fade_start = cur_colors();
+    fade_end = {from_color, to_color};
+    fade_duration = duration;
+    fade_tics = 0;
+}
 
-    gradient_texture->upload_pixmap();
+void background_update(uint32_t dt)
+{
+    fade_tics = std::min(fade_tics + dt, fade_duration);
 }
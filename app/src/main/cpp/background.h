@@ -1,6 +1,8 @@
 #ifndef BACKGROUND_H_
 #define BACKGROUND_H_
 
+#include <cstdint>
+
 namespace g2d {
 class mat4;
 class rgb;
@@ -10,6 +12,11 @@ void background_draw_gradient();
 
 void background_initialize_gradient(const g2d::rgb &from_color, const g2d::rgb &to_color);
 
+// cross-fade from the current gradient colors over duration ms
+void background_fade_gradient(const g2d::rgb &from_color, const g2d::rgb &to_color, uint32_t duration);
+
+void background_update(uint32_t dt);
+
 void background_initialize();
 
 #endif // BACKGROUND_H_
@@ -2,7 +2,7 @@
 
 #include "world.h"
 
-class bakudan_sprite : public sprite
+class bakudan_sprite final : public sprite
 {
 public:
     bakudan_sprite(float x, float y);
@@ -5,13 +5,15 @@
 #include "settings.h"
 #include "fonts.h"
 
+#include "guava2d/xwchar.h"
+
 combo_sprite::combo_sprite(int combo_size, float x, float y, const gradient& g)
     : x_origin_(x)
     , y_origin_(y)
     , gradient_(g)
 {
-    combo_size_ = std::to_wstring(combo_size);
-    x_chain_text_ = get_font(font::large)->get_string_width(combo_size_.c_str()) + 12;
+    xswprintf(combo_size_, L"%d", combo_size);
+    x_chain_text_ = get_font(font::large)->get_string_width(combo_size_) + 12;
 }
 
 bool combo_sprite::update(uint32_t dt)
@@ -40,7 +42,7 @@ void combo_sprite::draw() const
     render::push_matrix();
     render::translate(x_origin_, y_origin_ + y_offset_);
 
-    render::draw_text(get_font(font::large), {}, 50, outline_color, text_color, combo_size_.c_str());
+    render::draw_text(get_font(font::large), {}, 50, outline_color, text_color, combo_size_);
     render::draw_text(get_font(font::small), {x_chain_text_, 16}, 50, outline_color, text_color, L"chain!");
 
     render::pop_matrix();
@@ -4,9 +4,8 @@
 #include "settings.h"
 #include "world.h"
 
-#include <string>
 
-class combo_sprite : public sprite
+class combo_sprite final : public sprite
 {
 public:
     combo_sprite(int combo_size, float x, float y, const gradient& g);
@@ -23,5 +22,5 @@ private:
     float x_chain_text_;
     gradient gradient_;
     int ttl_ = TTL;
-    std::wstring combo_size_;
+    wchar_t combo_size_[12];
 };
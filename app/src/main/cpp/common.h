@@ -24,6 +24,8 @@ extern bool practice_mode;
 extern const char *options_file_path;
 extern const char *leaderboard_file_path;
 extern const char *jukugo_hits_file_path;
+extern const char *save_file_path;
+extern const char *program_cache_path;
 
 struct options;
 extern options *cur_options;
@@ -23,6 +23,7 @@ public:
     void redraw() const;
     void update(uint32_t dt);
     void reset();
+    bool is_settled();
 
     void on_touch_down(float x, float y);
     void on_touch_up();
@@ -35,6 +36,11 @@ public:
         void draw(const g2d::program *program, const g2d::texture *texture, float t, const g2d::rgba &color,
                   int layer) const;
 
+        enum
+        {
+            ANIMATION_TICS = 60 * MS_PER_TIC
+        };
+
         float x_left, x_right;
         float y_top, y_bottom;
         g2d::vec2 uv0, uv1, uv2, uv3;
@@ -53,6 +59,8 @@ private:
     std::map<const g2d::texture *, std::vector<particle>> particles_;
 
     int tics_;
+    int settle_tic_; // when the last particle stops
+    bool was_settled_; // at the last is_settled()
 
     enum
     {
@@ -73,7 +81,8 @@ private:
 };
 
 credits_impl::credits_impl()
-    : program_outline_(get_program(program::text_outline))
+    : settle_tic_(0)
+    , program_outline_(get_program(program::text_outline))
     , program_inner_(get_program(program::text_inner))
 {
     const auto *tiny_font = get_font(font::tiny);
@@ -96,6 +105,8 @@ void credits_impl::add_text(const g2d::font *font, float x_base_orig, float y_ba
     float x_base = x_base_orig;
     float y_base = y_base_orig;
 
+    settle_tic_ = std::max(settle_tic_, start_tic + particle::ANIMATION_TICS);
+
     for (const char *p = text; *p; p++) {
         const g2d::glyph_info *g = font->find_glyph(*p);
 
@@ -160,11 +171,6 @@ void credits_impl::particle::draw(const g2d::program *program, const g2d::textur
 
     t -= start_tic;
 
-    enum
-    {
-        ANIMATION_TICS = 60 * MS_PER_TIC
-    };
-
     // XXX move this to vertex shader?
 
     const float x_axis = 200.;
@@ -251,6 +257,17 @@ void credits_impl::reset()
 {
     tics_ = state_tics_ = 0;
     cur_state_ = INTRO;
+    was_settled_ = false;
+}
+
+// false while the text flies or fades in or out, and right after
+bool credits_impl::is_settled()
+{
+    const bool settled = cur_state_ == IDLE && tics_ >= settle_tic_;
+    const bool was_settled = was_settled_;
+    was_settled_ = settled;
+
+    return settled && was_settled;
 }
 
 void credits_impl::on_touch_down(float, float)
@@ -305,6 +322,12 @@ void credits_state::update(uint32_t dt)
     impl_->update(dt);
 }
 
+bool credits_state::get_damage(std::vector<render::box> &damage)
+{
+    const bool background_settled = get_prev_state()->get_damage(damage); // main menu background
+    return impl_->is_settled() && background_settled;
+}
+
 void credits_state::on_touch_down(float x, float y)
 {
     impl_->on_touch_down(x, y);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Storage for short-lived effects of a single type. Slots are allocated in
+// chunks that are never released, so once the pool has grown to the peak
+// number of live effects, spawning doesn't touch the heap. Effects never move
+// after construction (some keep pointers to their own members).
+
+template <typename Effect, int CHUNK_SIZE = 32>
+class effect_pool : private noncopyable
+{
+public:
+    effect_pool() = default;
+    ~effect_pool() { clear(); }
+
+    template <typename... Args>
+    Effect *spawn(Args &&... args)
+    {
+        if (free_slots_.empty())
+            grow();
+
+        const int index = free_slots_.back();
+        free_slots_.pop_back();
+
+        auto &s = get_slot(index);
+        auto *effect = new (&s.storage) Effect(std::forward<Args>(args)...);
+        s.alive = true;
+        ++size_;
+
+        return effect;
+    }
+
+    // calls update() on each live effect, destroying the ones that are done
+    void update(uint32_t dt)
+    {
+        for_each_slot([this, dt](slot &s, int index) {
+            if (!s.get()->update(dt))
+                destroy(s, index);
+        });
+    }
+
+    void draw() const
+    {
+        for (const auto &c : chunks_) {
+            for (const auto &s : c->slots) {
+                if (s.alive)
+                    s.get()->draw();
+            }
+        }
+    }
+
+    void clear()
+    {
+        for_each_slot([this](slot &s, int index) { destroy(s, index); });
+    }
+
+    bool empty() const { return size_ == 0; }
+
+    int size() const { return size_; }
+
+private:
+    struct slot
+    {
+        Effect *get() { return reinterpret_cast<Effect *>(&storage); }
+        const Effect *get() const { return reinterpret_cast<const Effect *>(&storage); }
+
+        typename std::aligned_storage<sizeof(Effect), alignof(Effect)>::type storage;
+        bool alive = false;
+    };
+
+    struct chunk
+    {
+        slot slots[CHUNK_SIZE];
+    };
+
+    slot &get_slot(int index) { return chunks_[index / CHUNK_SIZE]->slots[index % CHUNK_SIZE]; }
+
+    template <typename Visitor>
+    void for_each_slot(Visitor visit)
+    {
+        if (size_ == 0)
+            return;
+
+        int index = 0;
+
+        for (auto &c : chunks_) {
+            for (auto &s : c->slots) {
+                if (s.alive)
+                    visit(s, index);
+                ++index;
+            }
+        }
+    }
+
+    void destroy(slot &s, int index)
+    {
+        s.get()->~Effect();
+        s.alive = false;
+        --size_;
+
+        free_slots_.push_back(index);
+    }
+
+    void grow()
+    {
+        const int first = chunks_.size() * CHUNK_SIZE;
+
+        chunks_.emplace_back(new chunk);
+        free_slots_.reserve(first + CHUNK_SIZE);
+
+        for (int i = first + CHUNK_SIZE - 1; i >= first; --i)
+            free_slots_.push_back(i);
+    }
+
+    std::vector<std::unique_ptr<chunk>> chunks_;
+    std::vector<int> free_slots_;
+    int size_ = 0;
+};
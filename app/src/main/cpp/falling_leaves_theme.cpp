@@ -1,15 +1,18 @@
 #include "falling_leaves_theme.h"
 
 #include <guava2d/g2dgl.h>
+#include <guava2d/gl_state.h>
 #include <guava2d/texture_manager.h>
 #include <guava2d/gl_buffer.h>
 #include <guava2d/program.h>
+#include <guava2d/transform.h>
 
 #include "common.h"
 #include "programs.h"
 #include "render.h"
 
 #include <algorithm>
+#include <vector>
 
 namespace {
 constexpr auto FADE_TTL = 30 * MS_PER_TIC;
@@ -93,10 +96,18 @@ void falling_leaves_theme::leaf::draw(GLfloat *vertex_data) const
 
     const g2d::vec3 p = g2d::vec3(o.x + s0 * radius_0, o.y + s1 * radius_1, o.z);
 
-    const g2d::vec3 p0 = p + dir * g2d::vec3(-size, -size, 0);
-    const g2d::vec3 p1 = p + dir * g2d::vec3(size, -size, 0);
-    const g2d::vec3 p2 = p + dir * g2d::vec3(size, size, 0);
-    const g2d::vec3 p3 = p + dir * g2d::vec3(-size, size, 0);
+    g2d::mat4 m = dir;
+    m.m14 = p.x;
+    m.m24 = p.y;
+    m.m34 = p.z;
+
+    g2d::vec3 corners[4] = {{-size, -size, 0}, {size, -size, 0}, {size, size, 0}, {-size, size, 0}};
+    g2d::transform_points(m, corners, corners, 4);
+
+    const auto &p0 = corners[0];
+    const auto &p1 = corners[1];
+    const auto &p2 = corners[2];
+    const auto &p3 = corners[3];
 
     const auto add_vertex = [this, &vertex_data, &alpha](float x, float y, float z, float u, float v) {
         *vertex_data++ = x;
@@ -141,7 +152,6 @@ falling_leaves_theme::falling_leaves_theme()
 
     program_->use();
     program_->set_uniform_matrix4("proj_modelview_matrix", matrix);
-    program_->set_uniform_i("tex", 0);
 
     vbo_.bind();
     vbo_.buffer_data(falling_leaves_theme::NUM_LEAVES * 6 * (3 + 2 + 4) * sizeof(GLfloat), nullptr, GL_DYNAMIC_DRAW);
@@ -164,14 +174,6 @@ void falling_leaves_theme::draw() const
 {
     render::end_batch();
 
-    // HACK
-    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
-    GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-    GL_CHECK(glBindVertexArray(0));
-
-    GL_CHECK(glEnable(GL_BLEND));
-    GL_CHECK(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-
     std::array<const leaf *, NUM_LEAVES> sorted_leaves;
     for (int i = 0; i < NUM_LEAVES; i++)
         sorted_leaves[i] = &leaves_[i];
@@ -179,33 +181,47 @@ void falling_leaves_theme::draw() const
         return a->pos.z < b->pos.z;
     });
 
-    const GLsizei stride = (3 + 2 + 4) * sizeof(GLfloat);
+    const int floats_per_leaf = 6 * (3 + 2 + 4);
 
-    vbo_.bind();
-
-    auto *data = reinterpret_cast<GLfloat *>(vbo_.map_range(0, NUM_LEAVES * 6 * stride, GL_MAP_WRITE_BIT));
+    // the leaves keep moving while this is drawn, so snapshot the vertices now
+    std::vector<GLfloat> vertex_data(NUM_LEAVES * floats_per_leaf);
+    auto *data = vertex_data.data();
     for (const auto *leaf : sorted_leaves) {
         leaf->draw(data);
-        data += 6 * (3 + 2 + 4);
+        data += floats_per_leaf;
     }
-    vbo_.unmap();
 
-    program_->use();
+    render::defer([this, vertex_data = std::move(vertex_data)] {
+        // HACK
+        GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, 0));
+        GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+        g2d::gl_state::bind_vertex_array(0);
 
-    texture_->bind();
+        g2d::gl_state::set_blend(true);
+        g2d::gl_state::set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    GL_CHECK(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(0)));
-    GL_CHECK(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(3 * sizeof(GLfloat))));
-    GL_CHECK(glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(5 * sizeof(GLfloat))));
-    GL_CHECK(glEnableVertexAttribArray(0));
-    GL_CHECK(glEnableVertexAttribArray(1));
-    GL_CHECK(glEnableVertexAttribArray(2));
-    GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6 * NUM_LEAVES));
-    GL_CHECK(glDisableVertexAttribArray(2));
-    GL_CHECK(glDisableVertexAttribArray(1));
-    GL_CHECK(glDisableVertexAttribArray(0));
+        const GLsizei stride = (3 + 2 + 4) * sizeof(GLfloat);
 
-    vbo_.unbind();
+        vbo_.bind();
+        vbo_.buffer_sub_data(0, vertex_data.size() * sizeof(GLfloat), vertex_data.data());
+
+        program_->use();
+
+        texture_->bind();
+
+        GL_CHECK(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(0)));
+        GL_CHECK(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(3 * sizeof(GLfloat))));
+        GL_CHECK(glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<GLvoid *>(5 * sizeof(GLfloat))));
+        GL_CHECK(glEnableVertexAttribArray(0));
+        GL_CHECK(glEnableVertexAttribArray(1));
+        GL_CHECK(glEnableVertexAttribArray(2));
+        GL_CHECK(glDrawArrays(GL_TRIANGLES, 0, 6 * NUM_LEAVES));
+        GL_CHECK(glDisableVertexAttribArray(2));
+        GL_CHECK(glDisableVertexAttribArray(1));
+        GL_CHECK(glDisableVertexAttribArray(0));
+
+        vbo_.unbind();
+    });
 
     render::begin_batch();
     render::set_viewport(0, window_width, 0, window_height);
@@ -14,10 +14,12 @@ const g2d::font *get_font(font f)
             "fonts/gameover",
             "fonts/title"
         };
+        static g2d::font_atlas atlas("fonts/atlas", 1024, 1024);
         std::vector<g2d::font *> fonts;
         fonts.reserve(static_cast<size_t>(font::font_count));
         for (auto source : sources)
-            fonts.push_back(new g2d::font{source});
+            fonts.push_back(new g2d::font{source, atlas});
+        atlas.upload();
         return fonts;
     }();
     return fonts[static_cast<int>(f)];
@@ -0,0 +1,28 @@
+#include "frame_scheduler.h"
+
+frame_scheduler::frame_scheduler(int max_fps)
+    : interval_(max_fps > 0 ? std::chrono::duration_cast<clock::duration>(std::chrono::seconds(1)) / max_fps
+                            : clock::duration::zero())
+    , next_frame_(clock::now())
+{
+}
+
+int frame_scheduler::time_to_next_frame() const
+{
+    const auto now = clock::now();
+    if (now >= next_frame_)
+        return 0;
+
+    // round up, sleeping a bit too short would just make us spin
+    const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(next_frame_ - now).count();
+    return (wait + 999) / 1000;
+}
+
+void frame_scheduler::frame_started()
+{
+    const auto now = clock::now();
+
+    next_frame_ += interval_;
+    if (next_frame_ < now)
+        next_frame_ = now + interval_;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <chrono>
+
+// Paces the main loop to a maximum frame rate, so it doesn't render faster
+// than anyone can see when vsync is off or unavailable. Frames are spaced on
+// a fixed grid; a late frame restarts the grid rather than bunching up the
+// ones after it.
+
+class frame_scheduler : private noncopyable
+{
+public:
+    // max_fps of 0 leaves the pacing to vsync
+    explicit frame_scheduler(int max_fps);
+
+    // ms to wait before the next frame should start, 0 if it's due
+    int time_to_next_frame() const;
+
+    void frame_started();
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    clock::duration interval_;
+    clock::time_point next_frame_;
+};
@@ -0,0 +1,102 @@
+#include <cmath>
+
+#include "distance_field.h"
+
+namespace g2d {
+
+namespace {
+
+// 8SSEDT: each texel keeps the offset to the closest seed texel, propagated
+// over two raster scans
+
+struct offset
+{
+	int dx, dy;
+
+	int length_squared() const
+	{ return dx*dx + dy*dy; }
+};
+
+const offset FAR_AWAY = { 1 << 12, 1 << 12 };
+
+void
+propagate(std::vector<offset>& grid, int width, int height)
+{
+	auto compare = [&](offset& p, int x, int y, int ox, int oy) {
+		const int nx = x + ox, ny = y + oy;
+
+		if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+			return;
+
+		offset o = grid[ny*width + nx];
+		o.dx += ox;
+		o.dy += oy;
+
+		if (o.length_squared() < p.length_squared())
+			p = o;
+	};
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			offset& p = grid[y*width + x];
+			compare(p, x, y, -1, 0);
+			compare(p, x, y, 0, -1);
+			compare(p, x, y, -1, -1);
+			compare(p, x, y, 1, -1);
+		}
+
+		for (int x = width - 1; x >= 0; x--)
+			compare(grid[y*width + x], x, y, 1, 0);
+	}
+
+	for (int y = height - 1; y >= 0; y--) {
+		for (int x = width - 1; x >= 0; x--) {
+			offset& p = grid[y*width + x];
+			compare(p, x, y, 1, 0);
+			compare(p, x, y, 0, 1);
+			compare(p, x, y, -1, 1);
+			compare(p, x, y, 1, 1);
+		}
+
+		for (int x = 0; x < width; x++)
+			compare(grid[y*width + x], x, y, -1, 0);
+	}
+}
+
+}
+
+std::vector<float>
+distance_field(const std::vector<float>& coverage, int width, int height)
+{
+	const int size = width*height;
+
+	std::vector<offset> to_inside(size), to_outside(size);
+
+	for (int i = 0; i < size; i++) {
+		if (coverage[i] >= .5f) {
+			to_inside[i] = { 0, 0 };
+			to_outside[i] = FAR_AWAY;
+		} else {
+			to_inside[i] = FAR_AWAY;
+			to_outside[i] = { 0, 0 };
+		}
+	}
+
+	propagate(to_inside, width, height);
+	propagate(to_outside, width, height);
+
+	// seeds are texel centers, the edge lies half a texel away
+
+	std::vector<float> field(size);
+
+	for (int i = 0; i < size; i++) {
+		if (coverage[i] >= .5f)
+			field[i] = sqrtf(to_outside[i].length_squared()) - .5f;
+		else
+			field[i] = .5f - sqrtf(to_inside[i].length_squared());
+	}
+
+	return field;
+}
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <vector>
+
+namespace g2d {
+
+// Signed distance, in texels, from each texel center to the .5 isoline of a
+// width x height coverage map. Positive inside, negative outside.
+std::vector<float> distance_field(const std::vector<float>& coverage, int width, int height);
+
+}
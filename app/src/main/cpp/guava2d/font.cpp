@@ -1,4 +1,8 @@
 #include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include <cstring>
 #include <cassert>
 #include <cerrno>
@@ -9,6 +13,8 @@
 
 #include "panic.h"
 #include "xwchar.h"
+#include "distance_field.h"
+#include "pixmap.h"
 #include "texture.h"
 #include "texture_manager.h"
 #include "font.h"
@@ -17,10 +23,128 @@
 
 namespace g2d {
 
-font::font(const char *source)
+namespace {
+
+uint32_t
+glyph_hash(uint32_t code, uint32_t seed)
+{
+	uint32_t h = (code ^ seed)*0x9e3779b1u;
+	return h ^ (h >> 16);
+}
+
+template <typename T>
+T
+next_power_of_2(T n)
+{
+	T p = 1;
+	while (p < n)
+		p <<= 1;
+	return p;
+}
+
+}
+
+font_atlas::font_atlas(const char *name, int width, int height)
+: texture_(new texture(new pixmap(width, height, pixmap::GRAY)))
+, shelf_x_(0)
+, shelf_y_(0)
+, shelf_height_(0)
+{
+	put_texture(name, texture_);
+}
+
+bool
+font_atlas::allocate(int width, int height, int& x, int& y)
+{
+	const int atlas_width = texture_->get_pixmap()->get_width();
+	const int atlas_height = texture_->get_pixmap()->get_height();
+
+	if (shelf_x_ + width > atlas_width) {
+		shelf_x_ = 0;
+		shelf_y_ += shelf_height_;
+		shelf_height_ = 0;
+	}
+
+	if (width > atlas_width || shelf_y_ + height > atlas_height)
+		return false;
+
+	x = shelf_x_;
+	y = shelf_y_;
+
+	shelf_x_ += width;
+	shelf_height_ = std::max(shelf_height_, height);
+
+	return true;
+}
+
+uint8_t *
+font_atlas::get_bits(int x, int y) const
 {
-	::memset(glyph_info_map_, 0, sizeof glyph_info_map_);
+	pixmap *pm = texture_->get_pixmap();
+	return pm->get_bits() + y*pm->get_width() + x;
+}
+
+void
+font_atlas::upload() const
+{
+	texture_->upload_pixmap();
+}
+
+font::font(const char *source, font_atlas& atlas)
+: texture_(atlas.get_texture())
+{
+	load_glyphs(source, atlas);
+
+	const int num_glyphs = codes_.size();
 
+	// sort by code; later entries for the same code win, as before
+
+	std::vector<int> order(num_glyphs);
+	for (int i = 0; i < num_glyphs; i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return codes_[a] < codes_[b]; });
+
+	std::vector<uint16_t> sorted_codes;
+	std::vector<glyph_info> sorted_glyphs;
+
+	sorted_codes.reserve(num_glyphs);
+	sorted_glyphs.reserve(num_glyphs);
+
+	for (int i : order) {
+		if (!sorted_codes.empty() && sorted_codes.back() == codes_[i])
+			sorted_glyphs.back() = glyphs_[i];
+		else {
+			sorted_codes.push_back(codes_[i]);
+			sorted_glyphs.push_back(glyphs_[i]);
+		}
+	}
+
+	codes_.swap(sorted_codes);
+	glyphs_.swap(sorted_glyphs);
+
+	codes_.shrink_to_fit();
+	glyphs_.shrink_to_fit();
+
+	// direct-mapped table
+
+	::memset(direct_map_, 0, sizeof direct_map_);
+
+	for (size_t i = 0; i < codes_.size(); i++) {
+		const uint32_t code = codes_[i];
+
+		if (code < ASCII_END)
+			direct_map_[code] = i + 1;
+		else if (code >= KANA_BEGIN && code < KANA_END)
+			direct_map_[code - KANA_BEGIN + ASCII_END] = i + 1;
+	}
+
+	build_hash();
+}
+
+void
+font::load_glyphs(const char *source, font_atlas& atlas)
+{
 	char path[512];
 	
 	sprintf(path, "%s.spr", source);
@@ -28,15 +152,40 @@ font::font(const char *source)
 
 	int num_glyphs = file.read_uint16();
 
-	// read textures
+	// the font image has the glyph in the gray channel and glyph + outline in
+	// the alpha channel, at half the resolution of the glyph metrics
 
 	sprintf(path, "%s.png", source);
-	texture_ = load_texture(path);
+	std::unique_ptr<pixmap> image(pixmap::load(path));
+
+	if (image->get_type() != pixmap::GRAY_ALPHA)
+		panic("%s: expected a gray+alpha image", path);
+
+	const int image_width = image->get_width();
+	const int image_height = image->get_height();
+
+	const int s = 2;
+
+	struct glyph_field
+	{
+		int width, height;
+		float u_offset, v_offset;
+		std::vector<float> distance;
+	};
 
-	// read glyphs
+	std::vector<glyph_field> fields;
+	fields.reserve(num_glyphs);
+
+	codes_.reserve(num_glyphs);
+	glyphs_.reserve(num_glyphs);
+
+	// outline thickness in texels, averaged over the outer edge of every glyph
+
+	float outline_sum = 0;
+	int outline_count = 0;
 
 	for (int i = 0; i < num_glyphs; i++) {
-		wchar_t code = file.read_uint16();
+		uint16_t code = file.read_uint16();
 
 		int left = static_cast<int8_t>(file.read_uint8());
 		int top = static_cast<int8_t>(file.read_uint8());
@@ -47,33 +196,197 @@ font::font(const char *source)
 		const int w = file.read_uint16();
 		const int h = file.read_uint16();
 
-		glyph_info *g = new glyph_info;
+		glyph_info g;
+
+		g.width = w;
+		g.height = h;
+		g.left = left;
+		g.top = top;
+		g.advance_x = advance_x;
+		g.texture_ = texture_;
+
+		codes_.push_back(code);
+		glyphs_.push_back(g);
+
+		// glyph rectangle in the image, plus padding for the bilinear filter
 
-		g->width = w;
-		g->height = h;
-		g->left = left;
-		g->top = top;
-		g->advance_x = advance_x;
-		g->texture_ = texture_;
+		const int x0 = u/s - GLYPH_PADDING;
+		const int y0 = v/s - GLYPH_PADDING;
+		const int x1 = (u + w + s - 1)/s + GLYPH_PADDING;
+		const int y1 = (v + h + s - 1)/s + GLYPH_PADDING;
 
-		const int texture_width = texture_->get_texture_width();
-		const int texture_height = texture_->get_texture_height();
+		glyph_field f;
 
-		int s = 2; // texture_->get_downsample_scale();
+		f.width = x1 - x0;
+		f.height = y1 - y0;
+		f.u_offset = static_cast<float>(u)/s - x0;
+		f.v_offset = static_cast<float>(v)/s - y0;
 
-		const float u0 = static_cast<float>(u)/s/texture_width;
-		const float v0 = static_cast<float>(v)/s/texture_height;
+		std::vector<float> inner(f.width*f.height), outer(f.width*f.height);
 
-		const float du = static_cast<float>(w)/s/texture_width;
-		const float dv = static_cast<float>(h)/s/texture_height;
+		for (int y = 0; y < f.height; y++) {
+			for (int x = 0; x < f.width; x++) {
+				const int ix = x0 + x, iy = y0 + y;
 
-		g->texuv[0] = vec2(u0, v0);
-		g->texuv[1] = vec2(u0 + du, v0);
-		g->texuv[2] = vec2(u0 + du, v0 + dv);
-		g->texuv[3] = vec2(u0, v0 + dv);
+				if (ix < 0 || ix >= image_width || iy < 0 || iy >= image_height)
+					continue;
 
-		glyph_info_map_[code] = g;
+				const uint8_t *p = image->get_bits() + 2*(iy*image_width + ix);
+
+				outer[y*f.width + x] = p[1]/255.f;
+				inner[y*f.width + x] = p[0]/255.f*outer[y*f.width + x];
+			}
+		}
+
+		f.distance = distance_field(inner, f.width, f.height);
+
+		for (int y = 1; y < f.height - 1; y++) {
+			for (int x = 1; x < f.width - 1; x++) {
+				const int j = y*f.width + x;
+
+				if (outer[j] < .5f || f.distance[j] >= 0)
+					continue;
+
+				if (outer[j - 1] < .5f || outer[j + 1] < .5f ||
+				  outer[j - f.width] < .5f || outer[j + f.width] < .5f) {
+					outline_sum -= f.distance[j];
+					++outline_count;
+				}
+			}
+		}
+
+		fields.push_back(std::move(f));
+	}
+
+	const float outline_width = outline_count ? outline_sum/outline_count + .5f : 1.f;
+
+	// encode distances so that the glyph edge is at .5 and the outline edge at .25
+
+	const int texture_width = texture_->get_texture_width();
+	const int texture_height = texture_->get_texture_height();
+
+	for (int i = 0; i < num_glyphs; i++) {
+		const glyph_field& f = fields[i];
+
+		int ax, ay;
+		if (!atlas.allocate(f.width, f.height, ax, ay))
+			panic("%s: font atlas full", source);
+
+		for (int y = 0; y < f.height; y++) {
+			uint8_t *dest = atlas.get_bits(ax, ay + y);
+
+			for (int x = 0; x < f.width; x++) {
+				const float d = .5f + .25f*f.distance[y*f.width + x]/outline_width;
+				*dest++ = static_cast<uint8_t>(255.f*std::min(std::max(d, 0.f), 1.f) + .5f);
+			}
+		}
+
+		glyph_info& g = glyphs_[i];
+
+		const float u0 = (ax + f.u_offset)/texture_width;
+		const float v0 = (ay + f.v_offset)/texture_height;
+
+		const float du = static_cast<float>(g.width)/s/texture_width;
+		const float dv = static_cast<float>(g.height)/s/texture_height;
+
+		g.texuv[0] = vec2(u0, v0);
+		g.texuv[1] = vec2(u0 + du, v0);
+		g.texuv[2] = vec2(u0 + du, v0 + dv);
+		g.texuv[3] = vec2(u0, v0 + dv);
+	}
+}
+
+font::~font()
+{
+}
+
+void
+font::build_hash()
+{
+	// hash-and-displace: keys are distributed into buckets with a fixed hash, then each bucket
+	// (largest first) gets the first seed that sends all its keys to free slots
+
+	std::vector<int> keys;
+
+	for (size_t i = 0; i < codes_.size(); i++) {
+		const uint32_t code = codes_[i];
+		if (code >= ASCII_END && (code < KANA_BEGIN || code >= KANA_END))
+			keys.push_back(i);
 	}
+
+	if (keys.empty())
+		return;
+
+	const size_t num_slots = next_power_of_2(2*keys.size());
+	const size_t num_buckets = std::max<size_t>(num_slots/4, 1);
+
+	std::vector<std::vector<int>> buckets(num_buckets);
+
+	for (int i : keys)
+		buckets[glyph_hash(codes_[i], 0) & (num_buckets - 1)].push_back(i);
+
+	std::vector<int> bucket_order(num_buckets);
+	for (size_t i = 0; i < num_buckets; i++)
+		bucket_order[i] = i;
+
+	std::stable_sort(bucket_order.begin(), bucket_order.end(),
+		[&buckets](int a, int b) { return buckets[a].size() > buckets[b].size(); });
+
+	hash_seeds_.assign(num_buckets, 0);
+	hash_slots_.assign(num_slots, 0);
+
+	std::vector<size_t> bucket_slots;
+
+	for (int b : bucket_order) {
+		const auto& bucket = buckets[b];
+
+		if (bucket.empty())
+			break;
+
+		uint32_t seed;
+
+		for (seed = 1; seed <= UINT16_MAX; seed++) {
+			bucket_slots.clear();
+
+			for (int i : bucket) {
+				const size_t slot = glyph_hash(codes_[i], seed) & (num_slots - 1);
+
+				if (hash_slots_[slot] ||
+				  std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())
+					break;
+
+				bucket_slots.push_back(slot);
+			}
+
+			if (bucket_slots.size() == bucket.size())
+				break;
+		}
+
+		if (seed > UINT16_MAX)
+			panic("failed to build glyph hash");
+
+		hash_seeds_[b] = seed;
+
+		for (size_t j = 0; j < bucket.size(); j++)
+			hash_slots_[bucket_slots[j]] = bucket[j] + 1;
+	}
+}
+
+const glyph_info *
+font::find_hashed_glyph(uint32_t code) const
+{
+	if (hash_slots_.empty() || code > UINT16_MAX)
+		return nullptr;
+
+	const uint16_t seed = hash_seeds_[glyph_hash(code, 0) & (hash_seeds_.size() - 1)];
+	if (!seed)
+		return nullptr;
+
+	const uint16_t slot = hash_slots_[glyph_hash(code, seed) & (hash_slots_.size() - 1)];
+	if (!slot || codes_[slot - 1] != code)
+		return nullptr;
+
+	return &glyphs_[slot - 1];
 }
 
 int
@@ -2,6 +2,9 @@
 #define FONT_H_
 
 #include <stdarg.h>
+#include <stdint.h>
+
+#include <vector>
 
 #include "g2dgl.h"
 #include "vec2.h"
@@ -20,14 +23,51 @@ struct glyph_info
 	const texture *texture_;
 };
 
+// Glyphs of all fonts are stored as distance fields in one shared texture.
+// Texel values are .5 on the edge of the glyph and .25 on the outer edge of
+// its outline, so any font can be drawn at any scale by the same program.
+
+class font_atlas
+{
+public:
+	font_atlas(const char *name, int width, int height);
+
+	font_atlas(const font_atlas&) = delete;
+	font_atlas& operator=(const font_atlas&) = delete;
+
+	const texture *get_texture() const
+	{ return texture_; }
+
+	// reserves a width x height region, returns false if the atlas is full
+	bool allocate(int width, int height, int& x, int& y);
+
+	uint8_t *get_bits(int x, int y) const;
+
+	void upload() const;
+
+private:
+	texture *texture_;
+	int shelf_x_, shelf_y_, shelf_height_;
+};
+
 class font
 {
 public:
-	font(const char *source);
+	font(const char *source, font_atlas& atlas);
 	~font();
 
+	font(const font&) = delete;
+	font& operator=(const font&) = delete;
+
 	const glyph_info *find_glyph(wchar_t ch) const
-	{ return glyph_info_map_[ch]; }
+	{
+		const uint32_t code = ch;
+		if (code < ASCII_END)
+			return direct_glyph(direct_map_[code]);
+		if (code >= KANA_BEGIN && code < KANA_END)
+			return direct_glyph(direct_map_[code - KANA_BEGIN + ASCII_END]);
+		return find_hashed_glyph(code);
+	}
 
 	int get_string_width(const wchar_t *str, size_t len) const;
 	int get_string_width(const wchar_t *str) const;
@@ -36,7 +76,37 @@ public:
 	{ return texture_; }
 
 private:
-	glyph_info *glyph_info_map_[1<<16];
+	// ASCII and hiragana/katakana are looked up in a direct-mapped table,
+	// everything else goes through a perfect hash built at load time
+
+	enum : uint32_t {
+		ASCII_END = 0x80,
+		KANA_BEGIN = 0x3040,
+		KANA_END = 0x3100,
+		DIRECT_MAP_SIZE = ASCII_END + KANA_END - KANA_BEGIN,
+	};
+
+	enum { GLYPH_PADDING = 1 }; // texels around each glyph in the atlas
+
+	// slots in direct_map_ and hash_slots_ hold glyph index + 1, 0 if empty
+
+	const glyph_info *direct_glyph(uint16_t slot) const
+	{ return slot ? &glyphs_[slot - 1] : nullptr; }
+
+	const glyph_info *find_hashed_glyph(uint32_t code) const;
+
+	void load_glyphs(const char *source, font_atlas& atlas);
+
+	void build_hash();
+
+	std::vector<uint16_t> codes_; // sorted
+	std::vector<glyph_info> glyphs_; // same order as codes_
+
+	uint16_t direct_map_[DIRECT_MAP_SIZE];
+
+	std::vector<uint16_t> hash_seeds_; // one per bucket
+	std::vector<uint16_t> hash_slots_;
+
 	const texture *texture_;
 };
 
@@ -0,0 +1,71 @@
+#include "framebuffer.h"
+#include "gl_state.h"
+#include "panic.h"
+
+namespace g2d {
+
+framebuffer::framebuffer(int width, int height)
+: width_(width)
+, height_(height)
+, framebuffer_id_(0)
+, texture_id_(0)
+{
+	load();
+}
+
+framebuffer::~framebuffer()
+{
+	gl_state::framebuffer_deleted(framebuffer_id_);
+	GL_CHECK(glDeleteFramebuffers(1, &framebuffer_id_));
+
+	gl_state::texture_deleted(texture_id_);
+	GL_CHECK(glDeleteTextures(1, &texture_id_));
+}
+
+void
+framebuffer::bind() const
+{
+	gl_state::bind_framebuffer(framebuffer_id_);
+}
+
+void
+framebuffer::unbind()
+{
+	gl_state::bind_framebuffer(0);
+}
+
+void
+framebuffer::bind_texture() const
+{
+	gl_state::bind_texture(0, texture_id_);
+}
+
+void
+framebuffer::load()
+{
+	GL_CHECK(glGenTextures(1, &texture_id_));
+
+	bind_texture();
+
+	// composited 1:1 with the screen's pixel grid, nothing to filter
+	GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GL_CHECK(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+
+	GL_CHECK(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+	GL_CHECK(glGenFramebuffers(1, &framebuffer_id_));
+
+	bind();
+
+	GL_CHECK(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_id_, 0));
+
+	const GLenum status = GL_CHECK_R(glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+		panic("framebuffer %dx%d incomplete: %x", width_, height_, status);
+
+	unbind();
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "g2dgl.h"
+
+namespace g2d {
+
+// Offscreen render target: a framebuffer object with an RGBA texture of the
+// same size as its color attachment.
+class framebuffer
+{
+public:
+	framebuffer(int width, int height);
+	~framebuffer();
+
+	framebuffer(const framebuffer&) = delete;
+	framebuffer& operator=(const framebuffer&) = delete;
+
+	int get_width() const
+	{ return width_; }
+
+	int get_height() const
+	{ return height_; }
+
+	// render into this instead of the default framebuffer
+	void bind() const;
+	static void unbind();
+
+	// sample the color attachment on texture unit 0
+	void bind_texture() const;
+
+	// (re)create the GL objects, e.g. in a fresh context; the old names
+	// went away with the old context
+	void load();
+
+private:
+	int width_, height_;
+
+	GLuint framebuffer_id_;
+	GLuint texture_id_;
+};
+
+}
@@ -0,0 +1,7 @@
+#include "g2dgl.h"
+
+namespace g2d {
+
+unsigned gl_call_count;
+
+}
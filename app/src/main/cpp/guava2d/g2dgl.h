@@ -13,9 +13,18 @@ void gluPerspective(GLfloat, GLfloat, GLfloat, GLfloat);
 #endif
 #endif
 
+namespace g2d {
+
+// calls made through GL_CHECK and GL_CHECK_R, to keep an eye on how much
+// work each frame hands to the driver
+extern unsigned gl_call_count;
+
+}
+
 #ifdef CHECK_GL_CALLS
 #define GL_CHECK(expr) \
     [&] { \
+        ++g2d::gl_call_count; \
         expr; \
         auto e = glGetError(); \
         if (e != GL_NO_ERROR) \
@@ -24,6 +33,7 @@ void gluPerspective(GLfloat, GLfloat, GLfloat, GLfloat);
 
 #define GL_CHECK_R(expr) \
     [&] { \
+        ++g2d::gl_call_count; \
         auto r = expr; \
         auto e = glGetError(); \
         if (e != GL_NO_ERROR) \
@@ -31,6 +41,6 @@ void gluPerspective(GLfloat, GLfloat, GLfloat, GLfloat);
         return r; \
     }()
 #else
-#define GL_CHECK(expr) expr
-#define GL_CHECK_R(expr) expr
+#define GL_CHECK(expr) (++g2d::gl_call_count, expr)
+#define GL_CHECK_R(expr) (++g2d::gl_call_count, expr)
 #endif
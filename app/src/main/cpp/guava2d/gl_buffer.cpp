@@ -31,6 +31,18 @@ gl_buffer::buffer_data(GLsizei size, const void *data, GLenum usage) const
 	GL_CHECK(glBufferData(target_, size, data, usage));
 }
 
+void
+gl_buffer::buffer_sub_data(GLintptr offset, GLsizei size, const void *data) const
+{
+	GL_CHECK(glBufferSubData(target_, offset, size, data));
+}
+
+void
+gl_buffer::bind_base(GLuint index) const
+{
+	GL_CHECK(glBindBufferBase(target_, index, id_));
+}
+
 void *
 gl_buffer::map_range(GLintptr offset, GLsizei length, GLbitfield access) const
 {
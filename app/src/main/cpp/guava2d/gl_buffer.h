@@ -17,6 +17,10 @@ public:
 	void unbind() const;
 
 	void buffer_data(GLsizei size, const void *data, GLenum usage) const;
+	void buffer_sub_data(GLintptr offset, GLsizei size, const void *data) const;
+
+	// for uniform buffers
+	void bind_base(GLuint index) const;
 
 	void *map_range(GLintptr offset, GLsizei length, GLbitfield access) const;
 	void unmap() const;
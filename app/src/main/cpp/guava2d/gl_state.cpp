@@ -0,0 +1,252 @@
+#include "gl_state.h"
+
+namespace g2d { namespace gl_state {
+
+namespace {
+
+// tri-state for capabilities, since we don't know what the context starts with
+enum class cap { UNKNOWN, ENABLED, DISABLED };
+
+constexpr GLuint UNKNOWN_NAME = ~0u;
+constexpr GLenum UNKNOWN_ENUM = ~0u;
+
+struct rect
+{
+	GLint x, y;
+	GLsizei width, height;
+
+	bool operator==(const rect& other) const
+	{ return x == other.x && y == other.y && width == other.width && height == other.height; }
+};
+
+const rect UNKNOWN_RECT = { -1, -1, -1, -1 };
+
+struct blend_func
+{
+	GLenum src_rgb, dst_rgb;
+	GLenum src_alpha, dst_alpha;
+
+	bool operator==(const blend_func& other) const
+	{
+		return src_rgb == other.src_rgb && dst_rgb == other.dst_rgb &&
+		  src_alpha == other.src_alpha && dst_alpha == other.dst_alpha;
+	}
+};
+
+const blend_func UNKNOWN_BLEND_FUNC = { UNKNOWN_ENUM, UNKNOWN_ENUM, UNKNOWN_ENUM, UNKNOWN_ENUM };
+
+struct state
+{
+	GLuint program;
+	GLuint active_texture_unit;
+	GLuint textures[MAX_TEXTURE_UNITS];
+	GLuint vertex_array;
+	GLuint framebuffer;
+	cap blend;
+	blend_func blend_factors;
+	cap scissor_test;
+	rect scissor;
+	rect viewport;
+} cur;
+
+counters cur_counters;
+
+bool initialized;
+
+void
+reset_state()
+{
+	cur.program = UNKNOWN_NAME;
+	cur.active_texture_unit = UNKNOWN_NAME;
+	for (auto& id : cur.textures)
+		id = UNKNOWN_NAME;
+	cur.vertex_array = UNKNOWN_NAME;
+	cur.framebuffer = UNKNOWN_NAME;
+	cur.blend = cap::UNKNOWN;
+	cur.blend_factors = UNKNOWN_BLEND_FUNC;
+	cur.scissor_test = cap::UNKNOWN;
+	cur.scissor = UNKNOWN_RECT;
+	cur.viewport = UNKNOWN_RECT;
+
+	initialized = true;
+}
+
+inline state&
+get_state()
+{
+	if (!initialized)
+		reset_state();
+	return cur;
+}
+
+// returns true if the call has to be issued
+template <typename T>
+bool
+update(T& cached, const T& value)
+{
+	if (cached == value) {
+		++cur_counters.elided;
+		return false;
+	}
+
+	cached = value;
+	++cur_counters.issued;
+	return true;
+}
+
+void
+set_cap(cap& cached, GLenum name, bool enabled)
+{
+	if (update(cached, enabled ? cap::ENABLED : cap::DISABLED)) {
+		if (enabled)
+			GL_CHECK(glEnable(name));
+		else
+			GL_CHECK(glDisable(name));
+	}
+}
+
+}
+
+void
+use_program(GLuint id)
+{
+	if (update(get_state().program, id))
+		GL_CHECK(glUseProgram(id));
+}
+
+void
+bind_texture(GLuint unit, GLuint id)
+{
+	auto& s = get_state();
+
+	if (unit >= MAX_TEXTURE_UNITS)
+		panic("texture unit %u out of range", unit);
+
+	if (s.textures[unit] == id) {
+		++cur_counters.elided;
+		return;
+	}
+
+	if (update(s.active_texture_unit, unit))
+		GL_CHECK(glActiveTexture(GL_TEXTURE0 + unit));
+
+	s.textures[unit] = id;
+	++cur_counters.issued;
+	GL_CHECK(glBindTexture(GL_TEXTURE_2D, id));
+}
+
+void
+bind_vertex_array(GLuint id)
+{
+	if (update(get_state().vertex_array, id))
+		GL_CHECK(glBindVertexArray(id));
+}
+
+void
+set_blend(bool enabled)
+{
+	set_cap(get_state().blend, GL_BLEND, enabled);
+}
+
+void
+bind_framebuffer(GLuint id)
+{
+	if (update(get_state().framebuffer, id))
+		GL_CHECK(glBindFramebuffer(GL_FRAMEBUFFER, id));
+}
+
+void
+set_blend_func(GLenum sfactor, GLenum dfactor)
+{
+	if (update(get_state().blend_factors, blend_func { sfactor, dfactor, sfactor, dfactor }))
+		GL_CHECK(glBlendFunc(sfactor, dfactor));
+}
+
+void
+set_blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha)
+{
+	if (update(get_state().blend_factors, blend_func { src_rgb, dst_rgb, src_alpha, dst_alpha }))
+		GL_CHECK(glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha));
+}
+
+void
+set_scissor_test(bool enabled)
+{
+	set_cap(get_state().scissor_test, GL_SCISSOR_TEST, enabled);
+}
+
+void
+set_scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (update(get_state().scissor, rect { x, y, width, height }))
+		GL_CHECK(glScissor(x, y, width, height));
+}
+
+void
+set_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (update(get_state().viewport, rect { x, y, width, height }))
+		GL_CHECK(glViewport(x, y, width, height));
+}
+
+void
+get_viewport(GLint& x, GLint& y, GLsizei& width, GLsizei& height)
+{
+	auto& viewport = get_state().viewport;
+
+	if (viewport == UNKNOWN_RECT) {
+		GLint v[4];
+		GL_CHECK(glGetIntegerv(GL_VIEWPORT, v));
+		viewport = rect { v[0], v[1], v[2], v[3] };
+	}
+
+	x = viewport.x;
+	y = viewport.y;
+	width = viewport.width;
+	height = viewport.height;
+}
+
+void
+program_deleted(GLuint id)
+{
+	auto& s = get_state();
+	if (s.program == id)
+		s.program = UNKNOWN_NAME;
+}
+
+void
+texture_deleted(GLuint id)
+{
+	for (auto& bound : get_state().textures) {
+		if (bound == id)
+			bound = 0;
+	}
+}
+
+void
+framebuffer_deleted(GLuint id)
+{
+	auto& s = get_state();
+	if (s.framebuffer == id)
+		s.framebuffer = 0;
+}
+
+void
+invalidate()
+{
+	reset_state();
+}
+
+const counters&
+get_counters()
+{
+	return cur_counters;
+}
+
+void
+reset_counters()
+{
+	cur_counters = counters { 0, 0 };
+}
+
+} }
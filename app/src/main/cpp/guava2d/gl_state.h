@@ -0,0 +1,53 @@
+#pragma once
+
+#include "g2dgl.h"
+
+namespace g2d {
+
+// Shadow copy of the GL state that changes between batches. Calls that
+// wouldn't change anything never reach the driver, so everything that
+// touches this state has to go through here or call invalidate() afterwards.
+namespace gl_state {
+
+constexpr unsigned MAX_TEXTURE_UNITS = 8;
+
+void use_program(GLuint id);
+void bind_texture(GLuint unit, GLuint id); // GL_TEXTURE_2D
+void bind_vertex_array(GLuint id);
+void bind_framebuffer(GLuint id); // GL_FRAMEBUFFER
+
+void set_blend(bool enabled);
+void set_blend_func(GLenum sfactor, GLenum dfactor);
+void set_blend_func_separate(GLenum src_rgb, GLenum dst_rgb, GLenum src_alpha, GLenum dst_alpha);
+
+void set_scissor_test(bool enabled);
+void set_scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+void set_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// the viewport last set through here; only asks GL if nothing was set since
+// invalidate()
+void get_viewport(GLint& x, GLint& y, GLsizei& width, GLsizei& height);
+
+// GL drops bindings to deleted objects and may hand the name out again
+void program_deleted(GLuint id);
+void texture_deleted(GLuint id);
+void framebuffer_deleted(GLuint id);
+
+// forget everything, e.g. after the context was recreated
+void invalidate();
+
+struct counters
+{
+	unsigned issued;
+	unsigned elided;
+};
+
+const counters&
+get_counters();
+
+void reset_counters();
+
+}
+
+}
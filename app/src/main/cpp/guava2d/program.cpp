@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
+#include "gl_state.h"
 #include "panic.h"
 #include "program.h"
 
@@ -13,8 +16,10 @@ program::program()
 
 program::~program()
 {
-	if (id_)
+	if (id_) {
+		gl_state::program_deleted(id_);
 		GL_CHECK(glDeleteProgram(id_));
+	}
 }
 
 void
@@ -30,18 +35,138 @@ program::attach(const shader& shader) const
 }
 
 void
-program::link() const
+program::link()
 {
 	GL_CHECK(glLinkProgram(id_));
+	load_uniforms();
+}
+
+bool
+program::binaries_supported()
+{
+#ifndef ANDROID_NDK
+	if (!GLEW_ARB_get_program_binary)
+		return false;
+#endif
+
+	GLint num_formats;
+	GL_CHECK(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats));
+	return num_formats > 0;
+}
+
+void
+program::set_binary_retrievable() const
+{
+	GL_CHECK(glProgramParameteri(id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+}
+
+bool
+program::get_binary(GLenum& format, std::vector<char>& data) const
+{
+	GLint length;
+	GL_CHECK(glGetProgramiv(id_, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return false;
+
+	data.resize(length);
+
+	GLsizei written;
+	GL_CHECK(glGetProgramBinary(id_, length, &written, &format, &data[0]));
+	data.resize(written);
+
+	return written > 0;
+}
+
+bool
+program::load_binary(GLenum format, const std::vector<char>& data)
+{
+	if (data.empty())
+		return false;
+
+	// a format the driver doesn't know about would be a GL error
+	GLint num_formats;
+	GL_CHECK(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats));
+
+	std::vector<GLint> formats(num_formats);
+	if (num_formats > 0)
+		GL_CHECK(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]));
+
+	if (std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) == formats.end())
+		return false;
+
+	GL_CHECK(glProgramBinary(id_, format, &data[0], data.size()));
+
+	GLint status;
+	GL_CHECK(glGetProgramiv(id_, GL_LINK_STATUS, &status));
+	if (!status)
+		return false;
+
+	load_uniforms();
+	return true;
+}
+
+void
+program::load_uniforms()
+{
+	uniforms_.clear();
+
+	GLint count, max_length;
+	GL_CHECK(glGetProgramiv(id_, GL_ACTIVE_UNIFORMS, &count));
+	GL_CHECK(glGetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length));
+
+	std::vector<GLchar> name(max_length + 1);
+
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		GL_CHECK(glGetActiveUniform(id_, i, name.size(), &length, &size, &type, &name[0]));
+
+		// members of uniform blocks don't have a location
+		const GLint location = GL_CHECK_R(glGetUniformLocation(id_, &name[0]));
+		if (location == -1)
+			continue;
+
+		// arrays are reported as "name[0]"
+		if (length > 3 && !strcmp(&name[length - 3], "[0]"))
+			length -= 3;
+
+		uniforms_.push_back({ std::string(&name[0], length), location });
+	}
+}
+
+const GLint *
+program::find_uniform(const GLchar *name) const
+{
+	for (const auto& u : uniforms_) {
+		if (u.name == name)
+			return &u.location;
+	}
+
+	return nullptr;
 }
 
 GLint
 program::get_uniform_location(const GLchar *name) const
 {
-	GLint rv = GL_CHECK_R(glGetUniformLocation(id_, name));
-	if (rv == -1)
+	const GLint *location = find_uniform(name);
+	if (!location)
 		panic("get_uniform_location failed for %s\n", name);
-	return rv;
+	return *location;
+}
+
+bool
+program::has_uniform(const GLchar *name) const
+{
+	return find_uniform(name) != nullptr;
+}
+
+void
+program::bind_uniform_block(const GLchar *name, GLuint binding) const
+{
+	const GLuint index = GL_CHECK_R(glGetUniformBlockIndex(id_, name));
+	if (index != GL_INVALID_INDEX)
+		GL_CHECK(glUniformBlockBinding(id_, index, binding));
 }
 
 GLint
@@ -236,7 +361,7 @@ program::set_uniform(GLint location, const rgba& color)
 void
 program::use() const
 {
-	GL_CHECK(glUseProgram(id_));
+	gl_state::use_program(id_);
 }
 
 std::string
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "g2dgl.h"
 #include "shader.h"
@@ -21,12 +22,25 @@ public:
 
 	void initialize();
 	void attach(const shader& shader) const;
-	void link() const;
+	void link();
+
+	// program binaries, see glGetProgramBinary. load_binary() stands in for
+	// attach() and link(), and returns false if the binary is empty or the
+	// driver rejects it
+	static bool binaries_supported();
+	void set_binary_retrievable() const; // call before link()
+	bool get_binary(GLenum& format, std::vector<char>& data) const;
+	bool load_binary(GLenum format, const std::vector<char>& data);
 
 	void bind_attrib_location(GLuint index, const GLchar *name) const;
 	GLint get_attrib_location(const GLchar *name) const;
 
+	// looked up in the table of active uniforms built by link()
 	GLint get_uniform_location(const GLchar *name) const;
+	bool has_uniform(const GLchar *name) const;
+
+	// does nothing if the program doesn't use the block
+	void bind_uniform_block(const GLchar *name, GLuint binding) const;
 
 	void set_uniform_f(const GLchar *name, GLfloat v0) const;
 	void set_uniform_f(const GLchar *name, GLfloat v0, GLfloat v1) const;
@@ -69,7 +83,17 @@ public:
 	std::string get_info_log() const;
 
 private:
+	void load_uniforms();
+	const GLint *find_uniform(const GLchar *name) const;
+
+	struct uniform
+	{
+		std::string name;
+		GLint location;
+	};
+
 	GLuint id_;
+	std::vector<uniform> uniforms_;
 };
 
 }
@@ -0,0 +1,13 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+// Picks the instruction set used by the math kernels. Building with
+// G2D_NO_SIMD defined forces the plain C++ code everywhere. Only NEON is
+// used; see transform.h for why not SSE.
+
+#if !defined(G2D_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define G2D_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+#endif // SIMD_H_
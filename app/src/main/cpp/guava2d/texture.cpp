@@ -1,5 +1,6 @@
 #include <cstdio>
 
+#include "gl_state.h"
 #include "panic.h"
 #include "pixmap.h"
 #include "texture.h"
@@ -38,13 +39,14 @@ texture::texture(pixmap *pm)
 
 texture::~texture()
 {
+	gl_state::texture_deleted(texture_id_);
 	GL_CHECK(glDeleteTextures(1, &texture_id_));
 }
 
 void
 texture::bind() const
 {
-	GL_CHECK(glBindTexture(GL_TEXTURE_2D, texture_id_));
+	gl_state::bind_texture(0, texture_id_);
 }
 
 void
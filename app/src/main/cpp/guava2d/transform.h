@@ -0,0 +1,114 @@
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+
+#include <cstddef>
+
+#include "simd.h"
+#include "vec2.h"
+#include "vec3.h"
+
+namespace g2d {
+
+// Transform count points by a single matrix. in and out may point to the
+// same array. The results match applying operator* to each point, up to
+// rounding where the compiler fuses the scalar multiply-adds.
+//
+// On ARM the points go through NEON, which loads and stores them
+// deinterleaved; that hasn't been timed on a device yet, tools/math_bench
+// does it. Elsewhere this is transform_points_scalar: on x86 at -O3, SSE
+// kernels were never faster than the plain loop, which GCC schedules and
+// vectorizes well enough, and mat4 x vec3 in batches of 4 ran at about
+// 0.6-0.8x its speed.
+//
+// Everything is inline: the usual caller transforms a single quad, and for
+// four points a function call costs about as much as the arithmetic.
+
+// the kernels treat arrays of points as arrays of floats
+static_assert(sizeof(vec2) == 2*sizeof(float), "vec2 must be packed");
+static_assert(sizeof(vec3) == 3*sizeof(float), "vec3 must be packed");
+
+inline void
+transform_points_scalar(const mat3& m, const vec2 *in, vec2 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = m*in[i];
+}
+
+inline void
+transform_points_scalar(const mat4& m, const vec3 *in, vec3 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = m*in[i];
+}
+
+#if defined(G2D_SIMD_NEON)
+
+inline void
+transform_points(const mat3& m, const vec2 *in, vec2 *out, size_t count)
+{
+	const float32x4_t c0 = vdupq_n_f32(m.m00), c1 = vdupq_n_f32(m.m01), c2 = vdupq_n_f32(m.m02);
+	const float32x4_t c3 = vdupq_n_f32(m.m10), c4 = vdupq_n_f32(m.m11), c5 = vdupq_n_f32(m.m12);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const float32x4x2_t p = vld2q_f32(&in[i].x);
+
+		float32x4x2_t r;
+		r.val[0] = vaddq_f32(vaddq_f32(vmulq_f32(c0, p.val[0]), vmulq_f32(c1, p.val[1])), c2);
+		r.val[1] = vaddq_f32(vaddq_f32(vmulq_f32(c3, p.val[0]), vmulq_f32(c4, p.val[1])), c5);
+
+		vst2q_f32(&out[i].x, r);
+	}
+
+	for (; i < count; i++)
+		out[i] = m*in[i];
+}
+
+inline void
+transform_points(const mat4& m, const vec3 *in, vec3 *out, size_t count)
+{
+	const float32x4_t c11 = vdupq_n_f32(m.m11), c12 = vdupq_n_f32(m.m12);
+	const float32x4_t c13 = vdupq_n_f32(m.m13), c14 = vdupq_n_f32(m.m14);
+	const float32x4_t c21 = vdupq_n_f32(m.m21), c22 = vdupq_n_f32(m.m22);
+	const float32x4_t c23 = vdupq_n_f32(m.m23), c24 = vdupq_n_f32(m.m24);
+	const float32x4_t c31 = vdupq_n_f32(m.m31), c32 = vdupq_n_f32(m.m32);
+	const float32x4_t c33 = vdupq_n_f32(m.m33), c34 = vdupq_n_f32(m.m34);
+
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const float32x4x3_t p = vld3q_f32(&in[i].x);
+		const float32x4_t x = p.val[0], y = p.val[1], z = p.val[2];
+
+		float32x4x3_t r;
+		r.val[0] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(c11, x), vmulq_f32(c12, y)), vmulq_f32(c13, z)), c14);
+		r.val[1] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(c21, x), vmulq_f32(c22, y)), vmulq_f32(c23, z)), c24);
+		r.val[2] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(c31, x), vmulq_f32(c32, y)), vmulq_f32(c33, z)), c34);
+
+		vst3q_f32(&out[i].x, r);
+	}
+
+	for (; i < count; i++)
+		out[i] = m*in[i];
+}
+
+#else
+
+inline void
+transform_points(const mat3& m, const vec2 *in, vec2 *out, size_t count)
+{
+	transform_points_scalar(m, in, out, count);
+}
+
+inline void
+transform_points(const mat4& m, const vec3 *in, vec3 *out, size_t count)
+{
+	transform_points_scalar(m, in, out, count);
+}
+
+#endif
+
+}
+
+#endif // TRANSFORM_H_
@@ -14,6 +14,7 @@
 hint_text_box::hint_text_box(const hint &h, float cell_size, float width, const gradient& g)
     : width_(width)
     , text_box_(width)
+    , title_layout_(get_font(font::medium), text_align::CENTER, L"hint!")
     , state_tics_(0)
     , tics_(0)
     , state_(state::INTRO)
@@ -95,11 +96,10 @@ void hint_text_box::draw() const
     const g2d::rgba text_color(base_color, alpha);
     const g2d::rgba outline_color(.5 * base_color, alpha);
 
-    render::set_text_align(text_align::CENTER);
     render::set_color({1.f, 1.f, 1.f, alpha});
     render::set_blend_mode(blend_mode::ALPHA_BLEND);
 
-    render::draw_text(get_font(font::medium), {0, .5f * text_box_.get_height()}, 55, outline_color, text_color, L"hint!");
+    render::draw_text(title_layout_, {0, .5f * text_box_.get_height()}, 55, outline_color, text_color);
 
     render::pop_matrix();
 }
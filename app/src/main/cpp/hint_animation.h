@@ -39,6 +39,7 @@ private:
     g2d::vec2 pos_;
     float width_;
     text_box text_box_;
+    render::text_layout title_layout_;
 
     int state_tics_, tics_;
     enum class state
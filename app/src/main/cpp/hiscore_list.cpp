@@ -16,6 +16,7 @@ public:
 
     void redraw() const;
     void update(uint32_t dt);
+    bool get_damage(std::vector<render::box> &damage);
 
     void on_touch_down(float x, float y);
     void on_touch_up();
@@ -40,6 +41,7 @@ private:
         IDLE,
         OUTRO
     } state_;
+    bool was_idle_; // at the last get_damage()
 };
 
 hiscore_list_impl::hiscore_list_impl()
@@ -62,6 +64,7 @@ void hiscore_list_impl::reset()
     state_ = INTRO;
     state_tics_ = 0;
     touch_is_down_ = false;
+    was_idle_ = false;
 
     leaderboard_.reset();
 
@@ -135,6 +138,19 @@ void hiscore_list_impl::update(uint32_t dt)
     }
 }
 
+bool hiscore_list_impl::get_damage(std::vector<render::box> &damage)
+{
+    const bool background_settled = get_prev_state()->get_damage(damage);
+    leaderboard_.get_damage(damage);
+
+    // sliding in or out, or just done
+    const bool idle = state_ == IDLE;
+    const bool was_idle = was_idle_;
+    was_idle_ = idle;
+
+    return background_settled && idle && was_idle;
+}
+
 void hiscore_list_impl::on_touch_down(float x, float y)
 {
     if (pause_button_.on_touch_down(x, y))
@@ -208,6 +224,11 @@ void hiscore_list_state::update(uint32_t dt)
     impl_->update(dt);
 }
 
+bool hiscore_list_state::get_damage(std::vector<render::box> &damage)
+{
+    return impl_->get_damage(damage);
+}
+
 void hiscore_list_state::on_touch_down(float x, float y)
 {
     impl_->on_touch_down(x, y);
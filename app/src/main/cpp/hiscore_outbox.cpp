@@ -0,0 +1,100 @@
+#include "hiscore_outbox.h"
+
+#include "kasui.h"
+#include "save_queue.h"
+#include "utf8.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+std::string new_submission_key()
+{
+    std::random_device rd;
+
+    std::stringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (int i = 0; i < 4; i++)
+        ss << std::setw(4) << (rd() & 0xffff);
+
+    return ss.str();
+}
+
+} // namespace
+
+hiscore_outbox::hiscore_outbox(const std::string &path)
+    : path_(path)
+{
+    load();
+}
+
+void hiscore_outbox::add(int score, const wchar_t *name)
+{
+    unsigned char *name_utf8 = wchar_to_utf8(name);
+    submissions_.push_back({new_submission_key(), score, reinterpret_cast<const char *>(name_utf8)});
+    delete[] name_utf8;
+
+    save();
+}
+
+void hiscore_outbox::remove_first(size_t count)
+{
+    submissions_.erase(submissions_.begin(), submissions_.begin() + std::min(count, submissions_.size()));
+    save();
+}
+
+// one "key:score:name\n" line per submission; the name goes last since it
+// may contain colons
+
+void hiscore_outbox::load()
+{
+    if (FILE *in = fopen(path_.c_str(), "r")) {
+        char line[512];
+
+        while (fgets(line, sizeof line, in)) {
+            char *key = line;
+
+            char *score = strchr(key, ':');
+            if (!score)
+                break;
+            *score++ = '\0';
+
+            char *name = strchr(score, ':');
+            if (!name)
+                break;
+            *name++ = '\0';
+
+            name[strcspn(name, "\n")] = '\0';
+
+            submissions_.push_back({key, atoi(score), name});
+        }
+
+        fclose(in);
+    }
+}
+
+void hiscore_outbox::save() const
+{
+    auto &queue = kasui::get_instance().get_save_queue();
+
+    // nothing left to send, don't leave an empty file behind
+    if (submissions_.empty()) {
+        queue.remove(path_);
+        return;
+    }
+
+    std::string data;
+
+    for (const auto &p : submissions_)
+        data += p.key + ':' + std::to_string(p.score) + ':' + p.name + '\n';
+
+    queue.save(path_, std::move(data));
+}
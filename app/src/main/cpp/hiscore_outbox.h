@@ -0,0 +1,44 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+// Hiscores waiting to be sent to the leaderboard server. The queue is saved
+// to disk whenever it changes, so submissions survive the app being killed
+// while offline.
+
+class hiscore_outbox : private noncopyable
+{
+public:
+    struct submission
+    {
+        // random, lets the server drop a submission it has already seen when
+        // a retry crosses a response that got lost
+        std::string key;
+        int score;
+        std::string name; // UTF-8
+    };
+
+    hiscore_outbox(const std::string &path);
+
+    void add(int score, const wchar_t *name);
+
+    bool empty() const { return submissions_.empty(); }
+    size_t size() const { return submissions_.size(); }
+
+    // oldest first
+    const submission &operator[](size_t index) const { return submissions_[index]; }
+
+    // called once the server has accepted the first count submissions
+    void remove_first(size_t count);
+
+private:
+    void load();
+    void save() const;
+
+    std::string path_;
+    std::deque<submission> submissions_;
+};
@@ -4,11 +4,12 @@
 #include <cstring>
 
 #include <fcntl.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include <cassert>
 
-#include <map>
+#include <algorithm>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -16,45 +17,64 @@
 #include <stdint.h>
 
 #include <sys/socket.h>
-#include <sys/time.h> // gettimeofday
 #include <sys/types.h>
 
-#include <netdb.h>
-
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
 #include "http_request.h"
 #include "log.h"
+#include "reactor.h"
+#include "resolver.h"
 
-#define ASYNC_DNS
-
-class http_request_impl
+class http_request_impl : public reactor::handler
 {
 public:
+    using body_delegate = http_request::body_delegate;
     using completion_delegate = http_request::completion_delegate;
 
-    http_request_impl();
+    http_request_impl(reactor &r, resolver &dns);
     ~http_request_impl();
 
     http_request_impl(const http_request_impl &) = delete;
     http_request_impl &operator=(const http_request_impl &) = delete;
 
-    bool get(const char *url, const completion_delegate &delegate);
-    bool poll();
+    void set_header(const std::string &name, const std::string &value);
+
+    bool get(const char *url, const body_delegate &on_body, const completion_delegate &on_completed);
+    bool done() const { return state_ == nullptr; }
+
+    // a request written to a pooled connection may find it was closed by the
+    // server in the meantime; if so, try again once on a fresh connection
+    bool can_retry() const { return reused_connection_ && !retried_; }
+    void retry();
 
     class state
     {
     public:
         virtual ~state() {}
         virtual void initialize(http_request_impl &req) = 0;
-        virtual void poll(http_request_impl &req) = 0;
+        virtual void on_ready(http_request_impl &req, int events) = 0;
+        virtual void on_timeout(http_request_impl &req);
     };
 
     void set_state(state *s);
 
     void on_error();
-    void on_completed(int status, const char *content, size_t content_len);
+    void on_body(int status, const char *data, size_t size);
+    void on_completed(int status, bool keep_alive);
+
+    void on_ready(int fd, int events) override;
+
+    // the socket used by the current state, owned by the request
+    int get_fd() const { return fd_; }
+    bool set_fd(int fd, int events);
+    bool wait_for(int events);
+    void close_fd();
+
+    // calls the current state's on_timeout if it's still around after ms
+    void set_timeout(unsigned ms);
+    void cancel_timeout();
 
     const std::string &get_host() const { return host_; }
 
@@ -62,127 +82,131 @@ public:
 
     const std::string &get_path() const { return path_; }
 
-    void cache_addr(const std::string &host, const std::vector<in_addr_t> &addr);
+    const std::string &get_headers() const { return headers_; }
+
+    resolver &get_resolver() const { return resolver_; }
 
 private:
-    void init_request();
+    void connect();
 
-    completion_delegate delegate_;
+    reactor &reactor_;
+    resolver &resolver_;
+    body_delegate body_delegate_;
+    completion_delegate completion_delegate_;
     state *state_;
+    int fd_;
+    int timer_;
     std::string host_;
     int port_;
     std::string path_;
-
-    // adios, thread safety
-    static std::map<std::string, std::vector<in_addr_t>> cache_;
+    std::string headers_;
+    bool reused_connection_;
+    bool retried_;
 };
 
-std::map<std::string, std::vector<in_addr_t>> http_request_impl::cache_;
-
 namespace {
 
 const int DEFAULT_PORT = 80;
 
 const int CONNECT_TIMEOUT = 5000;
 
-#ifdef ASYNC_DNS
-const int DNS_PORT = 53;
-const unsigned DNS_RESOLVE_TIMEOUT = 3000;
-const in_addr_t NAMESERVER_ADDR = 0x08080808;
-
-struct dns_header
-{
-    uint16_t id;         // identification number
-    uint8_t rd : 1;      // recursion desired
-    uint8_t tc : 1;      // truncated message
-    uint8_t aa : 1;      // authoritive answer
-    uint8_t opcode : 4;  // purpose of message
-    uint8_t qr : 1;      // query/response flag
-    uint8_t rcode : 4;   // response code
-    uint8_t cd : 1;      // checking disabled
-    uint8_t ad : 1;      // authenticated data
-    uint8_t z : 1;       // its z! reserved
-    uint8_t ra : 1;      // recursion available
-    uint16_t q_count;    // number of question enties
-    uint16_t ans_count;  // number of answer entries
-    uint16_t auth_count; // number of authority entries
-    uint16_t add_count;  // number of resource entries
-};
+const unsigned DNS_RESOLVE_TIMEOUT = 10000;
 
-struct dns_question
-{
-    uint16_t qtype;
-    uint16_t qclass;
-};
-#endif
+// with no progress sending the request or receiving the response for this
+// long, the peer is assumed gone
+const unsigned SEND_TIMEOUT = 5000;
+const unsigned RECEIVE_TIMEOUT = 10000;
 
-uint64_t now()
-{
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return tv.tv_sec * 1000ull + tv.tv_usec / 1000ull;
-}
+// a pooled connection may have been dropped without the server telling us;
+// if nothing arrives this soon, try again on a fresh one
+const unsigned REUSED_RESPONSE_TIMEOUT = 3000;
 
-bool set_nonblocking(int fd)
+const size_t MAX_IDLE_CONNECTIONS = 4;
+const unsigned MAX_IDLE_TIME = 60000;
+
+const size_t MAX_LINE_LENGTH = 8192;
+
+// Keeps connections to servers that agreed to keep them alive, so that back
+// to back requests to the same host don't pay for a new TCP handshake.
+
+class connection_pool
 {
-    int status = fcntl(fd, F_GETFL, 0);
-    if (status != -1)
-        status = fcntl(fd, F_SETFL, status | O_NONBLOCK);
+public:
+    ~connection_pool();
 
-    return status != -1;
+    // returns -1 if there's no usable idle connection to host:port
+    int checkout(const std::string &host, int port);
+    void checkin(const std::string &host, int port, int fd);
+
+private:
+    struct connection
+    {
+        std::string host;
+        int port;
+        int fd;
+        uint64_t idle_since;
+    };
+
+    std::vector<connection> idle_;
+};
+
+connection_pool::~connection_pool()
+{
+    for (const auto &c : idle_)
+        close(c.fd);
 }
 
-int is_readable(int fd)
+int connection_pool::checkout(const std::string &host, int port)
 {
-    assert(fd != -1);
+    const uint64_t now = reactor::now();
 
-    fd_set fds;
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        const auto &c = *it;
 
-    FD_ZERO(&fds);
-    FD_SET(fd, &fds);
+        if (c.host != host || c.port != port) {
+            ++it;
+            continue;
+        }
 
-    struct timeval tv = {0, 0};
+        const int fd = c.fd;
+        const bool expired = now - c.idle_since > MAX_IDLE_TIME;
 
-    switch (select(fd + 1, &fds, nullptr, nullptr, &tv)) {
-        case -1:
-            // wtf?
-            log_err("select: %s", strerror(errno));
-            return -1;
+        it = idle_.erase(it);
 
-        case 0:
-            return 0;
+        // an idle connection shouldn't be readable: if it is, the server
+        // either closed it or sent something we didn't ask for
+        char ch;
+        if (!expired && recv(fd, &ch, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return fd;
 
-        default:
-            return FD_ISSET(fd, &fds);
+        close(fd);
     }
+
+    return -1;
 }
 
-int is_writeable(int fd)
+void connection_pool::checkin(const std::string &host, int port, int fd)
 {
-    assert(fd != -1);
-
-    fd_set fds;
-
-    FD_ZERO(&fds);
-    FD_SET(fd, &fds);
+    if (idle_.size() == MAX_IDLE_CONNECTIONS) {
+        close(idle_.front().fd);
+        idle_.erase(idle_.begin());
+    }
 
-    struct timeval tv = {0, 0};
+    idle_.push_back(connection{host, port, fd, reactor::now()});
+}
 
-    switch (select(fd + 1, nullptr, &fds, nullptr, &tv)) {
-        case -1:
-            // wtf?
-            log_err("select: %s", strerror(errno));
-            return -1;
+// adios, thread safety
+connection_pool idle_connections;
 
-        case 0:
-            return 0;
+bool set_nonblocking(int fd)
+{
+    int status = fcntl(fd, F_GETFL, 0);
+    if (status != -1)
+        status = fcntl(fd, F_SETFL, status | O_NONBLOCK);
 
-        default:
-            return FD_ISSET(fd, &fds);
-    }
+    return status != -1;
 }
 
-#ifdef ASYNC_DNS
 class resolving_state : public http_request_impl::state
 {
 public:
@@ -190,305 +214,137 @@ public:
     ~resolving_state() override;
 
     void initialize(http_request_impl &req) override;
-    void poll(http_request_impl &req) override;
+    void on_ready(http_request_impl &, int) override {}
+    void on_timeout(http_request_impl &req) override;
 
 private:
-    void send_request(http_request_impl &req);
-
-    struct sockaddr_in dns_addr_;
-    int dns_fd_;
-    uint64_t start_time_;
-    int retry_count_;
+    resolver *resolver_;
+    int query_;
 };
-#endif
 
-class resolved_state : public http_request_impl::state
-{
-public:
-    resolved_state(int fd);
-
-    void initialize(http_request_impl &) override {}
-    void poll(http_request_impl &) override;
-
-    virtual int is_ready() const = 0;
-    virtual void on_ready(http_request_impl &) = 0;
-
-    virtual unsigned timeout() const = 0;
-
-    void close();
-
-protected:
-    int fd_;
-
-private:
-    uint64_t last_update_;
-};
-
-class connecting_state : public resolved_state
+class connecting_state : public http_request_impl::state
 {
 public:
     connecting_state(const std::vector<in_addr_t> &addr);
 
     void initialize(http_request_impl &req) override;
-
-    int is_ready() const override { return is_writeable(fd_); }
-
-    void on_ready(http_request_impl &req) override;
-
-    unsigned timeout() const override { return CONNECT_TIMEOUT; }
+    void on_ready(http_request_impl &req, int events) override;
 
 private:
     std::vector<in_addr_t> addr_;
 };
 
-class writing_request_state : public resolved_state
+class writing_request_state : public http_request_impl::state
 {
 public:
-    writing_request_state(int fd, const std::string &host, int port, const std::string &path);
-
-    int is_ready() const override { return is_writeable(fd_); }
+    writing_request_state(const http_request_impl &req);
 
-    void on_ready(http_request_impl &req) override;
-
-    unsigned timeout() const override { return 0; }
+    void initialize(http_request_impl &req) override;
+    void on_ready(http_request_impl &req, int events) override;
+    void on_timeout(http_request_impl &req) override;
 
 private:
     std::string request_;
     size_t bytes_written_;
 };
 
-class reading_response_state : public resolved_state
+class reading_response_state : public http_request_impl::state
 {
 public:
-    reading_response_state(int fd);
-
-    int is_ready() const override { return is_readable(fd_); }
+    reading_response_state();
 
-    void on_ready(http_request_impl &req) override;
-
-    unsigned timeout() const override { return 0; }
+    void initialize(http_request_impl &req) override;
+    void on_ready(http_request_impl &req, int events) override;
+    void on_timeout(http_request_impl &req) override;
 
 private:
-    bool on_read(const char *buf, ssize_t size);
+    bool on_read(http_request_impl &req, const char *buf, size_t size);
+    bool on_line(const std::string &line);
+    bool on_status_line(const std::string &line);
+    bool on_header(const std::string &line);
+    void on_headers_end();
 
-    int parse_state_;
+    void on_closed(http_request_impl &req);
+
+    enum class parse_state
+    {
+        STATUS_LINE,
+        HEADERS,
+        BODY,           // Content-Length bytes
+        BODY_UNTIL_EOF, // no framing, read until the server closes
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        TRAILERS,
+        DONE,
+    } parse_state_;
+
+    std::string line_;
+    size_t bytes_left_; // in the body or current chunk
+    bool received_data_;
 
     int status_;
-    std::vector<char> content_;
+    bool has_content_length_;
+    bool chunked_;
+    bool keep_alive_;
 };
 
-#ifdef ASYNC_DNS
 resolving_state::resolving_state()
-    : dns_fd_(-1)
-    , start_time_(0)
-    , retry_count_(3)
+    : resolver_(nullptr)
+    , query_(-1)
 {
-    memset(&dns_addr_, 0, sizeof(dns_addr_));
-    dns_addr_.sin_family = AF_INET;
-    dns_addr_.sin_port = htons(DNS_PORT);
-    dns_addr_.sin_addr.s_addr = htonl(NAMESERVER_ADDR);
 }
 
 resolving_state::~resolving_state()
 {
+    if (query_ != -1)
+        resolver_->cancel(query_);
 }
 
 void resolving_state::initialize(http_request_impl &req)
 {
-    dns_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (dns_fd_ == -1) {
-        log_err("socket: %s", strerror(errno));
-        req.on_error();
-        return;
-    }
-
-    send_request(req);
-}
-
-void resolving_state::send_request(http_request_impl &req)
-{
-    uint8_t request_buf[65536];
-
-    dns_header *header = reinterpret_cast<dns_header *>(request_buf);
-    header->id = htons(rand());
-    header->qr = 0;     // query
-    header->opcode = 0; // standard query or reverse lookup?
-    header->aa = 0;     // not authoritative
-    header->tc = 0;     // not truncated
-    header->rd = 1;     // recursion desired
-    header->ra = 0;     // recursion not available
-    header->z = 0;
-    header->ad = 0;
-    header->cd = 0;
-    header->rcode = 0;
-    header->q_count = htons(1); // # of questions
-    header->ans_count = 0;
-    header->auth_count = 0;
-    header->add_count = 0;
-
-    uint8_t *dest = &request_buf[sizeof(dns_header)];
-    const char *src = req.get_host().c_str();
-
-    while (*src) {
-        const char *sep = strchr(src, '.');
-        if (sep == nullptr)
-            sep = src + strlen(src);
-
-        size_t len = sep - src;
+    resolver_ = &req.get_resolver();
 
-        *dest++ = len;
-        memcpy(dest, src, len);
-        dest += len;
-
-        src = sep;
-        if (*src == '.')
-            ++src;
-    }
-
-    ++dest;
-
-    dns_question *question = reinterpret_cast<dns_question *>(dest);
-    question->qtype = htons(1);  // (A) record
-    question->qclass = htons(1); // internet
-
-    size_t request_len = sizeof(dns_header) + req.get_host().size() + 2 + sizeof(dns_question);
-
-    ssize_t n = sendto(dns_fd_, request_buf, request_len, 0, reinterpret_cast<struct sockaddr *>(&dns_addr_),
-                       sizeof(dns_addr_));
-    if (n == -1) {
-        log_err("sendto: %s", strerror(errno));
-        req.on_error();
-        return;
-    }
+    query_ = resolver_->resolve(req.get_host(), [this, &req](const resolver::address_list &addrs) {
+        query_ = -1;
 
-    log_debug("dns query sent");
-
-    set_nonblocking(dns_fd_);
-
-    start_time_ = now();
-}
-
-void resolving_state::poll(http_request_impl &req)
-{
-    assert(dns_fd_ != -1);
-
-    uint8_t response_buf[65536];
-
-    socklen_t addr_len = sizeof(dns_addr_);
-    ssize_t n = recvfrom(dns_fd_, response_buf, sizeof(response_buf), 0,
-                         reinterpret_cast<struct sockaddr *>(&dns_addr_), &addr_len);
-
-    if (n < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            log_err("recvfrom: %s", strerror(errno));
+        if (addrs.empty())
             req.on_error();
-        } else {
-            if (now() - start_time_ > DNS_RESOLVE_TIMEOUT) {
-                log_err("timed out waiting for DNS query response");
-
-                if (!retry_count_) {
-                    req.on_error();
-                } else {
-                    --retry_count_;
-                    send_request(req);
-                }
-            }
-        }
-
-        return;
-    }
+        else
+            req.set_state(new connecting_state(addrs));
+    });
 
-#if 0
-45 67 81 80 00 01 00 01 00 00 00 00 06 67 6F 6F         .g...........goo
-67 6C 65 03 63 6F 6D 00 00 01 00 01 C0 0C 00 01         gle.com.........
-00 01 00 00 00 90 00 04 D8 3A DB EE                     ............
-
-#endif
-    log_debug("dns query response received");
-
-    const unsigned char *p = response_buf + sizeof(dns_header) + req.get_host().size() + 2 + sizeof(dns_question);
-
-    std::vector<in_addr_t> addr_list;
-
-    while (p - response_buf < n) {
-        if (p[0] != 0xc0 || p[2] != 0x00 || p[3] != 0x01 || p[4] != 0x00 || p[5] != 0x01)
-            break;
-
-        log_debug("addr: %d.%d.%d.%d", p[12], p[13], p[14], p[15]);
-
-        in_addr_t addr = htonl(p[15] | (p[14] << 8) | (p[13] << 16) | (p[12] << 24));
-        addr_list.push_back(addr);
-
-        p += 16;
-    }
-
-    if (addr_list.empty()) {
-        log_err("invalid dns query response");
-        req.on_error();
-    } else {
-        req.cache_addr(req.get_host(), addr_list);
-        req.set_state(new connecting_state(addr_list));
-    }
-}
-#endif
-
-resolved_state::resolved_state(int fd)
-    : fd_(fd)
-    , last_update_(now())
-{
-}
-
-void resolved_state::close()
-{
-    if (fd_ != -1) {
-        ::close(fd_);
-        fd_ = -1;
-    }
+    req.set_timeout(DNS_RESOLVE_TIMEOUT);
 }
 
-void resolved_state::poll(http_request_impl &req)
+void resolving_state::on_timeout(http_request_impl &req)
 {
-    switch (is_ready()) {
-        case -1:
-            req.on_error();
-            return;
-
-        case 0:
-            // timed out
-            if (timeout() != 0) {
-                if (now() - last_update_ > timeout()) {
-                    log_err("timed out");
-                    req.on_error();
-                    return;
-                }
-            }
-            break;
-
-        default:
-            last_update_ = now();
-            on_ready(req);
-            break;
-    }
+    log_err("timed out resolving `%s'", req.get_host().c_str());
+    req.on_error();
 }
 
 connecting_state::connecting_state(const std::vector<in_addr_t> &addr)
-    : resolved_state(-1)
-    , addr_(addr)
+    : addr_(addr)
 {
 }
 
 void connecting_state::initialize(http_request_impl &req)
 {
-    fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (fd_ == -1) {
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd == -1) {
         log_err("socket: %s", strerror(errno));
         req.on_error();
         return;
     }
 
-    if (!set_nonblocking(fd_)) {
+    if (!set_nonblocking(fd)) {
         log_err("set_nonblocking: %s", strerror(errno));
-        close();
+        ::close(fd);
+        req.on_error();
+        return;
+    }
+
+    if (!req.set_fd(fd, reactor::WRITEABLE)) {
         req.on_error();
         return;
     }
@@ -500,21 +356,23 @@ void connecting_state::initialize(http_request_impl &req)
 
     log_debug("connecting to %s", inet_ntoa(sin.sin_addr));
 
-    if (::connect(fd_, reinterpret_cast<struct sockaddr *>(&sin), sizeof(sin)) == -1) {
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&sin), sizeof(sin)) == -1) {
         if (errno != EINPROGRESS) {
             log_err("connect: %s", strerror(errno));
-            close();
             req.on_error();
+            return;
         }
     }
+
+    req.set_timeout(CONNECT_TIMEOUT);
 }
 
-void connecting_state::on_ready(http_request_impl &req)
+void connecting_state::on_ready(http_request_impl &req, int)
 {
     int status;
     socklen_t len = sizeof(status);
 
-    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &status, &len) < 0) {
+    if (getsockopt(req.get_fd(), SOL_SOCKET, SO_ERROR, &status, &len) < 0) {
         log_err("getsockopt: %s", strerror(errno));
         req.on_error();
         return;
@@ -528,12 +386,11 @@ void connecting_state::on_ready(http_request_impl &req)
 
     log_debug("connected!");
 
-    req.set_state(new writing_request_state(fd_, req.get_host(), req.get_port(), req.get_path()));
+    req.set_state(new writing_request_state(req));
 }
 
-writing_request_state::writing_request_state(int fd, const std::string &host, int port, const std::string &path)
-    : resolved_state(fd)
-    , bytes_written_(0)
+writing_request_state::writing_request_state(const http_request_impl &req)
+    : bytes_written_(0)
 {
     // GET /foo/bar HTTP/1.0
     // Host: localhost:4321
@@ -544,28 +401,40 @@ writing_request_state::writing_request_state(int fd, const std::string &host, in
 
     std::stringstream ss;
 
-    ss << "GET " << path << " HTTP/1.0\r\n";
+    ss << "GET " << req.get_path() << " HTTP/1.1\r\n";
 
-    ss << "Host: " << host;
-    if (port != DEFAULT_PORT)
-        ss << ":" << port;
+    ss << "Host: " << req.get_host();
+    if (req.get_port() != DEFAULT_PORT)
+        ss << ":" << req.get_port();
     ss << "\r\n";
 
     ss << "User-Agent: kasui/0.1\r\n";
 
+    ss << req.get_headers();
+
     ss << "\r\n";
 
     request_ = ss.str();
 }
 
-void writing_request_state::on_ready(http_request_impl &req)
+void writing_request_state::initialize(http_request_impl &req)
+{
+    req.wait_for(reactor::WRITEABLE);
+    req.set_timeout(SEND_TIMEOUT);
+}
+
+void writing_request_state::on_ready(http_request_impl &req, int)
 {
     while (bytes_written_ < request_.size()) {
-        ssize_t n = send(fd_, &request_[bytes_written_], request_.size() - bytes_written_, 0);
+        ssize_t n = send(req.get_fd(), &request_[bytes_written_], request_.size() - bytes_written_, MSG_NOSIGNAL);
         if (n < 0) {
             if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                log_err("send: %s", strerror(errno));
-                req.on_error();
+                if (bytes_written_ == 0 && req.can_retry()) {
+                    req.retry();
+                } else {
+                    log_err("send: %s", strerror(errno));
+                    req.on_error();
+                }
                 return;
             }
 
@@ -579,27 +448,59 @@ void writing_request_state::on_ready(http_request_impl &req)
 
     if (bytes_written_ == request_.size()) {
         log_debug("request written");
-        req.set_state(new reading_response_state(fd_));
+        req.set_state(new reading_response_state);
+    } else {
+        req.set_timeout(SEND_TIMEOUT);
     }
 }
 
-reading_response_state::reading_response_state(int fd)
-    : resolved_state(fd)
-    , parse_state_(0)
+void writing_request_state::on_timeout(http_request_impl &req)
+{
+    if (req.can_retry()) {
+        req.retry();
+    } else {
+        log_err("timed out sending request");
+        req.on_error();
+    }
+}
+
+reading_response_state::reading_response_state()
+    : parse_state_(parse_state::STATUS_LINE)
+    , bytes_left_(0)
+    , received_data_(false)
     , status_(0)
+    , has_content_length_(false)
+    , chunked_(false)
+    , keep_alive_(false)
 {
 }
 
-void reading_response_state::on_ready(http_request_impl &req)
+void reading_response_state::initialize(http_request_impl &req)
+{
+    req.wait_for(reactor::READABLE);
+    req.set_timeout(req.can_retry() ? REUSED_RESPONSE_TIMEOUT : RECEIVE_TIMEOUT);
+}
+
+void reading_response_state::on_timeout(http_request_impl &req)
+{
+    if (!received_data_ && req.can_retry()) {
+        req.retry();
+    } else {
+        log_err("timed out receiving response");
+        req.on_error();
+    }
+}
+
+void reading_response_state::on_ready(http_request_impl &req, int)
 {
     for (;;) {
-        char buf[512];
+        char buf[4096];
 
-        ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        ssize_t n = recv(req.get_fd(), buf, sizeof(buf), 0);
         if (n < 0) {
             if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 if (errno == ECONNRESET) {
-                    req.on_completed(status_, &content_[0], content_.size());
+                    on_closed(req);
                 } else {
                     log_err("recv: %s", strerror(errno));
                     req.on_error();
@@ -610,138 +511,267 @@ void reading_response_state::on_ready(http_request_impl &req)
         }
 
         if (n == 0) {
-            req.on_completed(status_, &content_[0], content_.size());
+            on_closed(req);
             return;
         }
 
         log_debug("read %zd bytes", n);
 
-        if (!on_read(buf, n)) {
+        received_data_ = true;
+        req.set_timeout(RECEIVE_TIMEOUT);
+
+        if (!on_read(req, buf, n)) {
             req.on_error();
             return;
         }
+
+        if (parse_state_ == parse_state::DONE) {
+            req.on_completed(status_, keep_alive_);
+            return;
+        }
+    }
+}
+
+void reading_response_state::on_closed(http_request_impl &req)
+{
+    if (parse_state_ == parse_state::BODY_UNTIL_EOF) {
+        req.on_completed(status_, false);
+    } else if (!received_data_ && req.can_retry()) {
+        req.retry();
+    } else {
+        log_err("connection closed before end of response");
+        req.on_error();
     }
 }
 
-bool reading_response_state::on_read(const char *buf, ssize_t size)
+bool reading_response_state::on_read(http_request_impl &req, const char *buf, size_t size)
 {
-    for (const char *p = buf; p != &buf[size]; p++) {
-        char ch = *p;
+    const char *p = buf;
+    const char *end = buf + size;
 
+    while (p != end) {
         switch (parse_state_) {
-            case 0:
-                // before status
-                if (ch == ' ')
-                    parse_state_ = 1;
+            case parse_state::BODY:
+            case parse_state::CHUNK_DATA: {
+                const size_t n = std::min(bytes_left_, static_cast<size_t>(end - p));
+                req.on_body(status_, p, n);
+                p += n;
+
+                if ((bytes_left_ -= n) == 0)
+                    parse_state_ = parse_state_ == parse_state::BODY ? parse_state::DONE : parse_state::CHUNK_DATA_END;
                 break;
+            }
 
-            case 1:
-                // status
-                if (ch == ' ') {
-                    parse_state_ = 2;
-                } else {
-                    if (ch < '0' || ch > '9')
-                        return false;
-                    status_ = status_ * 10 + ch - '0';
-                }
+            case parse_state::BODY_UNTIL_EOF:
+                req.on_body(status_, p, end - p);
+                p = end;
                 break;
 
-            case 2:
-                // after status, before \r\n\r\n
-                if (ch == '\r')
-                    parse_state_ = 3;
+            case parse_state::DONE:
+                // more than we asked for; don't reuse this connection
+                keep_alive_ = false;
+                p = end;
                 break;
 
-            case 3:
-                switch (ch) {
-                    case '\n':
-                        parse_state_ = 4;
-                        break;
+            default: {
+                const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
 
-                    case '\r':
-                        break;
+                line_.append(p, nl ? nl : end);
+
+                if (line_.size() > MAX_LINE_LENGTH)
+                    return false;
 
-                    default:
-                        parse_state_ = 2;
-                        break;
+                if (!nl) {
+                    p = end;
+                    break;
                 }
-                break;
 
-            case 4:
-                switch (ch) {
-                    case '\r':
-                        parse_state_ = 5;
-                        break;
+                p = nl + 1;
 
-                    default:
-                        parse_state_ = 2;
-                        break;
-                }
+                if (!line_.empty() && line_.back() == '\r')
+                    line_.pop_back();
+
+                if (!on_line(line_))
+                    return false;
+
+                line_.clear();
                 break;
+            }
+        }
+    }
 
-            case 5:
-                switch (ch) {
-                    case '\n':
-                        parse_state_ = 6;
-                        break;
+    return true;
+}
 
-                    case '\r':
-                        parse_state_ = 3;
-                        break;
+bool reading_response_state::on_line(const std::string &line)
+{
+    switch (parse_state_) {
+        case parse_state::STATUS_LINE:
+            return on_status_line(line);
 
-                    default:
-                        parse_state_ = 2;
-                        break;
-                }
-                break;
+        case parse_state::HEADERS:
+            if (line.empty())
+                on_headers_end();
+            else
+                return on_header(line);
+            break;
 
-            case 6:
-                content_.push_back(ch);
-                break;
+        case parse_state::CHUNK_SIZE: {
+            char *end;
+            bytes_left_ = strtoul(line.c_str(), &end, 16); // ignores chunk extensions
+            if (end == line.c_str())
+                return false;
+
+            parse_state_ = bytes_left_ ? parse_state::CHUNK_DATA : parse_state::TRAILERS;
+            break;
         }
+
+        case parse_state::CHUNK_DATA_END:
+            if (!line.empty())
+                return false;
+            parse_state_ = parse_state::CHUNK_SIZE;
+            break;
+
+        case parse_state::TRAILERS:
+            if (line.empty())
+                parse_state_ = parse_state::DONE;
+            break;
+
+        default:
+            assert(0);
     }
 
     return true;
 }
 
+bool reading_response_state::on_status_line(const std::string &line)
+{
+    // HTTP/1.1 200 OK
+
+    int minor_version;
+    if (sscanf(line.c_str(), "HTTP/1.%d %d", &minor_version, &status_) != 2)
+        return false;
+
+    keep_alive_ = minor_version >= 1;
+
+    parse_state_ = parse_state::HEADERS;
+
+    return true;
+}
+
+bool reading_response_state::on_header(const std::string &line)
+{
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos)
+        return false;
+
+    const std::string name = line.substr(0, colon);
+
+    const size_t value_start = line.find_first_not_of(" \t", colon + 1);
+    const std::string value = value_start != std::string::npos ? line.substr(value_start) : std::string();
+
+    if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+        char *end;
+        bytes_left_ = strtoul(value.c_str(), &end, 10);
+        if (end == value.c_str())
+            return false;
+        has_content_length_ = true;
+    } else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+        std::string encoding = value;
+        std::transform(encoding.begin(), encoding.end(), encoding.begin(), ::tolower);
+        chunked_ = encoding.find("chunked") != std::string::npos;
+    } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+        if (strcasecmp(value.c_str(), "close") == 0)
+            keep_alive_ = false;
+        else if (strcasecmp(value.c_str(), "keep-alive") == 0)
+            keep_alive_ = true;
+    }
+
+    return true;
+}
+
+void reading_response_state::on_headers_end()
+{
+    if ((status_ >= 100 && status_ < 200) || status_ == 204 || status_ == 304) {
+        parse_state_ = parse_state::DONE;
+    } else if (chunked_) {
+        parse_state_ = parse_state::CHUNK_SIZE;
+    } else if (has_content_length_) {
+        parse_state_ = bytes_left_ ? parse_state::BODY : parse_state::DONE;
+    } else {
+        parse_state_ = parse_state::BODY_UNTIL_EOF;
+        keep_alive_ = false;
+    }
+}
+
 } // namespace
 
-http_request_impl::http_request_impl()
-    : state_(nullptr)
+void http_request_impl::state::on_timeout(http_request_impl &req)
+{
+    log_err("timed out");
+    req.on_error();
+}
+
+http_request_impl::http_request_impl(reactor &r, resolver &dns)
+    : reactor_(r)
+    , resolver_(dns)
+    , state_(nullptr)
+    , fd_(-1)
+    , timer_(-1)
     , port_(0)
+    , reused_connection_(false)
+    , retried_(false)
 {
 }
 
 http_request_impl::~http_request_impl()
 {
+    set_state(nullptr);
+    close_fd();
 }
 
 void http_request_impl::on_error()
 {
+    close_fd();
+
     http_response resp;
 
     resp.success = false;
-    delegate_(resp);
+    completion_delegate_(resp);
 
     set_state(nullptr);
 }
 
-void http_request_impl::on_completed(int status, const char *content, size_t content_len)
+void http_request_impl::on_body(int status, const char *data, size_t size)
 {
+    if (size > 0)
+        body_delegate_(status, byte_span{data, size});
+}
+
+void http_request_impl::on_completed(int status, bool keep_alive)
+{
+    if (keep_alive && fd_ != -1) {
+        reactor_.unwatch(fd_);
+        idle_connections.checkin(host_, port_, fd_);
+        fd_ = -1;
+    } else {
+        close_fd();
+    }
+
     http_response resp;
 
     resp.success = true;
     resp.status = status;
-    resp.content = content;
-    resp.content_len = content_len;
 
-    delegate_(resp);
+    completion_delegate_(resp);
 
     set_state(nullptr);
 }
 
 void http_request_impl::set_state(state *next_state)
 {
+    cancel_timeout();
+
     if (state_)
         delete state_;
 
@@ -749,9 +779,59 @@ void http_request_impl::set_state(state *next_state)
         state_->initialize(*this);
 }
 
-bool http_request_impl::get(const char *url, const completion_delegate &delegate)
+void http_request_impl::on_ready(int, int events)
 {
-    delegate_ = delegate;
+    if (state_)
+        state_->on_ready(*this, events);
+}
+
+bool http_request_impl::set_fd(int fd, int events)
+{
+    close_fd();
+
+    fd_ = fd;
+
+    return wait_for(events);
+}
+
+bool http_request_impl::wait_for(int events)
+{
+    assert(fd_ != -1);
+    return reactor_.watch(fd_, events, this);
+}
+
+void http_request_impl::close_fd()
+{
+    if (fd_ != -1) {
+        reactor_.unwatch(fd_);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void http_request_impl::set_timeout(unsigned ms)
+{
+    cancel_timeout();
+
+    timer_ = reactor_.add_timer(ms, [this] {
+        timer_ = -1;
+        if (state_)
+            state_->on_timeout(*this);
+    });
+}
+
+void http_request_impl::cancel_timeout()
+{
+    if (timer_ != -1) {
+        reactor_.cancel_timer(timer_);
+        timer_ = -1;
+    }
+}
+
+bool http_request_impl::get(const char *url, const body_delegate &on_body, const completion_delegate &on_completed)
+{
+    body_delegate_ = on_body;
+    completion_delegate_ = on_completed;
 
     port_ = 0;
     host_.clear();
@@ -793,69 +873,75 @@ bool http_request_impl::get(const char *url, const completion_delegate &delegate
     if (!colon)
         port_ = DEFAULT_PORT;
 
-    auto it = cache_.find(host_);
-    if (it != cache_.end()) {
-        set_state(new connecting_state(it->second));
-        return true;
-    }
+    reused_connection_ = retried_ = false;
 
-#ifdef ASYNC_DNS
-    set_state(new resolving_state);
-#else
-    struct hostent *he = gethostbyname(host_.c_str());
-    if (he == 0) {
-        log_err("failed to resolve `%s'", host_.c_str());
-        return false;
-    }
+    connect();
+
+    return true;
+}
+
+void http_request_impl::set_header(const std::string &name, const std::string &value)
+{
+    headers_ += name + ": " + value + "\r\n";
+}
 
-    std::vector<in_addr_t> addr_list;
+void http_request_impl::connect()
+{
+    int fd;
+
+    if (!retried_ && (fd = idle_connections.checkout(host_, port_)) != -1) {
+        log_debug("reusing connection to %s:%d", host_.c_str(), port_);
 
-    for (int i = 0; he->h_addr_list[i]; i++) {
-        in_addr_t addr;
-        memcpy(&addr, he->h_addr_list[i], he->h_length);
+        reused_connection_ = true;
 
-        log_debug("addr: %s", inet_ntoa(*reinterpret_cast<struct in_addr *>(&addr)));
+        if (set_fd(fd, reactor::WRITEABLE))
+            set_state(new writing_request_state(*this));
+        else
+            on_error();
 
-        addr_list.push_back(addr);
+        return;
     }
 
-    cache_addr(host_, addr_list);
+    reused_connection_ = false;
 
-    set_state(new connecting_state(addr_list));
-#endif
+    resolver::address_list addrs;
 
-    return true;
+    if (resolver_.lookup(host_, addrs))
+        set_state(new connecting_state(addrs));
+    else
+        set_state(new resolving_state);
 }
 
-bool http_request_impl::poll()
+void http_request_impl::retry()
 {
-    if (state_)
-        state_->poll(*this);
+    log_debug("connection to %s:%d was closed, retrying", host_.c_str(), port_);
 
-    return state_ != nullptr;
+    retried_ = true;
+    close_fd();
+    connect();
 }
 
-void http_request_impl::cache_addr(const std::string &host, const std::vector<in_addr_t> &addr)
+http_request::http_request(reactor &r, resolver &dns)
+    : impl_(new http_request_impl(r, dns))
 {
-    cache_.insert(std::make_pair(host, addr));
 }
 
-http_request::http_request()
-    : impl_(new http_request_impl)
+http_request::~http_request()
 {
+    delete impl_;
 }
 
-http_request::~http_request()
+void http_request::set_header(const std::string &name, const std::string &value)
 {
-    delete impl_;
+    impl_->set_header(name, value);
 }
 
-bool http_request::get(const char *url, const completion_delegate &delegate)
+bool http_request::get(const char *url, const body_delegate &on_body, const completion_delegate &on_completed)
 {
-    return impl_->get(url, delegate);
+    return impl_->get(url, on_body, on_completed);
 }
 
-bool http_request::poll()
+bool http_request::done() const
 {
-    return impl_->poll();
+    return impl_->done();
 }
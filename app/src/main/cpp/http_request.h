@@ -1,30 +1,44 @@
 #pragma once
 
+#include <cstddef>
 #include <functional>
+#include <string>
+
+// bytes owned by someone else, only valid for the duration of a callback
+struct byte_span
+{
+    const char *data;
+    size_t size;
+};
 
 struct http_response
 {
     bool success;
     int status;
-    const char *content;
-    size_t content_len;
 };
 
 class http_request_impl;
+class reactor;
+class resolver;
 
 class http_request
 {
 public:
+    // called with each piece of the response body as it's received
+    using body_delegate = std::function<void(int status, const byte_span &chunk)>;
     using completion_delegate = std::function<void(const http_response &)>;
 
-    http_request();
+    http_request(reactor &r, resolver &dns);
     ~http_request();
 
     http_request(const http_request &) = delete;
     http_request &operator=(const http_request &) = delete;
 
-    bool get(const char *url, const completion_delegate &delegate);
-    bool poll();
+    // adds a header to the request; call before get()
+    void set_header(const std::string &name, const std::string &value);
+
+    bool get(const char *url, const body_delegate &on_body, const completion_delegate &on_completed);
+    bool done() const;
 
 private:
     http_request_impl *impl_;
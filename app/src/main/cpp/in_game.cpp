@@ -49,6 +49,7 @@ enum
 
     FADE_OUT_TICS = 80 * MS_PER_TIC,
     FADE_IN_TICS = 10 * MS_PER_TIC,
+    BACKGROUND_FADE_TICS = 40 * MS_PER_TIC,
 
     LEVEL_COMPLETED_TICS = 120 * MS_PER_TIC,
 
@@ -63,7 +64,7 @@ struct game_animation
     virtual void draw() const = 0;
     virtual bool update(uint32_t dt);
 
-    std::unique_ptr<abstract_action> action;
+    timeline action;
 };
 
 struct glyph_animation : game_animation
@@ -136,6 +137,7 @@ struct countdown_digit : game_animation
 
     void draw() const override;
 
+    const g2d::program *program;
     const g2d::texture *texture;
 
     float x_center, y_center;
@@ -147,8 +149,8 @@ struct countdown_digit : game_animation
 
 bool game_animation::update(uint32_t dt)
 {
-    action->step(dt);
-    return !action->done();
+    action.step(dt);
+    return !action.done();
 }
 
 glyph_animation::glyph_animation(const g2d::font *font, float glyph_spacing, const wchar_t *message, float x_base,
@@ -264,27 +266,27 @@ level_intro_animation::level_intro_animation(const gradient& g)
 {
     const size_t num_glyphs = glyph_states.size();
 
-    auto *p = new parallel_action_group;
+    parallel_action_group p;
 
     for (size_t i = 0; i < num_glyphs; i++) {
-        p->add((new sequential_action_group)
+        p.add((new sequential_action_group)
                    ->add(new delay_action(i * 15 * MS_PER_TIC))
                    ->add(new property_change_action<out_bounce_tween<float>>(&glyph_states[i].flip, 0, .5 * M_PI,
                                                                              30 * MS_PER_TIC)));
     }
 
     // bump
-    p->add((new sequential_action_group)
+    p.add((new sequential_action_group)
                ->add(new delay_action(45 * MS_PER_TIC))
                ->add(new property_change_action<in_cos_tween<float>>(&scale, 1., 1.2, 10 * MS_PER_TIC))
                ->add(new property_change_action<out_bounce_tween<float>>(&scale, 1.2, 1, 20 * MS_PER_TIC)));
 
     // fade
-    p->add((new sequential_action_group)
+    p.add((new sequential_action_group)
                ->add(new delay_action((num_glyphs * 30 + 20) * MS_PER_TIC))
                ->add(new property_change_action<quadratic_tween<float>>(&alpha, 1, 0, 10 * MS_PER_TIC)));
 
-    action.reset(p);
+    action.add(p);
 
     for (auto &p : glyph_states) {
         p.flip = 0;
@@ -297,10 +299,10 @@ level_completed_animation::level_completed_animation(const gradient& g)
     : glyph_animation(get_font(font::title), GLYPH_ANIMATION_SPACING, L"成功",
                       .5 * window_width, .5 * window_height, g)
 {
-    auto *p = new parallel_action_group;
+    parallel_action_group p;
 
     for (size_t i = 0; i < glyph_states.size(); i++) {
-        p->add((new sequential_action_group)
+        p.add((new sequential_action_group)
                    ->add(new delay_action(i * 15 * MS_PER_TIC))
                    ->add((new parallel_action_group)
                              ->add(new property_change_action<out_bounce_tween<float>>(&glyph_states[i].z, -.7, 0,
@@ -311,11 +313,11 @@ level_completed_animation::level_completed_animation(const gradient& g)
 
     const int FADE_TICS = 10 * MS_PER_TIC;
 
-    p->add((new sequential_action_group)
+    p.add((new sequential_action_group)
                ->add(new delay_action(LEVEL_COMPLETED_TICS - FADE_TICS))
                ->add(new property_change_action<quadratic_tween<float>>(&alpha, 1, 0, FADE_TICS)));
 
-    action.reset(p);
+    action.add(p);
 
     for (auto &p : glyph_states) {
         p.flip = .5 * M_PI;
@@ -331,17 +333,22 @@ abunai_animation::abunai_animation()
 {
     const float w = abunai_bb_->get_width();
 
-    action.reset(
-        (new parallel_action_group)
-            ->add((new sequential_action_group)
-                      ->add(new delay_action(10 * MS_PER_TIC))
-                      ->add(new property_change_action<out_bounce_tween<float>>(&x, window_width, 40, 40 * MS_PER_TIC))
-                      ->add(new delay_action(45 * MS_PER_TIC))
-                      ->add(new property_change_action<in_back_tween<float>>(&x, 40, -w, 30 * MS_PER_TIC)))
-            ->add((new sequential_action_group)
-                      ->add(new property_change_action<quadratic_tween<float>>(&alpha, 0, .8, 50 * MS_PER_TIC))
-                      ->add(new delay_action(75 * MS_PER_TIC))
-                      ->add(new property_change_action<quadratic_tween<float>>(&alpha, .8, 0, 10 * MS_PER_TIC))));
+    parallel_action_group p;
+
+    // billboard
+    p.add((new sequential_action_group)
+               ->add(new delay_action(10 * MS_PER_TIC))
+               ->add(new property_change_action<out_bounce_tween<float>>(&x, window_width, 40, 40 * MS_PER_TIC))
+               ->add(new delay_action(45 * MS_PER_TIC))
+               ->add(new property_change_action<in_back_tween<float>>(&x, 40, -w, 30 * MS_PER_TIC)));
+
+    // overlay alpha
+    p.add((new sequential_action_group)
+               ->add(new property_change_action<quadratic_tween<float>>(&alpha, 0, .8, 50 * MS_PER_TIC))
+               ->add(new delay_action(75 * MS_PER_TIC))
+               ->add(new property_change_action<quadratic_tween<float>>(&alpha, .8, 0, 10 * MS_PER_TIC)));
+
+    action.add(p);
 }
 
 void abunai_animation::draw() const
@@ -372,28 +379,28 @@ game_over_animation::game_over_animation(const g2d::font *font, float spacing, c
     , overlay_alpha(0)
     , game_over_bb_(g2d::get_sprite("h-oh.png"))
 {
-    auto *p = new parallel_action_group;
+    parallel_action_group p;
 
     // overlay alpha
-    p->add(new property_change_action<quadratic_tween<float>>(&overlay_alpha, 0, .8, 50 * MS_PER_TIC));
+    p.add(new property_change_action<quadratic_tween<float>>(&overlay_alpha, 0, .8, 50 * MS_PER_TIC));
 
     // glyphs
     for (size_t i = 0; i < glyph_states.size(); i++) {
-        p->add((new sequential_action_group)
+        p.add((new sequential_action_group)
                    ->add(new delay_action((30 + i * 15) * MS_PER_TIC))
                    ->add(new property_change_action<out_bounce_tween<float>>(&glyph_states[i].flip, 0, .5 * M_PI,
                                                                              30 * MS_PER_TIC)));
     }
 
     // billboard
-    p->add((new sequential_action_group)
+    p.add((new sequential_action_group)
                ->add(new delay_action(10))
                ->add(new property_change_action<out_bounce_tween<float>>(&billboard_x, window_width, 40,
                                                                          40 * MS_PER_TIC)));
 
-    p->add(new delay_action(300 * MS_PER_TIC));
+    p.add(new delay_action(300 * MS_PER_TIC));
 
-    action.reset(p);
+    action.add(p);
 
     for (auto &p : glyph_states) {
         p.flip = 0;
@@ -428,7 +435,8 @@ void game_over_animation::draw() const
 }
 
 countdown_digit::countdown_digit(const g2d::glyph_info *gi, float x_center, float y_center)
-    : texture(gi->texture_)
+    : program(get_program(program::text))
+    , texture(gi->texture_)
     , x_center(x_center)
     , y_center(y_center)
     , z(-.7)
@@ -440,15 +448,19 @@ countdown_digit::countdown_digit(const g2d::glyph_info *gi, float x_center, floa
 
     texcoords = {gi->texuv[0], gi->texuv[1], gi->texuv[2], gi->texuv[3]};
 
-    action.reset((new parallel_action_group)
-                 ->add((new sequential_action_group)
-                           ->add(new property_change_action<out_bounce_tween<float>>(&z, -.7, -.1, 15 * MS_PER_TIC))
-                           ->add(new delay_action(10 * MS_PER_TIC))
-                           ->add(new property_change_action<quadratic_tween<float>>(&z, -.1, .3, 5 * MS_PER_TIC)))
-                 ->add((new sequential_action_group)
-                           ->add(new property_change_action<quadratic_tween<float>>(&alpha, 0, .6, 5 * MS_PER_TIC))
-                           ->add(new delay_action(20 * MS_PER_TIC))
-                           ->add(new property_change_action<quadratic_tween<float>>(&alpha, .6, 0, 5 * MS_PER_TIC))));
+    parallel_action_group p;
+
+    p.add((new sequential_action_group)
+               ->add(new property_change_action<out_bounce_tween<float>>(&z, -.7, -.1, 15 * MS_PER_TIC))
+               ->add(new delay_action(10 * MS_PER_TIC))
+               ->add(new property_change_action<quadratic_tween<float>>(&z, -.1, .3, 5 * MS_PER_TIC)));
+
+    p.add((new sequential_action_group)
+               ->add(new property_change_action<quadratic_tween<float>>(&alpha, 0, .6, 5 * MS_PER_TIC))
+               ->add(new delay_action(20 * MS_PER_TIC))
+               ->add(new property_change_action<quadratic_tween<float>>(&alpha, .6, 0, 5 * MS_PER_TIC)));
+
+    action.add(p);
 }
 
 void countdown_digit::draw() const
@@ -462,7 +474,7 @@ void countdown_digit::draw() const
     render::translate(x_center, y_center);
     render::scale(scale, scale);
 
-    render::draw_quad(texture, verts, texcoords, 120);
+    render::draw_quad(program, texture, verts, texcoords, 120);
 
     render::pop_matrix();
 }
@@ -505,7 +517,7 @@ private:
     void set_state(game_state next_state);
     void set_cur_game_animation(game_animation *p);
     void timer_update();
-    void reset_level();
+    void reset_level(bool fade_background);
     void bump_level();
     void finish_level();
     void set_state_game_over(bool time_up);
@@ -540,7 +552,7 @@ private:
 
     wchar_t next_falling_blocks_[3];
 
-    std::unique_ptr<theme_animation> theme_;
+    theme_animation *theme_ = nullptr;
     const color_scheme *colors_;
 };
 
@@ -593,11 +605,11 @@ void in_game_state_impl::set_cur_game_animation(game_animation *p)
     cur_game_animation_.reset(p);
 }
 
-void in_game_state_impl::reset_level()
+void in_game_state_impl::reset_level(bool fade_background)
 {
     int theme_index = cur_level % NUM_THEMES;
 
-    theme_ = make_theme(theme_index);
+    theme_ = get_theme(theme_index);
     colors_ = &cur_settings.color_schemes[theme_index];
 
     theme_->reset();
@@ -617,7 +629,10 @@ void in_game_state_impl::reset_level()
     world_.set_text_gradient(colors_->text_gradient);
 
     const auto& gradient = colors_->background_gradient;
-    background_initialize_gradient(gradient.from, gradient.to);
+    if (fade_background)
+        background_fade_gradient(gradient.from, gradient.to, BACKGROUND_FADE_TICS);
+    else
+        background_initialize_gradient(gradient.from, gradient.to);
 
     if (!practice_mode && cur_level > cur_options->max_unlocked_level)
         cur_options->max_unlocked_level = cur_level;
@@ -632,7 +647,7 @@ void in_game_state_impl::reset_level()
 void in_game_state_impl::bump_level()
 {
     ++cur_level;
-    reset_level();
+    reset_level(true);
 }
 
 void in_game_state_impl::finish_level()
@@ -686,6 +701,7 @@ void in_game_state_impl::update(uint32_t dt)
         touch_down_tics_ += dt;
 
     theme_->update(dt);
+    background_update(dt);
 
     score_display_.update(dt);
 
@@ -923,7 +939,7 @@ void in_game_state_impl::reset()
     score_display_.reset();
 
     world_.reset();
-    reset_level();
+    reset_level(false);
     world_.initialize_grid(2);
 
     enqueued_gesture_ = GESTURE_NONE;
@@ -54,6 +54,7 @@ public:
     void reset();
     void redraw() const;
     void update(uint32_t dt);
+    bool is_animating() const;
     void on_touch_down(float x, float y);
     void on_touch_up();
     void on_touch_move(float x, float y);
@@ -240,6 +241,12 @@ void in_game_menu_impl::update(uint32_t dt)
     }
 }
 
+bool in_game_menu_impl::is_animating() const
+{
+    // the game underneath is frozen, so once the menu settles nothing moves
+    return cur_state_ != STATE_ACTIVE || cur_menu_->is_animating();
+}
+
 void in_game_menu_impl::on_touch_down(float x, float y)
 {
     touch_is_down_ = true;
@@ -292,6 +299,11 @@ void in_game_menu_state::update(uint32_t dt)
     impl_->update(dt);
 }
 
+bool in_game_menu_state::is_animating() const
+{
+    return impl_->is_animating();
+}
+
 void in_game_menu_state::on_touch_down(float x, float y)
 {
     impl_->on_touch_down(x, y);
@@ -14,6 +14,7 @@ public:
     void reset();
     void redraw() const;
     void update(uint32_t dt);
+    bool is_animating() const;
     void on_touch_down(float x, float y);
     void on_touch_up();
     void on_touch_move(float x, float y);
@@ -3,12 +3,15 @@
 #include "guava2d/file.h"
 #include "guava2d/panic.h"
 
+#include "save_file.h"
 #include "utf8.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#include <unordered_map>
+
 #include <wchar.h>
 
 static const char *JUKUGO_FILE_PATH = "data/jukugo";
@@ -47,15 +50,46 @@ void jukugo_load_hits(const char *path)
     }
 }
 
-void jukugo_save_hits(const char *path)
+// hits are keyed by kanji, so changes to the jukugo file don't shuffle them
+
+std::string jukugo_serialize_hits()
 {
-    FILE *out;
+    save_data_writer writer;
 
-    if ((out = fopen(path, "w")) != nullptr) {
-        for (const auto& jukugo : jukugo_list) {
-            fwrite(&jukugo.hits, sizeof(jukugo.hits), 1, out);
-        }
+    for (const auto& jukugo : jukugo_list) {
+        if (!jukugo.hits)
+            continue;
+
+        unsigned char *kanji_utf8 = wchar_to_utf8(jukugo.kanji);
+        writer.put_string(reinterpret_cast<const char *>(kanji_utf8));
+        writer.put_u32(jukugo.hits);
+        delete[] kanji_utf8;
+    }
+
+    return std::move(writer.get_data());
+}
+
+void jukugo_deserialize_hits(const std::string &data)
+{
+    std::unordered_map<std::string, int> hits;
+
+    save_data_reader reader(data);
+
+    while (!reader.at_end()) {
+        std::string kanji;
+        uint32_t count;
+        if (!reader.get_string(kanji) || !reader.get_u32(count))
+            break;
+
+        hits[kanji] = count;
+    }
+
+    for (auto& jukugo : jukugo_list) {
+        unsigned char *kanji_utf8 = wchar_to_utf8(jukugo.kanji);
+
+        auto it = hits.find(reinterpret_cast<const char *>(kanji_utf8));
+        jukugo.hits = it != hits.end() ? it->second : 0;
 
-        fclose(out);
+        delete[] kanji_utf8;
     }
 }
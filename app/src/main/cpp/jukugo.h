@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 struct jukugo
@@ -15,6 +16,9 @@ extern std::vector<jukugo> jukugo_list;
 
 void jukugo_initialize();
 
+// hits file written by older versions
 void jukugo_load_hits(const char *path);
 
-void jukugo_save_hits(const char *path);
+// contents of the hits section of the save file
+std::string jukugo_serialize_hits();
+void jukugo_deserialize_hits(const std::string &data);
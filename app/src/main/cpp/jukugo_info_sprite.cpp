@@ -1,5 +1,8 @@
 #include "jukugo_info_sprite.h"
 
+#include <algorithm>
+#include <cassert>
+
 #include "common.h"
 #include "settings.h"
 #include "jukugo.h"
@@ -16,18 +19,14 @@ jukugo_info_sprite::jukugo_info_sprite(const jukugo *jukugo_info, float x, float
     , gradient_{g}
     , program_{get_program(program::text_outline)}
 {
-    action_.reset(
-        (new parallel_action_group)
-            ->add((new sequential_action_group)
-                      ->add(new property_change_action<out_bounce_tween<float>>(&flip_, 0, .5 * M_PI, 30 * MS_PER_TIC))
-                      ->add(new delay_action(30 * MS_PER_TIC)))
-            ->add((new sequential_action_group)
-                      ->add(new delay_action(60 * MS_PER_TIC))
-                      ->add(new property_change_action<in_back_tween<float>>(&z_, 0, 1, 20 * MS_PER_TIC)))
-            ->add((new sequential_action_group)
-                      ->add(new property_change_action<linear_tween<float>>(&alpha_, 0, 1., 10 * MS_PER_TIC))
-                      ->add(new delay_action(60 * MS_PER_TIC))
-                      ->add(new property_change_action<linear_tween<float>>(&alpha_, 1., 0, 10 * MS_PER_TIC))));
+    // one of these is spawned per match, so write the tracks directly rather than building an action tree
+    constexpr int FLIP_TICS = 30 * MS_PER_TIC;
+    constexpr int FADE_TICS = 10 * MS_PER_TIC;
+
+    action_.add(0, FLIP_TICS, tween_kind::out_bounce, &flip_, 0, .5 * M_PI);
+    action_.add(60 * MS_PER_TIC, 20 * MS_PER_TIC, tween_kind::in_back, &z_, 0, 1);
+    action_.add(0, FADE_TICS, tween_kind::linear, &alpha_, 0, 1);
+    action_.add(70 * MS_PER_TIC, FADE_TICS, tween_kind::linear, &alpha_, 1, 0);
 
     pos_kanji_ = {-.5f * get_font(font::large)->get_string_width(jukugo_info->kanji), -20.f};
     pos_furigana_ = {-.5f * get_font(font::small)->get_string_width(jukugo_info->reading), 64.f};
@@ -39,18 +38,34 @@ jukugo_info_sprite::jukugo_info_sprite(const jukugo *jukugo_info, float x, float
 
     line_splitter ls(eigo_font, jukugo_info->eigo);
 
-    std::wstring line;
-    while (line = ls.next_line(MAX_LINE_WIDTH), !line.empty()) {
-        const float x = -.5 * eigo_font->get_string_width(line.c_str());
-        eigo_lines_.emplace_back(g2d::vec2(x, y_eigo), std::move(line));
+    int text_length = 0;
+
+    const wchar_t *line;
+    size_t line_length;
+    while ((line = ls.next_line(MAX_LINE_WIDTH, line_length)) != nullptr && line_length > 0) {
+        const int length = static_cast<int>(line_length);
+
+        // the jukugo list's meanings are all well within these
+        assert(num_eigo_lines_ < MAX_EIGO_LINES && text_length + length < MAX_EIGO_LENGTH);
+        if (num_eigo_lines_ == MAX_EIGO_LINES || text_length + length >= MAX_EIGO_LENGTH)
+            break;
+
+        wchar_t *text = &eigo_text_[text_length];
+        std::copy(line, line + length, text);
+        text[length] = L'\0';
+
+        const float x = -.5 * eigo_font->get_string_width(text, length);
+        eigo_lines_[num_eigo_lines_++] = {g2d::vec2(x, y_eigo), text_length};
+
+        text_length += length + 1;
         y_eigo -= 44;
     }
 }
 
 bool jukugo_info_sprite::update(uint32_t dt)
 {
-    action_->step(dt);
-    return !action_->done();
+    action_.step(dt);
+    return !action_.done();
 }
 
 void jukugo_info_sprite::draw() const
@@ -82,8 +97,10 @@ void jukugo_info_sprite::draw() const
 
     const auto *eigo_font = get_font(font::tiny);
 
-    for (const auto &p : eigo_lines_)
-        render::draw_text(eigo_font, p.first, 50, bottom_color_outline, bottom_color_text, p.second.c_str());
+    for (int i = 0; i < num_eigo_lines_; i++) {
+        const auto &l = eigo_lines_[i];
+        render::draw_text(eigo_font, l.pos, 50, bottom_color_outline, bottom_color_text, &eigo_text_[l.offset]);
+    }
 
     render::pop_matrix();
 }
@@ -4,9 +4,7 @@
 #include "world.h"
 #include "settings.h"
 
-#include <memory>
-#include <string>
-#include <vector>
+#include <array>
 
 struct jukugo;
 struct gradient;
@@ -16,7 +14,7 @@ class font;
 class program;
 };
 
-class jukugo_info_sprite : public sprite
+class jukugo_info_sprite final : public sprite
 {
 public:
     jukugo_info_sprite(const jukugo *jukugo_info, float x, float y, const gradient& g);
@@ -32,13 +30,27 @@ private:
     float flip_ = 0;
     float alpha_ = 0;
     float z_ = 0;
-    std::unique_ptr<abstract_action> action_;
+    fixed_timeline<4> action_;
 
     gradient gradient_;
 
     g2d::vec2 pos_kanji_;
     g2d::vec2 pos_furigana_;
-    std::vector<std::pair<g2d::vec2, std::wstring>> eigo_lines_;
+
+    // the jukugo's meaning split into lines, each null-terminated in
+    // eigo_text_, so that spawning one of these doesn't allocate
+    static constexpr int MAX_EIGO_LINES = 8;
+    static constexpr int MAX_EIGO_LENGTH = 160;
+
+    struct eigo_line
+    {
+        g2d::vec2 pos;
+        int offset; // in eigo_text_
+    };
+
+    std::array<eigo_line, MAX_EIGO_LINES> eigo_lines_;
+    int num_eigo_lines_ = 0;
+    std::array<wchar_t, MAX_EIGO_LENGTH> eigo_text_;
 
     const g2d::program *program_;
 };
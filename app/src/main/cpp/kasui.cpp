@@ -1,8 +1,13 @@
+#include <array>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <list>
+#include <memory>
+#include <vector>
 
 #include <stdint.h>
 #include <stdlib.h>
@@ -13,6 +18,8 @@
 #include <time.h>
 #endif
 
+#include "guava2d/g2dgl.h"
+#include "guava2d/gl_state.h"
 #include "guava2d/texture_manager.h"
 #include "guava2d/panic.h"
 
@@ -22,6 +29,7 @@
 #include "background.h"
 #include "common.h"
 #include "credits.h"
+#include "fonts.h"
 #include "hiscore_input.h"
 #include "hiscore_list.h"
 #include "http_request.h"
@@ -30,14 +38,20 @@
 #include "jukugo.h"
 #include "kanji_info.h"
 #include "kasui.h"
+#include "log.h"
 #include "main_menu.h"
 #include "menu.h"
 #include "options.h"
+#include "reactor.h"
+#include "resolver.h"
+#include "save_file.h"
+#include "save_queue.h"
 #include "settings.h"
 #include "sprite_manager.h"
 #include "stats_page.h"
 #include "theme.h"
 #include "tutorial.h"
+#include "worker_thread.h"
 #include "world.h"
 
 float window_width, window_height;
@@ -45,6 +59,8 @@ int viewport_width, viewport_height;
 
 options *cur_options;
 
+static save_file cur_save_file;
+
 #if 0
 leaderboard *cur_leaderboard;
 #endif
@@ -67,6 +83,13 @@ public:
 
     void redraw();
 
+    bool needs_redraw();
+    void idle(int timeout);
+
+    void set_pipelined(bool pipelined);
+    float get_frame_latency() const { return frame_latency_; }
+    float get_record_time() const { return record_time_; }
+
     void on_pause();
     void on_resume();
 
@@ -79,12 +102,62 @@ public:
 
     void add_http_request(http_request *req);
 
+    void request_quit() { quit_requested_ = true; }
+
+    reactor &get_reactor() { return reactor_; }
+    resolver &get_resolver() { return resolver_; }
+    save_queue &get_save_queue() { return save_queue_; }
+
 private:
+    using clock = std::chrono::steady_clock;
+
+    struct frame
+    {
+        render::command_list commands;
+        unsigned changes; // changes_ when it was recorded
+        bool animating; // the state was animating when it was recorded
+        clock::time_point started;
+        float record_time; // ms spent in the state's redraw()
+    };
+
     void initialize(int width, int height);
     void poll_http_requests();
 
+    void step(frame &f);
+    void submit(const frame &f);
+    void sync();
+    void quit();
+
     uint32_t prev_update_;
     bool initialized_;
+
+    // set by quit(), which may be called from update() on the worker; acted
+    // upon here once it's done
+    bool quit_requested_;
+
+    // bumped by anything that may show up on screen, like input
+    unsigned changes_;
+    unsigned shown_changes_;
+
+    // when pipelined, frame N+1 is simulated and recorded on the worker while
+    // frame N is submitted to GL here
+    bool pipelined_;
+    std::array<frame, 2> frames_;
+    int back_; // recorded (or being recorded) but not submitted yet
+    bool back_valid_;
+    std::unique_ptr<worker_thread> worker_;
+
+    // what the last recorded frame showed, for damage relative to it
+    const state *recorded_state_;
+    unsigned recorded_changes_;
+    std::vector<render::box> damage_;
+
+    float frame_latency_; // ms from the start of a frame's simulation to the end of its submission
+    float record_time_; // record_time of the last submitted frame
+
+    reactor reactor_;
+    resolver resolver_;
+    save_queue save_queue_;
     std::list<http_request *> http_requests_;
 };
 
@@ -217,14 +290,24 @@ void start_credits()
     push_state(get_credits_state());
 }
 
-void quit()
+static void save_state(save_queue &queue)
 {
-    cur_options->save(options_file_path);
+    bool changed = false;
+
+    changed |= cur_save_file.set_section(save_section::OPTIONS, cur_options->serialize(save_section::OPTIONS));
+    changed |= cur_save_file.set_section(save_section::PROGRESS, cur_options->serialize(save_section::PROGRESS));
+    changed |= cur_save_file.set_section(save_section::JUKUGO_HITS, jukugo_serialize_hits());
 #if 0
 	cur_leaderboard->save(leaderboard_file_path);
 #endif
-    jukugo_save_hits(jukugo_hits_file_path);
-    exit(0);
+
+    if (changed)
+        queue.save(save_file_path, cur_save_file.serialize());
+}
+
+void quit()
+{
+    kasui::get_instance().request_quit();
 }
 
 static void preload_resources()
@@ -233,7 +316,8 @@ static void preload_resources()
 
     static const char *textures[] = {
         "images/blocks.png", "images/clouds.png", "images/flare.png", "images/glow.png", "images/haru-bg.png",
-        "images/petal.png",  "images/star.png",   "images/arrow.png", nullptr,
+        "images/petal.png",  "images/star.png",   "images/arrow.png", "images/w-button-border.png",
+        "images/b-button-border.png", "images/keyboard.png", nullptr,
     };
 
     for (const char **p = textures; *p; p++)
@@ -243,6 +327,10 @@ static void preload_resources()
 
     g2d::load_sprite_sheet("sprites/sprites");
 
+    // fonts, uploaded to the atlas on first use
+
+    get_font(font::micro);
+
     // programs
 
     initialize_programs();
@@ -261,8 +349,27 @@ static uint32_t get_cur_tics()
 
 static void initialize_options()
 {
-    if (!(cur_options = options::load(options_file_path)))
+    // The sections are restored independently: one may be missing or have
+    // failed its CRC while the other is intact.
+
+    if (const auto *section = cur_save_file.get_section(save_section::OPTIONS)) {
+        cur_options = new options;
+        cur_options->deserialize(*section);
+    } else if (!(cur_options = options::load(options_file_path))) {
+        // not saved since the save file was introduced, or lost
         cur_options = new options;
+    }
+
+    if (const auto *progress = cur_save_file.get_section(save_section::PROGRESS))
+        cur_options->deserialize(*progress);
+}
+
+static void initialize_jukugo_hits()
+{
+    if (const auto *section = cur_save_file.get_section(save_section::JUKUGO_HITS))
+        jukugo_deserialize_hits(*section);
+    else
+        jukugo_load_hits(jukugo_hits_file_path);
 }
 
 #if 0
@@ -280,6 +387,17 @@ initialize_leaderboard()
 
 kasui_impl::kasui_impl()
     : initialized_(false)
+    , quit_requested_(false)
+    , changes_(1)
+    , shown_changes_(0)
+    , pipelined_(false)
+    , back_(0)
+    , back_valid_(false)
+    , recorded_state_(nullptr)
+    , recorded_changes_(0)
+    , frame_latency_(0)
+    , record_time_(0)
+    , resolver_(reactor_)
 {
 }
 
@@ -287,38 +405,75 @@ kasui_impl::~kasui_impl()
 {
 }
 
+void kasui_impl::sync()
+{
+    if (worker_)
+        worker_->wait();
+}
+
+void kasui_impl::quit()
+{
+    sync();
+
+    save_state(save_queue_);
+    save_queue_.flush();
+    exit(0);
+}
+
+void kasui_impl::set_pipelined(bool pipelined)
+{
+    sync();
+
+    if (pipelined && !worker_)
+        worker_.reset(new worker_thread);
+
+    pipelined_ = pipelined;
+    back_valid_ = false;
+    render::invalidate_offscreen_layers();
+}
+
 void kasui_impl::on_pause()
 {
-    cur_options->save(options_file_path);
-#if 0
-	cur_leaderboard->save(leaderboard_file_path);
-#endif
-    jukugo_save_hits(jukugo_hits_file_path);
+    sync();
+
+    // the writes happen on the save queue's thread
+    save_state(save_queue_);
 }
 
 void kasui_impl::on_resume()
 {
+    sync();
+    ++changes_;
 }
 
 void kasui_impl::resize(int width, int height)
 {
+    sync();
+
+    // fresh context, or one we don't know anything about anymore
+    g2d::gl_state::invalidate();
+
     if (!initialized_) {
         initialize(width, height);
     } else {
         // resuming after pause
 
         g2d::reload_all_textures();
+        render::reload_offscreen_layers();
 #ifdef FIX_ME
         reload_all_programs();
 #endif
     }
 
-    glViewport(0, 0, viewport_width, viewport_height);
+    g2d::gl_state::set_viewport(0, 0, viewport_width, viewport_height);
 
     glDisable(GL_CULL_FACE);
     glDisable(GL_DEPTH_TEST);
 
     prev_update_ = 0;
+    back_valid_ = false;
+    render::invalidate_offscreen_layers();
+    ++changes_;
 }
 
 void kasui_impl::initialize(int width, int height)
@@ -338,26 +493,30 @@ void kasui_impl::initialize(int width, int height)
     // initialize game
 
     load_settings();
+    cur_save_file.load(save_file_path);
     initialize_options();
 #if 0
 	initialize_leaderboard();
 #endif
 
     jukugo_initialize();
-    jukugo_load_hits(jukugo_hits_file_path);
+    initialize_jukugo_hits();
     kanji_info_initialize();
 
     world_init();
 
     background_initialize();
+    initialize_themes();
 
-    // states
+    // states, constructed here since they create GL objects and would
+    // otherwise be first used from update(), which may run on the worker
 
     get_main_menu_state();
     get_in_game_state();
     get_in_game_menu_state();
     get_stats_page_state();
     get_hiscore_list_state();
+    get_hiscore_input_state();
     get_credits_state();
     get_tutorial_state();
 
@@ -382,6 +541,45 @@ void kasui_impl::initialize(int width, int height)
 void kasui_impl::redraw()
 {
 #ifndef DUMP_FRAMES
+    if (!pipelined_) {
+        step(frames_[0]);
+        if (quit_requested_)
+            quit();
+        submit(frames_[0]);
+        return;
+    }
+
+    sync();
+
+    if (quit_requested_)
+        quit();
+
+    if (!back_valid_) {
+        step(frames_[back_]);
+        if (quit_requested_)
+            quit();
+    }
+
+    const auto &cur = frames_[back_];
+
+    back_ ^= 1;
+    auto &next = frames_[back_];
+    worker_->start([this, &next] { step(next); });
+    back_valid_ = true;
+
+    submit(cur);
+#else
+    update();
+    redraw(0);
+#endif
+}
+
+void kasui_impl::step(frame &f)
+{
+    f.started = clock::now();
+    f.changes = changes_;
+    f.animating = get_cur_state()->is_animating();
+
     const uint32_t now = get_cur_tics();
 
     uint32_t dt;
@@ -400,22 +598,91 @@ void kasui_impl::redraw()
 
     get_cur_state()->update(dt);
 
+    // responses are handled in here, and may change anything on screen
+    const bool had_http_requests = !http_requests_.empty();
     poll_http_requests();
 
+    render::begin_frame(f.commands);
     render::begin_batch();
     render::set_viewport(0, window_width, 0, window_height);
 
+    // Input, or a state pushed or popped by it or by the update, can change
+    // anything; otherwise it's up to the state to tell what did. Asked every
+    // frame regardless, since it keeps track of what it last drew.
+    auto *cur_state = get_cur_state();
+
+    damage_.clear();
+    const bool has_damage = cur_state->get_damage(damage_);
+
+    if (has_damage && cur_state == recorded_state_ && f.changes == recorded_changes_ && !had_http_requests)
+        render::set_damage(damage_);
+
+    recorded_state_ = cur_state;
+    recorded_changes_ = f.changes;
+
+    const auto record_start = clock::now();
     get_cur_state()->redraw();
+    f.record_time = std::chrono::duration<float, std::milli>(clock::now() - record_start).count();
 
     render::end_batch();
+    render::end_frame();
 
     prev_update_ = now;
+}
+
+void kasui_impl::submit(const frame &f)
+{
+    render::submit(f.commands);
+
+    shown_changes_ = f.changes;
+    frame_latency_ = std::chrono::duration<float, std::milli>(clock::now() - f.started).count();
+    record_time_ = f.record_time;
+
+#ifdef LOG_GL_CALLS
+    static int frames;
+    if (++frames == 300) {
+        const auto& state_calls = g2d::gl_state::get_counters();
+        log_debug("%u GL calls per frame, state changes: %u issued, %u elided", g2d::gl_call_count / frames,
+                  state_calls.issued / frames, state_calls.elided / frames);
+        g2d::gl_call_count = 0;
+        g2d::gl_state::reset_counters();
+        frames = 0;
+    }
+#endif
+}
+
+bool kasui_impl::needs_redraw()
+{
+#ifndef DUMP_FRAMES
+    sync();
+
+    if (quit_requested_)
+        return true; // redraw() quits
+
+    if (pipelined_ && back_valid_) {
+        // recorded but not shown yet
+        const auto &back = frames_[back_];
+        if (back.animating || back.changes != shown_changes_)
+            return true;
+    }
+
+    // in-flight requests may change what the current state shows when they complete
+    return changes_ != shown_changes_ || !http_requests_.empty() || get_cur_state()->is_animating();
 #else
-    update();
-    redraw(0);
+    return true;
 #endif
 }
 
+void kasui_impl::idle(int timeout)
+{
+    sync();
+
+    // wait for network events instead of spinning; nothing animates, so the
+    // time spent here doesn't need to be fed to update()
+    reactor_.poll(timeout);
+    prev_update_ = 0;
+}
+
 void kasui_impl::add_http_request(http_request *req)
 {
     http_requests_.push_back(req);
@@ -423,12 +690,14 @@ void kasui_impl::add_http_request(http_request *req)
 
 void kasui_impl::poll_http_requests()
 {
+    reactor_.poll(0);
+
     auto it = http_requests_.begin();
 
     while (it != http_requests_.end()) {
         auto *p = *it;
 
-        if (!p->poll()) {
+        if (p->done()) {
             delete p;
             it = http_requests_.erase(it);
         } else {
@@ -439,6 +708,9 @@ void kasui_impl::poll_http_requests()
 
 void kasui_impl::on_touch_down(int x, int y)
 {
+    sync();
+    ++changes_;
+
     float sx = x * window_width / viewport_width;
     float sy = (viewport_height - 1 - y) * window_height / viewport_height;
 
@@ -447,11 +719,16 @@ void kasui_impl::on_touch_down(int x, int y)
 
 void kasui_impl::on_touch_up()
 {
+    sync();
+    ++changes_;
     get_cur_state()->on_touch_up();
 }
 
 void kasui_impl::on_touch_move(int x, int y)
 {
+    sync();
+    ++changes_;
+
     float sx = x * window_width / viewport_width;
     float sy = (viewport_height - 1 - y) * window_height / viewport_height;
 
@@ -460,11 +737,15 @@ void kasui_impl::on_touch_move(int x, int y)
 
 void kasui_impl::on_back_key_pressed()
 {
+    sync();
+    ++changes_;
     get_cur_state()->on_back_key();
 }
 
 void kasui_impl::on_menu_key_pressed()
 {
+    sync();
+    ++changes_;
     get_cur_state()->on_menu_key();
 }
 
@@ -488,6 +769,31 @@ void kasui::redraw()
     impl_->redraw();
 }
 
+bool kasui::needs_redraw()
+{
+    return impl_->needs_redraw();
+}
+
+void kasui::set_pipelined(bool pipelined)
+{
+    impl_->set_pipelined(pipelined);
+}
+
+float kasui::get_frame_latency() const
+{
+    return impl_->get_frame_latency();
+}
+
+float kasui::get_record_time() const
+{
+    return impl_->get_record_time();
+}
+
+void kasui::idle(int timeout)
+{
+    impl_->idle(timeout);
+}
+
 void kasui::on_pause()
 {
     impl_->on_pause();
@@ -528,6 +834,26 @@ void kasui::add_http_request(http_request *req)
     impl_->add_http_request(req);
 }
 
+void kasui::request_quit()
+{
+    impl_->request_quit();
+}
+
+reactor &kasui::get_reactor()
+{
+    return impl_->get_reactor();
+}
+
+resolver &kasui::get_resolver()
+{
+    return impl_->get_resolver();
+}
+
+save_queue &kasui::get_save_queue()
+{
+    return impl_->get_save_queue();
+}
+
 kasui &kasui::get_instance()
 {
     static kasui the_instance;
@@ -2,6 +2,9 @@
 
 class kasui_impl;
 class http_request;
+class reactor;
+class resolver;
+class save_queue;
 
 class kasui
 {
@@ -12,6 +15,27 @@ public:
 
     void redraw();
 
+    // false while the current state is at rest and no input or network
+    // activity happened since the last redraw(), so the frame can be skipped
+    bool needs_redraw();
+
+    // call instead of redraw() when a frame is skipped; waits for at most
+    // timeout ms for network events and dispatches them
+    void idle(int timeout);
+
+    // simulate and record the next frame on a worker thread while the
+    // current one is submitted to GL; adds a frame of latency but overlaps
+    // the two halves of the work
+    void set_pipelined(bool pipelined);
+
+    // ms from the start of the last submitted frame's simulation to the end
+    // of its submission
+    float get_frame_latency() const;
+
+    // ms the last submitted frame spent in the current state's redraw(),
+    // recording its draw calls
+    float get_record_time() const;
+
     void on_pause();
     void on_resume();
 
@@ -24,6 +48,14 @@ public:
 
     void add_http_request(http_request *req);
 
+    // saves and exits in the next redraw(), on the calling thread, once
+    // the worker is done with the frame; safe to call from update()
+    void request_quit();
+
+    reactor &get_reactor();
+    resolver &get_resolver();
+    save_queue &get_save_queue();
+
 private:
     kasui();
     ~kasui();
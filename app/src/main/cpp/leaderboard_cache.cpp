@@ -0,0 +1,144 @@
+#include "leaderboard_cache.h"
+
+#include "log.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[4] = {'K', 'L', 'C', '\0'};
+
+enum
+{
+    FORMAT_VERSION = 1,
+};
+
+} // namespace
+
+leaderboard_cache_reader::leaderboard_cache_reader()
+    : data_(nullptr)
+    , size_(0)
+    , header_(nullptr)
+    , records_(nullptr)
+    , names_(nullptr)
+{
+}
+
+leaderboard_cache_reader::~leaderboard_cache_reader()
+{
+    close();
+}
+
+leaderboard_cache_reader::status leaderboard_cache_reader::open(const std::string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return status::NOT_A_CACHE;
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || static_cast<size_t>(sb.st_size) < sizeof(MAGIC)) {
+        ::close(fd);
+        return status::NOT_A_CACHE;
+    }
+
+    void *data = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        log_err("mmap %s: %s", path.c_str(), strerror(errno));
+        return status::NOT_A_CACHE;
+    }
+
+    data_ = data;
+    size_ = sb.st_size;
+
+    if (memcmp(data_, MAGIC, sizeof(MAGIC)) != 0) {
+        close();
+        return status::NOT_A_CACHE;
+    }
+
+    header_ = static_cast<const leaderboard_cache_header *>(data_);
+
+    if (size_ < sizeof(leaderboard_cache_header) || header_->format_version != FORMAT_VERSION) {
+        log_err("%s: bad leaderboard cache header", path.c_str());
+        close();
+        return status::CORRUPT;
+    }
+
+    const size_t records_size = static_cast<size_t>(header_->num_entries) * sizeof(leaderboard_cache_record);
+    const size_t names_size = static_cast<size_t>(header_->names_size) * sizeof(uint32_t);
+
+    if (size_ != sizeof(leaderboard_cache_header) + records_size + names_size) {
+        log_err("%s: bad leaderboard cache size", path.c_str());
+        close();
+        return status::CORRUPT;
+    }
+
+    records_ = reinterpret_cast<const leaderboard_cache_record *>(header_ + 1);
+    names_ = reinterpret_cast<const uint32_t *>(records_ + header_->num_entries);
+
+    for (size_t i = 0; i < header_->num_entries; i++) {
+        const auto &record = records_[i];
+        if (record.name_offset > header_->names_size || record.name_length > header_->names_size - record.name_offset) {
+            log_err("%s: bad leaderboard cache record", path.c_str());
+            close();
+            return status::CORRUPT;
+        }
+    }
+
+    return status::OK;
+}
+
+void leaderboard_cache_reader::close()
+{
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    header_ = nullptr;
+    records_ = nullptr;
+    names_ = nullptr;
+}
+
+std::wstring leaderboard_cache_reader::get_name(const leaderboard_cache_record &record) const
+{
+    const uint32_t *name = names_ + record.name_offset;
+    return std::wstring(name, name + record.name_length);
+}
+
+void leaderboard_cache_writer::add_entry(int rank, int score, const std::wstring &name)
+{
+    records_.push_back({rank, score, static_cast<uint32_t>(names_.size()), static_cast<uint32_t>(name.size())});
+    names_.insert(names_.end(), name.begin(), name.end());
+}
+
+std::string leaderboard_cache_writer::serialize(uint32_t list_version, time_t fetch_time) const
+{
+    leaderboard_cache_header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format_version = FORMAT_VERSION;
+    header.list_version = list_version;
+    header.num_entries = records_.size();
+    header.fetch_time = fetch_time;
+    header.names_size = names_.size();
+    header.reserved = 0;
+
+    std::string data;
+    data.reserve(sizeof(header) + records_.size() * sizeof(leaderboard_cache_record) + names_.size() * sizeof(uint32_t));
+
+    data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char *>(records_.data()), records_.size() * sizeof(leaderboard_cache_record));
+    data.append(reinterpret_cast<const char *>(names_.data()), names_.size() * sizeof(uint32_t));
+
+    return data;
+}
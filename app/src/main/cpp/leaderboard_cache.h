@@ -0,0 +1,87 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// On-disk leaderboard cache. The file is a header, a table of fixed-size
+// records and a pool of UTF-32 names, all in native byte order, so it can be
+// mapped and read without parsing (the leaderboard still copies each entry
+// out of it, into an item with its own text layouts):
+//
+//   leaderboard_cache_header
+//   num_entries x leaderboard_cache_record
+//   names_size x uint32_t
+//
+// It's written with write_file_atomically, so a crash never leaves a
+// truncated cache behind.
+
+struct leaderboard_cache_header
+{
+    char magic[4]; // "KLC\0"
+    uint32_t format_version;
+    uint32_t list_version; // as sent by the server, 0 if unknown
+    uint32_t num_entries;
+    int64_t fetch_time; // when the list was last known to be current
+    uint32_t names_size;
+    uint32_t reserved;
+};
+
+struct leaderboard_cache_record
+{
+    int32_t rank;
+    int32_t score;
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+class leaderboard_cache_reader : private noncopyable
+{
+public:
+    leaderboard_cache_reader();
+    ~leaderboard_cache_reader();
+
+    enum class status
+    {
+        OK,
+        NOT_A_CACHE, // missing, or doesn't start with the magic
+        CORRUPT, // starts with the magic, but is truncated or inconsistent
+    };
+
+    // maps the file and checks it
+    status open(const std::string &path);
+    void close();
+
+    uint32_t get_list_version() const { return header_->list_version; }
+    time_t get_fetch_time() const { return header_->fetch_time; }
+
+    size_t size() const { return header_->num_entries; }
+    const leaderboard_cache_record &operator[](size_t index) const { return records_[index]; }
+
+    std::wstring get_name(const leaderboard_cache_record &record) const;
+
+private:
+    void *data_;
+    size_t size_;
+
+    const leaderboard_cache_header *header_;
+    const leaderboard_cache_record *records_;
+    const uint32_t *names_;
+};
+
+class leaderboard_cache_writer
+{
+public:
+    void add_entry(int rank, int score, const std::wstring &name);
+
+    // contents of the cache file
+    std::string serialize(uint32_t list_version, time_t fetch_time) const;
+
+private:
+    std::vector<leaderboard_cache_record> records_;
+    std::vector<uint32_t> names_;
+};
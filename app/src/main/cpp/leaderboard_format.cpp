@@ -0,0 +1,276 @@
+#include "leaderboard_format.h"
+
+#include <limits>
+
+namespace {
+
+const char MAGIC[] = "KLB";
+const size_t MAGIC_LENGTH = 3;
+
+const size_t MAX_NAME_LENGTH = 255;
+const int MAX_ENTRIES = 1000;
+
+// scores are ints everywhere else, so anything past this is garbage
+const int MAX_SCORE = std::numeric_limits<int>::max();
+
+// every binary field is a uint32: at most 5 bytes, the last one carrying
+// only the top 4 bits
+const int MAX_VARINT_SHIFT = 28;
+const uint8_t LAST_VARINT_BYTE_MASK = 0x0f;
+
+void put_varint(std::string &out, uint32_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+} // namespace
+
+leaderboard_parser::leaderboard_parser(const entry_callback &on_entry)
+    : on_entry_(on_entry)
+{
+    reset();
+}
+
+void leaderboard_parser::reset()
+{
+    format_ = format::UNKNOWN;
+    field_ = field::MAGIC;
+    text_state_ = 0;
+    varint_ = 0;
+    varint_shift_ = 0;
+    name_length_ = 0;
+    entries_left_ = 0;
+    list_version_ = base_version_ = 0;
+    total_entries_ = 0;
+    entry_ = leaderboard_entry{0, 0, {}, 0};
+    bytes_parsed_ = 0;
+    failed_ = false;
+}
+
+bool leaderboard_parser::feed(const char *data, size_t size)
+{
+    if (failed_)
+        return false;
+
+    if (size == 0)
+        return true;
+
+    if (format_ == format::UNKNOWN) {
+        format_ = data[0] == MAGIC[0] ? format::BINARY : format::TEXT;
+        entry_.rank = 1;
+    }
+
+    bytes_parsed_ += size;
+
+    if (format_ == format::TEXT) {
+        for (const char *p = data; p != data + size; p++) {
+            if (!feed_text(*p)) {
+                failed_ = true;
+                return false;
+            }
+        }
+    } else {
+        for (const char *p = data; p != data + size; p++) {
+            if (!feed_binary(*p)) {
+                failed_ = true;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool leaderboard_parser::finish()
+{
+    if (failed_)
+        return false;
+
+    switch (format_) {
+        case format::UNKNOWN:
+            // empty leaderboard
+            return true;
+
+        case format::TEXT:
+            total_entries_ = entry_.rank - 1;
+            return text_state_ == 0 && entry_.score == 0;
+
+        case format::BINARY:
+        default:
+            return field_ == field::END;
+    }
+}
+
+bool leaderboard_parser::feed_text(char ch)
+{
+    switch (text_state_) {
+        case 0:
+            if (ch == ':') {
+                text_state_ = 1;
+            } else if (ch >= '0' && ch <= '9') {
+                if (entry_.score > (MAX_SCORE - (ch - '0')) / 10)
+                    return false;
+                entry_.score = entry_.score * 10 + ch - '0';
+            }
+            break;
+
+        case 1:
+            if (ch == ':') {
+                text_state_ = 2;
+            } else {
+                entry_.name.push_back(ch);
+            }
+            break;
+
+        case 2:
+            if (ch == '\n') {
+                on_entry_(entry_);
+
+                ++entry_.rank;
+                entry_.score = 0;
+                entry_.name.clear();
+                entry_.flags = 0;
+
+                text_state_ = 0;
+            } else if (ch == '1') {
+                entry_.flags |= LEADERBOARD_HIGHLIGHT_FLAG;
+            }
+            break;
+    }
+
+    return true;
+}
+
+bool leaderboard_parser::feed_binary(uint8_t ch)
+{
+    switch (field_) {
+        case field::MAGIC:
+            if (ch != static_cast<uint8_t>(MAGIC[name_length_]))
+                return false;
+            if (++name_length_ == MAGIC_LENGTH) {
+                name_length_ = 0;
+                field_ = field::FORMAT_VERSION;
+            }
+            return true;
+
+        case field::NAME:
+            entry_.name.push_back(ch);
+            if (entry_.name.size() == name_length_)
+                field_ = field::FLAGS;
+            return true;
+
+        case field::END:
+            // trailing garbage
+            return false;
+
+        default:
+            // a fifth byte may neither continue nor set bits past 32
+            if (varint_shift_ == MAX_VARINT_SHIFT && (ch & ~LAST_VARINT_BYTE_MASK))
+                return false;
+
+            varint_ |= static_cast<uint32_t>(ch & 0x7f) << varint_shift_;
+
+            if (ch & 0x80) {
+                varint_shift_ += 7;
+                return true;
+            }
+
+            {
+                const uint32_t value = varint_;
+                varint_ = 0;
+                varint_shift_ = 0;
+                return on_varint(value);
+            }
+    }
+}
+
+bool leaderboard_parser::on_varint(uint32_t value)
+{
+    switch (field_) {
+        case field::FORMAT_VERSION:
+            if (value != LEADERBOARD_FORMAT_VERSION)
+                return false;
+            field_ = field::LIST_VERSION;
+            break;
+
+        case field::LIST_VERSION:
+            list_version_ = value;
+            field_ = field::BASE_VERSION;
+            break;
+
+        case field::BASE_VERSION:
+            base_version_ = value;
+            field_ = field::TOTAL_ENTRIES;
+            break;
+
+        case field::TOTAL_ENTRIES:
+            if (value > MAX_ENTRIES)
+                return false;
+            total_entries_ = value;
+            field_ = field::NUM_ENTRIES;
+            break;
+
+        case field::NUM_ENTRIES:
+            if (value > static_cast<uint32_t>(total_entries_))
+                return false;
+            entries_left_ = value;
+            field_ = entries_left_ ? field::RANK : field::END;
+            break;
+
+        case field::RANK:
+            if (value < 1 || value > static_cast<uint32_t>(total_entries_))
+                return false;
+            entry_.rank = value;
+            field_ = field::SCORE;
+            break;
+
+        case field::SCORE:
+            if (value > static_cast<uint32_t>(MAX_SCORE))
+                return false;
+            entry_.score = static_cast<int>(value);
+            field_ = field::NAME_LENGTH;
+            break;
+
+        case field::NAME_LENGTH:
+            if (value > MAX_NAME_LENGTH)
+                return false;
+            name_length_ = value;
+            entry_.name.clear();
+            field_ = name_length_ ? field::NAME : field::FLAGS;
+            break;
+
+        case field::FLAGS:
+            entry_.flags = value;
+            on_entry_(entry_);
+            field_ = --entries_left_ ? field::RANK : field::END;
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+void encode_leaderboard(std::string &out, uint32_t list_version, uint32_t base_version, int total_entries,
+                        const std::vector<leaderboard_entry> &entries)
+{
+    out.append(MAGIC, MAGIC_LENGTH);
+    put_varint(out, LEADERBOARD_FORMAT_VERSION);
+    put_varint(out, list_version);
+    put_varint(out, base_version);
+    put_varint(out, total_entries);
+    put_varint(out, entries.size());
+
+    for (const auto &e : entries) {
+        put_varint(out, e.rank);
+        put_varint(out, e.score);
+        put_varint(out, e.name.size());
+        out.append(e.name);
+        put_varint(out, e.flags);
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Leaderboard responses come either as the original text format, one
+// "score:name:flag\n" line per entry, or as the binary format below (all
+// integers are LEB128 varints):
+//
+//   "KLB" format_version
+//   list_version base_version total_entries num_entries
+//   num_entries x { rank score name_length name[name_length] flags }
+//
+// base_version is 0 for a full list. Otherwise only the entries that changed
+// since base_version are sent; the others keep their cached values.
+
+struct leaderboard_entry
+{
+    int rank; // starting at 1
+    int score;
+    std::string name; // UTF-8
+    int flags;
+};
+
+enum
+{
+    LEADERBOARD_FORMAT_VERSION = 1,
+    LEADERBOARD_HIGHLIGHT_FLAG = 1,
+};
+
+// Parses a response as it arrives, calling on_entry for each entry.
+
+class leaderboard_parser
+{
+public:
+    using entry_callback = std::function<void(const leaderboard_entry &)>;
+
+    leaderboard_parser(const entry_callback &on_entry);
+
+    void reset();
+
+    // returns false if the data is malformed
+    bool feed(const char *data, size_t size);
+
+    // returns true if what was fed so far is a complete response
+    bool finish();
+
+    bool is_binary() const { return format_ == format::BINARY; }
+
+    uint32_t get_list_version() const { return list_version_; }
+    uint32_t get_base_version() const { return base_version_; }
+    int get_total_entries() const { return total_entries_; }
+
+    size_t get_bytes_parsed() const { return bytes_parsed_; }
+
+private:
+    bool feed_text(char ch);
+    bool feed_binary(uint8_t ch);
+    bool on_varint(uint32_t value);
+
+    entry_callback on_entry_;
+
+    enum class format
+    {
+        UNKNOWN,
+        TEXT,
+        BINARY,
+    } format_;
+
+    enum class field
+    {
+        MAGIC,
+        FORMAT_VERSION,
+        LIST_VERSION,
+        BASE_VERSION,
+        TOTAL_ENTRIES,
+        NUM_ENTRIES,
+        RANK,
+        SCORE,
+        NAME_LENGTH,
+        NAME,
+        FLAGS,
+        END,
+    } field_;
+
+    int text_state_;
+    uint32_t varint_;
+    int varint_shift_;
+    size_t name_length_;
+    int entries_left_;
+
+    uint32_t list_version_;
+    uint32_t base_version_;
+    int total_entries_;
+    leaderboard_entry entry_;
+
+    size_t bytes_parsed_;
+    bool failed_;
+};
+
+// Appends the binary encoding of a leaderboard to out.
+void encode_leaderboard(std::string &out, uint32_t list_version, uint32_t base_version, int total_entries,
+                        const std::vector<leaderboard_entry> &entries);
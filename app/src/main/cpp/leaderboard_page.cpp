@@ -3,9 +3,14 @@
 #include "utils.h"
 #include "render.h"
 #include "common.h"
+#include "hiscore_outbox.h"
 #include "http_request.h"
 #include "kasui.h"
+#include "leaderboard_cache.h"
+#include "leaderboard_format.h"
 #include "log.h"
+#include "reactor.h"
+#include "save_queue.h"
 #include "utf8.h"
 #include "fonts.h"
 
@@ -13,10 +18,11 @@
 #include <cstdio>
 #include <cstring>
 
-#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <list>
 
 #include <iomanip>
@@ -27,6 +33,12 @@
 #include <guava2d/texture_manager.h>
 #include <guava2d/xwchar.h>
 
+static http_request *new_http_request()
+{
+    auto &app = kasui::get_instance();
+    return new http_request(app.get_reactor(), app.get_resolver());
+}
+
 void draw_message(const g2d::vec2 &pos, float alpha, const wchar_t *text)
 {
     const auto text_color = g2d::rgba{1., 1., 1., alpha};
@@ -75,8 +87,9 @@ private:
     int score_;
     bool highlight_;
     const g2d::texture *frame_texture_;
-    std::wstring rank_text_;
-    std::wstring score_text_;
+    render::text_layout rank_text_;
+    render::text_layout name_text_;
+    render::text_layout score_text_;
 };
 
 item::item(int rank, const std::wstring &name, int score, bool highlight)
@@ -85,14 +98,15 @@ item::item(int rank, const std::wstring &name, int score, bool highlight)
     , score_(score)
     , highlight_(highlight)
     , frame_texture_(g2d::load_texture("images/w-button-border.png"))
+    , name_text_(get_font(font::tiny), text_align::LEFT, name.c_str())
 {
     initialize_text();
 }
 
 void item::initialize_text()
 {
-    rank_text_ = format_number(rank_);
-    score_text_ = format_number(score_);
+    rank_text_.set_text(get_font(font::tiny), text_align::RIGHT, format_number(rank_).c_str());
+    score_text_.set_text(get_font(font::small), text_align::RIGHT, format_number(score_).c_str());
 }
 
 void item::draw(float alpha) const
@@ -160,11 +174,9 @@ void item::draw(float alpha) const
         const g2d::rgba top_color_outline{.5 * top_color, alpha};
         const g2d::rgba bottom_color_outline{.5 * bottom_color, alpha};
 
-        render::set_text_align(text_align::RIGHT);
-        render::draw_text(get_font(font::small), {}, TEXT_LAYER,
+        render::draw_text(score_text_, {}, TEXT_LAYER,
                 top_color_outline, top_color_text,
-                bottom_color_outline, bottom_color_text,
-                score_text_.c_str());
+                bottom_color_outline, bottom_color_text);
 
         render::pop_matrix();
     }
@@ -174,20 +186,13 @@ void item::draw(float alpha) const
     render::set_blend_mode(blend_mode::INVERSE_BLEND);
 
     {
-        const auto *small_font = get_font(font::small);
         const auto *tiny_font = get_font(font::tiny);
 
-        auto gi_small = small_font->find_glyph(L'X');
-        const float y_small = .5 * (-HEIGHT + gi_small->height) - gi_small->top;
-
         auto gi_tiny = tiny_font->find_glyph(L'X');
         const float y_tiny = .5 * (-HEIGHT + gi_tiny->height) - gi_tiny->top;
 
-        render::set_text_align(text_align::RIGHT);
-        render::draw_text(tiny_font, {50, y_tiny}, TEXT_LAYER, rank_text_.c_str());
-
-        render::set_text_align(text_align::LEFT);
-        render::draw_text(tiny_font, {68, y_tiny}, TEXT_LAYER, name_.c_str());
+        render::draw_text(rank_text_, {50, y_tiny}, TEXT_LAYER);
+        render::draw_text(name_text_, {68, y_tiny}, TEXT_LAYER);
     }
 }
 
@@ -205,11 +210,13 @@ class net_leaderboard : public leaderboard_page
 {
 public:
     net_leaderboard(const std::string &title, const std::string &cache_path, const std::string &url);
+    ~net_leaderboard() override;
 
     void reset() override;
 
     void on_request_error();
-    void on_request_completed(int status, const char *content, size_t content_len);
+    void on_response_body(int status, const byte_span &chunk);
+    void on_request_completed(int status);
 
     void draw(float alpha) const override;
     bool async_check_hiscore(leaderboard_event_listener *listener, int score) override;
@@ -218,7 +225,16 @@ public:
 private:
     static const time_t MAX_CACHE_AGE = 30 * 60; // in seconds
 
+    static const int MAX_BATCH_SIZE = 8; // submissions per request
+    static const uint32_t MIN_RETRY_DELAY = 2 * 1000; // in milliseconds
+    static const uint32_t MAX_RETRY_DELAY = 5 * 60 * 1000;
+
     void start_loading();
+    bool send_request(const std::string &url);
+    void flush_outbox();
+    void schedule_retry();
+    void on_entry_parsed(const leaderboard_entry &entry);
+    bool apply_loaded_items();
 
     bool need_refresh() const;
     bool cache_expired() const;
@@ -239,12 +255,27 @@ private:
     } state_;
 
     std::list<std::pair<leaderboard_event_listener *, int>> check_hiscore_requests_;
+
+    hiscore_outbox outbox_;
+    size_t batch_size_; // submissions in the request in flight, 0 for a plain load
+
+    uint32_t retry_delay_;
+    int retry_timer_;
+
+    // entries of the response currently being parsed go into loading_items_
+    // as they arrive, and are merged into items_ once it's complete
+    leaderboard_parser parser_;
+    std::vector<item *> loading_items_;
+    std::chrono::steady_clock::duration parse_time_;
 };
 
 leaderboard_page::leaderboard_page(const std::string &title, const std::string &cache_path)
     : cache_path_(cache_path)
-    , title_text_(title.begin(), title.end())
+    , list_version_(0)
+    , fetch_time_(0)
 {
+    const std::wstring title_text(title.begin(), title.end());
+    title_text_.set_text(get_font(font::medium), text_align::CENTER, title_text.c_str());
 }
 
 leaderboard_page::~leaderboard_page()
@@ -254,7 +285,7 @@ leaderboard_page::~leaderboard_page()
 
 void leaderboard_page::reset()
 {
-    y_offset_ = 0;
+    y_offset_ = drawn_y_offset_ = 0;
     speed_ = 0;
     tics_ = 0;
 }
@@ -265,6 +296,44 @@ bool leaderboard_page::is_hiscore(int score) const
 }
 
 bool leaderboard_page::load_cache()
+{
+    clear_items();
+
+    list_version_ = 0;
+    fetch_time_ = 0;
+
+    leaderboard_cache_reader cache;
+
+    switch (cache.open(cache_path_)) {
+        case leaderboard_cache_reader::status::OK:
+            break;
+
+        case leaderboard_cache_reader::status::NOT_A_CACHE:
+            return load_text_cache();
+
+        case leaderboard_cache_reader::status::CORRUPT:
+            // not something the text parser could make sense of either;
+            // start over with an empty list, which gets fetched again
+            if (unlink(cache_path_.c_str()) == -1)
+                log_err("unlink %s: %s", cache_path_.c_str(), strerror(errno));
+            return false;
+    }
+
+    items_.reserve(cache.size());
+
+    for (size_t i = 0; i < cache.size(); i++) {
+        const auto &record = cache[i];
+        items_.push_back(new item(record.rank, cache.get_name(record), record.score, false));
+    }
+
+    list_version_ = cache.get_list_version();
+    fetch_time_ = cache.get_fetch_time();
+
+    return true;
+}
+
+// caches written by older versions; the next save_cache() replaces them
+bool leaderboard_page::load_text_cache()
 {
     if (FILE *in = fopen(cache_path_.c_str(), "r")) {
         char line[512];
@@ -273,15 +342,22 @@ bool leaderboard_page::load_cache()
 
         while (fgets(line, sizeof line, in)) {
             char *name = strtok(line, ":");
-            int score = atoi(strtok(nullptr, "\n"));
+            char *score = strtok(nullptr, "\n");
+            if (!name || !score)
+                break;
+
+            const wchar_t *name_wchar = utf8_to_wchar(name);
+            items_.push_back(new item(index, name_wchar, atoi(score), false));
+            delete[] name_wchar;
 
-            // XXX: should check if list is ordered
-            items_.push_back(new item(index, utf8_to_wchar(name), score, false));
             ++index;
         }
 
         fclose(in);
 
+        list_version_ = 0;
+        fetch_time_ = 0;
+
         return true;
     }
 
@@ -290,15 +366,12 @@ bool leaderboard_page::load_cache()
 
 void leaderboard_page::save_cache() const
 {
-    if (FILE *out = fopen(cache_path_.c_str(), "w")) {
-        std::for_each(items_.begin(), items_.end(), [=](const item *p) {
-            unsigned char *name_utf8 = wchar_to_utf8(p->get_name().c_str());
-            fprintf(out, "%s:%d\n", name_utf8, p->get_score());
-            delete[] name_utf8;
-        });
+    leaderboard_cache_writer cache;
 
-        fclose(out);
-    }
+    for (const auto *p : items_)
+        cache.add_entry(p->get_rank(), p->get_score(), p->get_name());
+
+    kasui::get_instance().get_save_queue().save(cache_path_, cache.serialize(list_version_, fetch_time_));
 }
 
 void leaderboard_page::draw_title(float alpha) const
@@ -310,10 +383,8 @@ void leaderboard_page::draw_title(float alpha) const
 
     render::push_matrix();
     render::translate(.5 * window_width, window_height - .5 * TITLE_HEIGHT - 14);
-    render::set_text_align(text_align::CENTER);
-    render::draw_text(get_font(font::medium), {}, 100,
-            outline_color, text_color, outline_color, text_color,
-            title_text_.c_str());
+    render::draw_text(title_text_, {}, 100,
+            outline_color, text_color, outline_color, text_color);
     render::pop_matrix();
 }
 
@@ -363,6 +434,14 @@ void leaderboard_page::update(uint32_t dt)
     }
 }
 
+void leaderboard_page::get_damage(std::vector<render::box> &damage)
+{
+    if (y_offset_ != drawn_y_offset_) {
+        damage.push_back({{0, 0}, {window_width, window_height - TITLE_HEIGHT}});
+        drawn_y_offset_ = y_offset_;
+    }
+}
+
 void leaderboard_page::update_y_offset(float dy)
 {
     const float top_y = window_height - TITLE_HEIGHT;
@@ -456,9 +535,23 @@ net_leaderboard::net_leaderboard(const std::string &title, const std::string &ca
     : leaderboard_page(title, cache_path)
     , url_(url)
     , state_(STATE_NONE)
+    , outbox_(cache_path + "-outbox")
+    , batch_size_(0)
+    , retry_delay_(MIN_RETRY_DELAY)
+    , retry_timer_(-1)
+    , parser_([this](const leaderboard_entry &entry) { on_entry_parsed(entry); })
 {
 }
 
+net_leaderboard::~net_leaderboard()
+{
+    if (retry_timer_ != -1)
+        kasui::get_instance().get_reactor().cancel_timer(retry_timer_);
+
+    for (auto p : loading_items_)
+        delete p;
+}
+
 void net_leaderboard::reset()
 {
     leaderboard_page::reset();
@@ -495,42 +588,112 @@ bool net_leaderboard::need_refresh() const
 
 bool net_leaderboard::cache_expired() const
 {
-    struct stat sb;
-    if (stat(cache_path_.c_str(), &sb) < 0)
-        return true;
-
-    time_t now;
-    time(&now);
-
-    return now - sb.st_ctime > MAX_CACHE_AGE;
+    return time(nullptr) - fetch_time_ > MAX_CACHE_AGE;
 }
 
 void net_leaderboard::start_loading()
 {
-    if (!cache_expired() && load_cache()) {
+    // an expired list is still the base for a delta update
+    if (items_.empty())
+        load_cache();
+
+    if (!outbox_.empty()) {
+        // the response to the submissions is the updated list
+        flush_outbox();
+    } else if (!items_.empty() && !cache_expired()) {
         state_ = STATE_DISPLAYING;
     } else {
-        auto req = new http_request;
-
         state_ = STATE_LOADING;
 
-        bool ok = req->get(url_.c_str(), [this](const http_response &resp) {
-            if (resp.success) {
-                on_request_completed(resp.status, resp.content, resp.content_len);
-            } else {
-                on_request_error();
-            }
-        });
-
-        if (!ok) {
-            delete req;
+        if (!send_request(url_))
             state_ = STATE_ERROR;
-        } else {
-            kasui::get_instance().add_http_request(req);
-        }
     }
 }
 
+bool net_leaderboard::send_request(const std::string &url)
+{
+    auto req = new_http_request();
+
+    for (auto p : loading_items_)
+        delete p;
+    loading_items_.clear();
+
+    parser_.reset();
+    parse_time_ = {};
+
+    // ask for the binary format and, if we know what we have, just for what
+    // changed since then
+    req->set_header("Accept", "application/x-kasui-leaderboard, text/plain;q=0.5");
+    if (list_version_ != 0 && !items_.empty())
+        req->set_header("If-None-Match", "\"" + std::to_string(list_version_) + "\"");
+
+    bool ok = req->get(url.c_str(), [this](int status, const byte_span &chunk) { on_response_body(status, chunk); },
+                       [this](const http_response &resp) {
+                           if (resp.success) {
+                               on_request_completed(resp.status);
+                           } else {
+                               on_request_error();
+                           }
+                       });
+
+    if (!ok) {
+        delete req;
+        return false;
+    }
+
+    kasui::get_instance().add_http_request(req);
+    return true;
+}
+
+void net_leaderboard::flush_outbox()
+{
+    if (outbox_.empty() || state_ == STATE_LOADING)
+        return;
+
+    if (retry_timer_ != -1) {
+        kasui::get_instance().get_reactor().cancel_timer(retry_timer_);
+        retry_timer_ = -1;
+    }
+
+    batch_size_ = std::min(outbox_.size(), static_cast<size_t>(MAX_BATCH_SIZE));
+
+    std::stringstream ss;
+
+    ss << url_ << "?count=" << batch_size_;
+
+    ss << std::hex << std::setfill('0');
+
+    for (size_t i = 0; i < batch_size_; i++) {
+        const auto &p = outbox_[i];
+
+        ss << "&key" << i << '=' << p.key;
+        ss << "&score" << i << '=' << std::dec << p.score << std::hex;
+        ss << "&name" << i << '=';
+        for (unsigned char ch : p.name)
+            ss << '%' << std::setw(2) << static_cast<int>(ch);
+    }
+
+    state_ = STATE_LOADING;
+
+    if (!send_request(ss.str()))
+        on_request_error();
+}
+
+void net_leaderboard::schedule_retry()
+{
+    if (retry_timer_ != -1)
+        return;
+
+    log_debug("leaderboard: %zu hiscores pending, retrying in %u ms", outbox_.size(), retry_delay_);
+
+    retry_timer_ = kasui::get_instance().get_reactor().add_timer(retry_delay_, [this] {
+        retry_timer_ = -1;
+        flush_outbox();
+    });
+
+    retry_delay_ = 2 * retry_delay_ < MAX_RETRY_DELAY ? 2 * retry_delay_ : MAX_RETRY_DELAY;
+}
+
 void net_leaderboard::answer_hiscore_requests()
 {
     assert(state_ == STATE_DISPLAYING || state_ == STATE_ERROR);
@@ -548,71 +711,119 @@ void net_leaderboard::answer_hiscore_requests()
 
 void net_leaderboard::on_request_error()
 {
-    state_ = STATE_ERROR;
+    // if submissions failed, keep showing what we have; they go out later
+    state_ = batch_size_ > 0 && !items_.empty() ? STATE_DISPLAYING : STATE_ERROR;
+    batch_size_ = 0;
+
+    if (!outbox_.empty())
+        schedule_retry();
+
     answer_hiscore_requests();
 }
 
-void net_leaderboard::on_request_completed(int status, const char *content, size_t content_len)
+void net_leaderboard::on_response_body(int status, const byte_span &chunk)
 {
-    if (status != 200) {
-        state_ = STATE_ERROR;
-        answer_hiscore_requests();
+    if (status != 200)
         return;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!parser_.feed(chunk.data, chunk.size)) {
+        // keep going until the request completes, the response is rejected then
+        log_err("malformed leaderboard response");
     }
 
-    clear_items();
+    parse_time_ += std::chrono::steady_clock::now() - start;
+}
 
-    int score = 0;
-    std::string name;
-    bool highlight = false;
+void net_leaderboard::on_entry_parsed(const leaderboard_entry &entry)
+{
+    const wchar_t *name = utf8_to_wchar(entry.name.data(), entry.name.size());
+    loading_items_.push_back(new item(entry.rank, name, entry.score, entry.flags & LEADERBOARD_HIGHLIGHT_FLAG));
+    delete[] name;
+}
 
-    int index = 1;
-    int state = 0;
+bool net_leaderboard::apply_loaded_items()
+{
+    const int total = parser_.get_total_entries();
+    const bool is_delta = parser_.get_base_version() != 0;
 
-    for (const char *p = content; p != &content[content_len]; p++) {
-        char ch = *p;
+    if (is_delta && parser_.get_base_version() != list_version_) {
+        log_err("leaderboard delta against version %u, have %u", parser_.get_base_version(), list_version_);
+        return false;
+    }
 
-        switch (state) {
-            case 0:
-                if (ch == ':') {
-                    state = 1;
-                } else if (ch >= '0' && ch <= '9') {
-                    score = score * 10 + ch - '0';
-                }
-                break;
+    std::vector<item *> items(total, nullptr);
 
-            case 1:
-                if (ch == ':') {
-                    state = 2;
-                } else {
-                    name.push_back(ch);
-                }
-                break;
+    for (auto &p : loading_items_) {
+        std::swap(items[p->get_rank() - 1], p);
+        delete p;
+    }
+    loading_items_.clear();
+
+    // entries that weren't sent in a delta keep their current values
+    if (is_delta) {
+        for (auto &p : items_) {
+            const int rank = p->get_rank();
+            if (rank <= total && !items[rank - 1])
+                std::swap(items[rank - 1], p);
+        }
+    }
 
-            case 2:
-                if (ch == '\n') {
-                    items_.push_back(new item(index, utf8_to_wchar(name.c_str()), score, highlight));
-                    ++index;
+    clear_items();
+    items_.swap(items);
 
-                    score = 0;
-                    name.clear();
-                    highlight = false;
+    if (std::find(items_.begin(), items_.end(), nullptr) != items_.end()) {
+        log_err("incomplete leaderboard delta");
+        items_.erase(std::remove(items_.begin(), items_.end(), nullptr), items_.end());
+        list_version_ = 0;
+        return false;
+    }
 
-                    state = 0;
-                } else if (ch == '1') {
-                    highlight = true;
-                }
-                break;
+    list_version_ = parser_.get_list_version();
 
-            default:
-                assert(0);
-        }
+    return true;
+}
+
+void net_leaderboard::on_request_completed(int status)
+{
+    switch (status) {
+        case 200:
+            if (!parser_.finish() || !apply_loaded_items()) {
+                on_request_error();
+                return;
+            }
+
+            log_debug("leaderboard: %zu bytes, %s%s, %d entries, parsed in %ld us", parser_.get_bytes_parsed(),
+                      parser_.is_binary() ? "binary" : "text", parser_.get_base_version() != 0 ? " delta" : "",
+                      parser_.get_total_entries(),
+                      static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(parse_time_).count()));
+            break;
+
+        case 304:
+            // what we have is still current
+            log_debug("leaderboard: version %u not modified", list_version_);
+            break;
+
+        default:
+            on_request_error();
+            return;
     }
 
+    fetch_time_ = time(nullptr);
     save_cache();
 
+    if (batch_size_ > 0) {
+        outbox_.remove_first(batch_size_);
+        batch_size_ = 0;
+        retry_delay_ = MIN_RETRY_DELAY;
+    }
+
     state_ = STATE_DISPLAYING;
     answer_hiscore_requests();
+
+    // hiscores added while the request was in flight
+    flush_outbox();
 }
 
 void net_leaderboard::draw_loading_message(float alpha) const
@@ -652,39 +863,9 @@ bool net_leaderboard::async_check_hiscore(leaderboard_event_listener *listener,
 
 bool net_leaderboard::async_insert_hiscore(leaderboard_event_listener *listener, const wchar_t *name, int score)
 {
-    assert(state_ == STATE_DISPLAYING);
-
-    std::stringstream ss;
-
-    ss << url_ << "?score=" << score << "&name=";
-
-    ss << std::hex;
-
-    auto name_utf8 = wchar_to_utf8(name);
-    for (auto *p = name_utf8; *p; p++)
-        ss << '%' << static_cast<int>(*p);
-    delete[] name_utf8;
-
-    auto req = new http_request;
-
-    state_ = STATE_LOADING;
-
-    bool ok = req->get(url_.c_str(), [this](const http_response &resp) {
-        if (resp.success) {
-            on_request_completed(resp.status, resp.content, resp.content_len);
-        } else {
-            on_request_error();
-        }
-    });
-
-    if (!ok) {
-        delete req;
-        state_ = STATE_ERROR;
-        return false;
-    } else {
-        kasui::get_instance().add_http_request(req);
-        return true;
-    }
+    outbox_.add(score, name);
+    flush_outbox();
+    return true;
 }
 
 leaderboard_page &get_net_leaderboard()
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "render.h"
+
+#include <cstdint>
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -35,6 +39,10 @@ public:
 
     void update(uint32_t dt);
 
+    // appends the list if it scrolled since the last call, see
+    // state::get_damage(); the rest only changes with input or responses
+    void get_damage(std::vector<render::box> &damage);
+
     void on_drag_start();
     void on_drag_end();
     void on_drag(float dy);
@@ -46,6 +54,7 @@ protected:
 
     bool is_hiscore(int score) const;
     bool load_cache();
+    bool load_text_cache();
     void save_cache() const;
     void draw_title(float alpha) const;
     void draw_items(float alpha) const;
@@ -55,9 +64,12 @@ protected:
 
     std::string cache_path_;
 
-    std::wstring title_text_;
+    render::text_layout title_text_;
     std::vector<item *> items_;
+    uint32_t list_version_; // version of items_ according to the server, 0 if unknown
+    time_t fetch_time_; // when items_ was last known to be current
     float y_offset_;
+    float drawn_y_offset_; // at the last get_damage()
     int touch_start_tic_;
     float total_drag_dy_;
     float speed_;
@@ -14,9 +14,20 @@ line_splitter::line_splitter(const g2d::font *font, const wchar_t *str)
 
 std::wstring line_splitter::next_line(int max_size)
 {
-    if (!*str_)
+    size_t length;
+    const wchar_t *line = next_line(max_size, length);
+
+    if (!line)
         return {};
 
+    return std::wstring(line, line + length);
+}
+
+const wchar_t *line_splitter::next_line(int max_size, size_t &length)
+{
+    if (!*str_)
+        return nullptr;
+
     const wchar_t *line_end = nullptr;
 
     int size = 0;
@@ -31,13 +42,10 @@ std::wstring line_splitter::next_line(int max_size)
 
     assert(line_end);
 
-    size_t result_len = line_end - str_;
-
-    std::wstring result;
-    result.reserve(result_len);
-    result.append(str_, str_ + result_len);
+    const wchar_t *line = str_;
+    length = line_end - str_;
 
     str_ = *line_end ? line_end + 1 : line_end;
 
-    return result;
+    return line;
 }
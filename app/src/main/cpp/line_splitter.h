@@ -16,6 +16,10 @@ public:
 
     std::wstring next_line(int size);
 
+    // like the above, but points into the string instead of copying the
+    // line: returns its start and sets length, or nullptr at the end
+    const wchar_t *next_line(int size, size_t &length);
+
 private:
     const g2d::font *font_;
     const wchar_t *str_;
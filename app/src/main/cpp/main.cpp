@@ -4,6 +4,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <chrono>
 #include <vector>
 
 #include <stdint.h>
@@ -19,8 +21,10 @@
 #include "guava2d/panic.h"
 
 #include "common.h"
+#include "frame_scheduler.h"
 #include "in_game.h"
 #include "kasui.h"
+#include "render.h"
 
 #ifdef DUMP_FRAMES
 extern "C" {
@@ -33,8 +37,14 @@ extern "C" {
 static const char *WINDOW_CAPTION = "K-RAD";
 static bool mouse_button_down = false;
 
+// how long to block waiting for network events when there's nothing to draw;
+// also bounds the latency of input events, which SDL can't wake us up for
+static const int IDLE_POLL_MS = 10;
+
 const char *options_file_path = "data/options";
 const char *jukugo_hits_file_path = "data/jukugo-hits";
+const char *save_file_path = "data/save";
+const char *program_cache_path = "data/program-cache";
 
 #ifdef DUMP_FRAMES
 static uint32_t last_frame_dump;
@@ -167,7 +177,7 @@ static void dump_frames_end()
 }
 #endif
 
-static void init_sdl(int width, int height)
+static void init_sdl(int width, int height, bool vsync)
 {
     Uint32 flags = SDL_INIT_VIDEO;
 #ifdef ENABLE_AUDIO
@@ -177,6 +187,9 @@ static void init_sdl(int width, int height)
     if (SDL_Init(flags) < 0)
         panic("SDL_Init: %s", SDL_GetError());
 
+    // has to be set before the GL context is created
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsync);
+
     if (SDL_SetVideoMode(width, height, 0, SDL_OPENGL) == nullptr)
         panic("SDL_SetVideoMode: %s", SDL_GetError());
 
@@ -185,8 +198,6 @@ static void init_sdl(int width, int height)
         fprintf(stderr, "Mix_OpenAudio failed\n");
 #endif
 
-    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 1);
-
     SDL_WM_SetCaption(WINDOW_CAPTION, nullptr);
 }
 
@@ -205,7 +216,7 @@ static void tear_down_sdl()
     SDL_Quit();
 }
 
-static void init(int width, int height)
+static void init(int width, int height, bool vsync)
 {
 #ifdef ENABLE_AUDIO
     extern void sounds_initialize();
@@ -215,7 +226,7 @@ static void init(int width, int height)
 
     srand(time(nullptr));
 
-    init_sdl(width, height);
+    init_sdl(width, height, vsync);
     init_glew();
 #ifdef ENABLE_AUDIO
     sounds_initialize();
@@ -354,7 +365,7 @@ static void handle_events(kasui &k)
     }
 }
 
-static void event_loop()
+static void event_loop(frame_scheduler &scheduler)
 {
     kasui &k = kasui::get_instance();
 
@@ -362,10 +373,100 @@ static void event_loop()
 
     while (running) {
         handle_events(k);
+
+        if (!k.needs_redraw()) {
+            k.idle(IDLE_POLL_MS);
+            continue;
+        }
+
+        const int wait = scheduler.time_to_next_frame();
+        if (wait > 0) {
+            SDL_Delay(wait);
+            continue;
+        }
+
+        scheduler.frame_started();
         redraw(k);
     }
 }
 
+// renders frames back to back in both modes and reports throughput and
+// latency; run with -n, vsync would just measure the display's refresh rate
+static void run_benchmark(int frames)
+{
+    kasui &k = kasui::get_instance();
+
+    for (bool pipelined : {false, true}) {
+        k.set_pipelined(pipelined);
+
+        // let the pipeline fill and the driver settle
+        for (int i = 0; i < 60; i++)
+            redraw(k);
+
+        std::vector<float> latencies;
+        latencies.reserve(frames);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < frames; i++) {
+            handle_events(k);
+            redraw(k);
+            latencies.push_back(k.get_frame_latency());
+        }
+
+        const float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+
+        float total = 0;
+        for (float l : latencies)
+            total += l;
+
+        printf("%-9s %8.1f fps   latency (ms): avg %.2f, p50 %.2f, p99 %.2f\n", pipelined ? "pipelined" : "serial",
+               frames / elapsed, total / frames, latencies[frames / 2], latencies[frames * 99 / 100]);
+    }
+}
+
+// Times recording the stats and leaderboard pages with and without the
+// per-transform-class vertex paths in the sprite batch.
+static void run_transform_benchmark(int frames)
+{
+    kasui &k = kasui::get_instance();
+
+    const struct
+    {
+        const char *name;
+        void (*start)();
+    } pages[] = {{"stats", start_stats_page}, {"leaderboard", start_hiscore_list}};
+
+    for (const auto &page : pages) {
+        page.start();
+
+        for (bool fast_paths : {false, true}) {
+            render::set_transform_fast_paths(fast_paths);
+
+            // let the page finish sliding in
+            for (int i = 0; i < 60; i++)
+                redraw(k);
+
+            float total = 0;
+
+            for (int i = 0; i < frames; i++) {
+                handle_events(k);
+                redraw(k);
+                total += k.get_record_time();
+            }
+
+            printf("%-11s %-11s record %.3f ms/frame\n", page.name, fast_paths ? "fast paths" : "full matrix",
+                   total / frames);
+        }
+
+        pop_state();
+    }
+
+    render::set_transform_fast_paths(true);
+}
+
 void on_rate_me_clicked()
 {
     printf("rate me!\n");
@@ -374,9 +475,15 @@ void on_rate_me_clicked()
 int main(int argc, char *argv[])
 {
     int width = 320, height = 480;
+    int max_fps = 60;
+    bool vsync = true;
+    bool pipelined = false;
+    int benchmark_frames = 0;
+    int transform_benchmark_frames = 0;
+    bool show_damage = false;
     int opt;
 
-    while ((opt = getopt(argc, argv, "w:h:")) != -1) {
+    while ((opt = getopt(argc, argv, "w:h:f:npb:t:d")) != -1) {
         switch (opt) {
             case 'w':
                 width = atoi(optarg);
@@ -385,11 +492,48 @@ int main(int argc, char *argv[])
             case 'h':
                 height = atoi(optarg);
                 break;
+
+            case 'f':
+                max_fps = atoi(optarg); // 0 for no cap
+                break;
+
+            case 'n':
+                vsync = false;
+                break;
+
+            case 'p':
+                pipelined = true;
+                break;
+
+            case 'b':
+                benchmark_frames = atoi(optarg);
+                break;
+
+            case 't':
+                transform_benchmark_frames = atoi(optarg);
+                break;
+
+            case 'd':
+                show_damage = true;
+                break;
         }
     }
 
-    init(width, height);
-    event_loop();
+    frame_scheduler scheduler(max_fps);
+
+    init(width, height, vsync);
+
+    render::set_show_damage(show_damage);
+
+    if (benchmark_frames > 0) {
+        run_benchmark(benchmark_frames);
+    } else if (transform_benchmark_frames > 0) {
+        run_transform_benchmark(transform_benchmark_frames);
+    } else {
+        kasui::get_instance().set_pipelined(pipelined);
+        event_loop(scheduler);
+    }
+
     tear_down();
 
     return 0;
@@ -46,6 +46,7 @@ public:
     void reset();
     void redraw() const;
     void update(uint32_t dt);
+    bool get_damage(std::vector<render::box> &damage);
     void on_touch_down(float x, float y);
     void on_touch_up();
     void on_touch_move(float x, float y);
@@ -91,6 +92,7 @@ private:
 
     uint32_t state_t_;
     bool touch_is_down_ = false;
+    bool was_animating_ = true; // at the last get_damage()
 };
 
 main_menu_impl::main_menu_impl()
@@ -374,6 +376,19 @@ void main_menu_impl::update(uint32_t dt)
     }
 }
 
+bool main_menu_impl::get_damage(std::vector<render::box> &damage)
+{
+    const bool background_settled = background_.get_damage(damage);
+
+    // fading, or the menu sliding in or out, anywhere on the screen; the
+    // frame after it stops is redrawn in full too
+    const bool animating = cur_state_ != state::ACTIVE || cur_menu_->is_animating();
+    const bool was_animating = was_animating_;
+    was_animating_ = animating;
+
+    return background_settled && !animating && !was_animating;
+}
+
 void main_menu_impl::on_touch_down(float x, float y)
 {
     touch_is_down_ = true;
@@ -426,6 +441,11 @@ void main_menu_state::update(uint32_t dt)
     impl_->update(dt);
 }
 
+bool main_menu_state::get_damage(std::vector<render::box> &damage)
+{
+    return impl_->get_damage(damage);
+}
+
 void main_menu_state::on_touch_down(float x, float y)
 {
     impl_->on_touch_down(x, y);
@@ -13,6 +13,7 @@ public:
     void reset() override;
     void redraw() const override;
     void update(uint32_t dt) override;
+    bool get_damage(std::vector<render::box> &damage) override;
     void on_touch_down(float x, float y) override;
     void on_touch_up() override;
     void on_touch_move(float x, float y) override;
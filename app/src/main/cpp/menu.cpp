@@ -156,6 +156,14 @@ void menu::draw() const
     }
 }
 
+bool menu::is_animating() const
+{
+    if (cur_state_ == state::INTRO || cur_state_ == state::OUTRO)
+        return true;
+
+    return std::any_of(item_list_.begin(), item_list_.end(), [](const auto &p) { return p->is_active(); });
+}
+
 void menu::update(uint32_t dt)
 {
     state_t_ += dt;
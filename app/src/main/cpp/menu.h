@@ -36,6 +36,7 @@ public:
     void reset();
     void update(uint32_t dt);
     float get_active_t() const;
+    bool is_active() const { return is_active_; }
 
     int get_sound() const { return sound_; }
 
@@ -146,6 +147,8 @@ public:
 
     bool is_in_outro() const { return cur_state_ == state::OUTRO; }
 
+    bool is_animating() const;
+
     float get_cur_alpha() const;
 
 private:
@@ -9,6 +9,7 @@
 #include <guava2d/xwchar.h>
 
 #include "options.h"
+#include "save_file.h"
 #include "utf8.h"
 
 namespace {
@@ -25,12 +26,13 @@ const struct name_to_option
     const char *name;
     option_type type;
     int options::*value;
+    save_section section;
 } name_to_options[] = {
-    {"enable-hints", OPTION_INTEGER, &options::enable_hints},
-    {"max-unlocked-level", OPTION_INTEGER, &options::max_unlocked_level},
-    {"enable-sound", OPTION_INTEGER, &options::enable_sound},
-    {"player-name", OPTION_STRING, reinterpret_cast<int options::*>(&options::player_name)},
-    {nullptr, OPTION_NONE, nullptr},
+    {"enable-hints", OPTION_INTEGER, &options::enable_hints, save_section::OPTIONS},
+    {"max-unlocked-level", OPTION_INTEGER, &options::max_unlocked_level, save_section::PROGRESS},
+    {"enable-sound", OPTION_INTEGER, &options::enable_sound, save_section::OPTIONS},
+    {"player-name", OPTION_STRING, reinterpret_cast<int options::*>(&options::player_name), save_section::OPTIONS},
+    {nullptr, OPTION_NONE, nullptr, save_section::OPTIONS},
 };
 
 } // namespace
@@ -89,31 +91,70 @@ options *options::load(const char *path)
     return o;
 }
 
-void options::save(const char *path) const
+// each option is saved as its name, type and value, so options can be added
+// or removed without breaking older files
+
+std::string options::serialize(save_section section) const
 {
-    FILE *out;
+    save_data_writer writer;
 
-    if ((out = fopen(path, "w")) != nullptr) {
-        for (const name_to_option *p = name_to_options; p->name; p++) {
-            switch (p->type) {
-                case OPTION_INTEGER:
-                    fprintf(out, "%s %d\n", p->name, this->*p->value);
-                    break;
+    for (const name_to_option *p = name_to_options; p->name; p++) {
+        if (p->section != section)
+            continue;
 
-                case OPTION_STRING:
-                    if (const wchar_t *value = this->*reinterpret_cast<wchar_t * options::*>(p->value)) {
-                        unsigned char *value_utf8 = wchar_to_utf8(value);
-                        fprintf(out, "%s %s\n", p->name, value_utf8);
-                        delete[] value_utf8;
-                    }
-                    break;
+        switch (p->type) {
+            case OPTION_INTEGER:
+                writer.put_string(p->name);
+                writer.put_u32(p->type);
+                writer.put_u32(this->*p->value);
+                break;
 
-                default:
-                    assert(0);
-            }
+            case OPTION_STRING:
+                if (const wchar_t *value = this->*reinterpret_cast<wchar_t * options::*>(p->value)) {
+                    unsigned char *value_utf8 = wchar_to_utf8(value);
+                    writer.put_string(p->name);
+                    writer.put_u32(p->type);
+                    writer.put_string(reinterpret_cast<const char *>(value_utf8));
+                    delete[] value_utf8;
+                }
+                break;
+
+            default:
+                assert(0);
         }
+    }
 
-        fclose(out);
+    return std::move(writer.get_data());
+}
+
+void options::deserialize(const std::string &data)
+{
+    save_data_reader reader(data);
+
+    while (!reader.at_end()) {
+        std::string name;
+        uint32_t type;
+        if (!reader.get_string(name) || !reader.get_u32(type))
+            break;
+
+        uint32_t int_value = 0;
+        std::string string_value;
+
+        if (type == OPTION_INTEGER ? !reader.get_u32(int_value) : !reader.get_string(string_value))
+            break;
+
+        for (const name_to_option *p = name_to_options; p->name; p++) {
+            if (name == p->name && type == p->type) {
+                if (p->type == OPTION_INTEGER) {
+                    this->*p->value = int_value;
+                } else {
+                    wchar_t *&value = this->*reinterpret_cast<wchar_t * options::*>(p->value);
+                    delete[] value;
+                    value = utf8_to_wchar(string_value.c_str());
+                }
+                break;
+            }
+        }
     }
 }
 
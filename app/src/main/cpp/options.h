@@ -1,12 +1,21 @@
 #ifndef OPTIONS_H_
 #define OPTIONS_H_
 
+#include <cstdint>
+#include <string>
+
+enum class save_section : uint32_t;
+
 struct options
 {
     options();
 
+    // options file written by older versions
     static options *load(const char *path);
-    void save(const char *path) const;
+
+    // contents of the options or progress section of the save file
+    std::string serialize(save_section section) const;
+    void deserialize(const std::string &data);
 
     void set_player_name(const wchar_t *name);
 
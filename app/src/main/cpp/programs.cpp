@@ -1,13 +1,173 @@
 #include "programs.h"
 
+#include "common.h"
+#include "kasui.h"
+#include "log.h"
 #include "noncopyable.h"
+#include "save_file.h"
+#include "save_queue.h"
 
+#include <guava2d/file.h>
 #include <guava2d/program.h>
 
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace
 {
+std::string read_source(const char *path)
+{
+    g2d::file_input_stream file(path);
+
+    std::string source(file.size(), '\0');
+    file.read(&source[0], source.size());
+
+    return source;
+}
+
+// FNV-1a
+uint64_t hash_string(const std::string &s, uint64_t hash = 14695981039346656037ull)
+{
+    for (unsigned char ch : s)
+    {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string get_gl_string(GLenum name)
+{
+    const auto *s = reinterpret_cast<const char *>(GL_CHECK_R(glGetString(name)));
+    return s ? s : "";
+}
+
+// Linked program binaries from previous runs, keyed by a hash of their
+// sources. Binaries are only good for the driver that produced them, so the
+// whole cache is dropped when the driver changes.
+//
+//   "KPBC" driver num_programs num_programs x { source_hash format binary }
+
+class program_binary_cache : private noncopyable
+{
+public:
+    program_binary_cache();
+
+    void load(const std::string &path);
+    void save(const std::string &path) const;
+
+    bool find(uint64_t source_hash, GLenum &format, const std::vector<char> *&binary) const;
+    void add(uint64_t source_hash, GLenum format, std::vector<char> binary);
+
+    bool is_dirty() const { return dirty_; }
+
+private:
+    std::string driver_;
+    std::map<uint64_t, std::pair<GLenum, std::vector<char>>> binaries_;
+    bool dirty_;
+};
+
+const char CACHE_MAGIC[] = "KPBC";
+
+program_binary_cache::program_binary_cache()
+    : driver_(get_gl_string(GL_VENDOR) + '\n' + get_gl_string(GL_RENDERER) + '\n' + get_gl_string(GL_VERSION))
+    , dirty_(false)
+{
+}
+
+void program_binary_cache::load(const std::string &path)
+{
+    std::string contents;
+
+    if (FILE *in = fopen(path.c_str(), "rb"))
+    {
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof buf, in)) > 0)
+            contents.append(buf, n);
+        fclose(in);
+    }
+
+    save_data_reader reader(contents);
+
+    std::string magic, driver;
+    uint32_t num_programs;
+
+    if (!reader.get_string(magic) || magic != CACHE_MAGIC || !reader.get_string(driver) ||
+        !reader.get_u32(num_programs))
+        return;
+
+    if (driver != driver_)
+    {
+        log_debug("driver changed, dropping program binaries");
+        return;
+    }
+
+    for (uint32_t i = 0; i < num_programs; i++)
+    {
+        uint32_t hash_lo, hash_hi, format;
+        std::string binary;
+
+        if (!reader.get_u32(hash_lo) || !reader.get_u32(hash_hi) || !reader.get_u32(format) ||
+            !reader.get_string(binary))
+        {
+            // the entries before this one are whole; the programs that lost
+            // theirs get compiled and the cache rewritten
+            log_debug("program binary cache truncated after %u of %u programs", i, num_programs);
+            break;
+        }
+
+        if (binary.empty())
+            continue;
+
+        const uint64_t source_hash = (static_cast<uint64_t>(hash_hi) << 32) | hash_lo;
+        binaries_[source_hash] = std::make_pair(format, std::vector<char>(binary.begin(), binary.end()));
+    }
+}
+
+void program_binary_cache::save(const std::string &path) const
+{
+    save_data_writer writer;
+
+    writer.put_string(CACHE_MAGIC);
+    writer.put_string(driver_);
+    writer.put_u32(binaries_.size());
+
+    for (const auto &p : binaries_)
+    {
+        writer.put_u32(p.first);
+        writer.put_u32(p.first >> 32);
+        writer.put_u32(p.second.first);
+        writer.put_string(std::string(p.second.second.begin(), p.second.second.end()));
+    }
+
+    kasui::get_instance().get_save_queue().save(path, std::move(writer.get_data()));
+}
+
+bool program_binary_cache::find(uint64_t source_hash, GLenum &format, const std::vector<char> *&binary) const
+{
+    auto it = binaries_.find(source_hash);
+    if (it == binaries_.end())
+        return false;
+
+    format = it->second.first;
+    binary = &it->second.second;
+    return true;
+}
+
+void program_binary_cache::add(uint64_t source_hash, GLenum format, std::vector<char> binary)
+{
+    if (binary.empty())
+        return;
+
+    binaries_[source_hash] = std::make_pair(format, std::move(binary));
+    dirty_ = true;
+}
+
 class program_manager : private noncopyable
 {
 public:
@@ -41,33 +201,85 @@ void program_manager::load_programs()
         { "shaders/flat.vert", "shaders/flat.frag" },
         { "shaders/sprite.vert", "shaders/sprite.frag" },
         { "shaders/sprite_3d.vert", "shaders/sprite.frag" },
+        { "shaders/sprite.vert", "shaders/text.frag" },
         { "shaders/sprite.vert", "shaders/text_inner.frag" },
         { "shaders/sprite.vert", "shaders/text_outline.frag" },
         { "shaders/sprite_2c.vert", "shaders/text_gradient.frag" },
         { "shaders/grid_background.vert", "shaders/sprite.frag" },
+        { "shaders/gradient.vert", "shaders/gradient.frag" },
     };
 
+    const auto start = std::chrono::steady_clock::now();
+
+    const bool use_binaries = g2d::program::binaries_supported();
+
+    program_binary_cache cache;
+    if (use_binaries)
+        cache.load(program_cache_path);
+
+    int num_cached = 0;
+
     programs_.reserve(static_cast<int>(program::program_count));
 
     for (const auto &source : program_sources)
     {
-        g2d::shader vert_shader(GL_VERTEX_SHADER);
-        vert_shader.load_source(source.vertex_shader);
-        vert_shader.compile();
-
-        g2d::shader frag_shader(GL_FRAGMENT_SHADER);
-        frag_shader.load_source(source.fragment_shader);
-        frag_shader.compile();
+        const auto vert_source = read_source(source.vertex_shader);
+        const auto frag_source = read_source(source.fragment_shader);
+        const auto source_hash = hash_string(frag_source, hash_string(vert_source));
 
         auto program = new g2d::program;
 
         program->initialize();
-        program->attach(vert_shader);
-        program->attach(frag_shader);
-        program->link();
+
+        GLenum format;
+        const std::vector<char> *binary;
+
+        if (use_binaries && cache.find(source_hash, format, binary) && program->load_binary(format, *binary))
+        {
+            ++num_cached;
+        }
+        else
+        {
+            g2d::shader vert_shader(GL_VERTEX_SHADER);
+            vert_shader.set_source(vert_source.c_str());
+            vert_shader.compile();
+
+            g2d::shader frag_shader(GL_FRAGMENT_SHADER);
+            frag_shader.set_source(frag_source.c_str());
+            frag_shader.compile();
+
+            program->attach(vert_shader);
+            program->attach(frag_shader);
+            if (use_binaries)
+                program->set_binary_retrievable();
+            program->link();
+
+            std::vector<char> data;
+            if (use_binaries && program->get_binary(format, data))
+                cache.add(source_hash, format, std::move(data));
+        }
+
+        program->bind_uniform_block("frame_uniforms", FRAME_UNIFORMS_BINDING);
+
+        // all our programs sample from texture unit 0
+        if (program->has_uniform("tex"))
+        {
+            program->use();
+            program->set_uniform_i("tex", 0);
+        }
 
         programs_.push_back(program);
     }
+
+    if (cache.is_dirty())
+        cache.save(program_cache_path);
+
+    // cold: something had to be compiled, warm: everything came from the cache
+    const int num_programs = programs_.size();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    log_debug("%s start: %d of %d programs from cache, %ld ms", num_cached == num_programs ? "warm" : "cold",
+              num_cached, num_programs,
+              static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
 }
 }
 
@@ -12,12 +12,18 @@ enum class program
     flat,
     sprite_2d,
     sprite_3d,
+    text,
     text_inner,
     text_outline,
     text_gradient,
     grid_background,
+    gradient,
     program_count,
 };
 
+// binding point of the uniform block with the per-frame data (projection)
+// shared by the 2D programs
+enum { FRAME_UNIFORMS_BINDING = 0 };
+
 void initialize_programs();
 const g2d::program *get_program(program p);
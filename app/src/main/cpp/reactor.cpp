@@ -0,0 +1,218 @@
+#include "reactor.h"
+
+#include "log.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+namespace {
+
+const int MAX_EVENTS = 32;
+
+#ifdef __linux__
+uint32_t to_epoll_events(int events)
+{
+    uint32_t e = 0;
+    if (events & reactor::READABLE)
+        e |= EPOLLIN;
+    if (events & reactor::WRITEABLE)
+        e |= EPOLLOUT;
+    return e;
+}
+
+// the fd and the generation of its watcher, so events for an fd that was
+// closed and reused by an earlier handler in the same batch can be told apart
+uint64_t to_epoll_data(int fd, uint32_t generation)
+{
+    return static_cast<uint64_t>(generation) << 32 | static_cast<uint32_t>(fd);
+}
+
+int from_epoll_events(uint32_t e)
+{
+    int events = 0;
+    if (e & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        events |= reactor::READABLE;
+    if (e & (EPOLLOUT | EPOLLERR))
+        events |= reactor::WRITEABLE;
+    return events;
+}
+#endif
+
+} // namespace
+
+reactor::reactor()
+    : poll_fd_(-1)
+    , next_generation_(0)
+    , next_timer_id_(0)
+{
+#ifdef __linux__
+    if ((poll_fd_ = epoll_create1(EPOLL_CLOEXEC)) == -1)
+        log_err("epoll_create1: %s", strerror(errno));
+#endif
+}
+
+reactor::~reactor()
+{
+    if (poll_fd_ != -1)
+        close(poll_fd_);
+}
+
+uint64_t reactor::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000ull;
+}
+
+bool reactor::watch(int fd, int events, handler *h)
+{
+    auto it = watchers_.find(fd);
+
+    const uint32_t generation = it == watchers_.end() ? next_generation_++ : it->second.generation;
+
+#ifdef __linux__
+    struct epoll_event ev = {};
+    ev.events = to_epoll_events(events);
+    ev.data.u64 = to_epoll_data(fd, generation);
+
+    if (epoll_ctl(poll_fd_, it == watchers_.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == -1) {
+        log_err("epoll_ctl: %s", strerror(errno));
+        return false;
+    }
+#endif
+
+    if (it == watchers_.end())
+        watchers_.insert(std::make_pair(fd, watcher{h, events, generation}));
+    else
+        it->second = watcher{h, events, generation};
+
+    return true;
+}
+
+void reactor::unwatch(int fd)
+{
+    auto it = watchers_.find(fd);
+    if (it == watchers_.end())
+        return;
+
+#ifdef __linux__
+    epoll_ctl(poll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+
+    watchers_.erase(it);
+}
+
+int reactor::add_timer(uint32_t delay, const timer_callback &callback)
+{
+    const int id = next_timer_id_++;
+    timers_.insert(std::make_pair(timer_key(now() + delay, id), callback));
+    return id;
+}
+
+void reactor::cancel_timer(int id)
+{
+    for (auto it = timers_.begin(); it != timers_.end(); ++it) {
+        if (it->first.second == id) {
+            timers_.erase(it);
+            break;
+        }
+    }
+}
+
+void reactor::poll(int timeout)
+{
+    if (!timers_.empty()) {
+        const uint64_t t = now();
+        const uint64_t deadline = timers_.begin()->first.first;
+        const int timer_timeout = deadline > t ? deadline - t : 0;
+
+        if (timeout < 0 || timer_timeout < timeout)
+            timeout = timer_timeout;
+    }
+
+    if (watchers_.empty()) {
+        if (timeout > 0)
+            usleep(timeout * 1000);
+    } else {
+        // handlers may unwatch other fds while we dispatch, or close them and
+        // watch a new one that got the same number, so look each one up again
+        // and check it's still the registration the event was for
+
+#ifdef __linux__
+        struct epoll_event events[MAX_EVENTS];
+
+        const int n = epoll_wait(poll_fd_, events, MAX_EVENTS, timeout);
+        if (n == -1 && errno != EINTR)
+            log_err("epoll_wait: %s", strerror(errno));
+
+        for (int i = 0; i < n; i++) {
+            const uint64_t data = events[i].data.u64;
+            const int fd = static_cast<int>(data & 0xffffffff);
+            const uint32_t generation = data >> 32;
+
+            auto it = watchers_.find(fd);
+            if (it != watchers_.end() && it->second.generation == generation)
+                it->second.h->on_ready(fd, from_epoll_events(events[i].events));
+        }
+#else
+        std::vector<struct pollfd> fds;
+        std::vector<uint32_t> generations;
+        fds.reserve(watchers_.size());
+        generations.reserve(watchers_.size());
+
+        for (const auto &p : watchers_) {
+            short e = 0;
+            if (p.second.events & READABLE)
+                e |= POLLIN;
+            if (p.second.events & WRITEABLE)
+                e |= POLLOUT;
+            fds.push_back({p.first, e, 0});
+            generations.push_back(p.second.generation);
+        }
+
+        const int n = ::poll(&fds[0], fds.size(), timeout);
+        if (n == -1 && errno != EINTR)
+            log_err("poll: %s", strerror(errno));
+
+        for (int i = 0; n > 0 && i < static_cast<int>(fds.size()); i++) {
+            const short e = fds[i].revents;
+            if (!e)
+                continue;
+
+            int events = 0;
+            if (e & (POLLIN | POLLHUP | POLLERR | POLLNVAL))
+                events |= READABLE;
+            if (e & (POLLOUT | POLLERR | POLLNVAL))
+                events |= WRITEABLE;
+
+            auto it = watchers_.find(fds[i].fd);
+            if (it != watchers_.end() && it->second.generation == generations[i])
+                it->second.h->on_ready(fds[i].fd, events);
+        }
+#endif
+    }
+
+    run_timers();
+}
+
+void reactor::run_timers()
+{
+    const uint64_t t = now();
+
+    while (!timers_.empty() && timers_.begin()->first.first <= t) {
+        // the callback may add or cancel timers
+        auto callback = std::move(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+        callback();
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Multiplexes all the app's sockets and timers. poll() is called once per
+// frame and dispatches readiness and expired timers to their handlers.
+
+class reactor : private noncopyable
+{
+public:
+    enum
+    {
+        READABLE = 1,
+        WRITEABLE = 2,
+    };
+
+    class handler
+    {
+    public:
+        virtual ~handler() {}
+        virtual void on_ready(int fd, int events) = 0;
+    };
+
+    using timer_callback = std::function<void()>;
+
+    reactor();
+    ~reactor();
+
+    // (re)registers fd; events is a mask of READABLE and WRITEABLE. Errors
+    // and hangups are reported as both, the handler finds out which it was
+    // when it reads or writes
+    bool watch(int fd, int events, handler *h);
+    void unwatch(int fd);
+
+    // returns an id that can be passed to cancel_timer
+    int add_timer(uint32_t delay, const timer_callback &callback);
+    void cancel_timer(int id);
+
+    // waits for at most timeout ms (0 to just check) and dispatches events
+    void poll(int timeout);
+
+    static uint64_t now();
+
+private:
+    void run_timers();
+
+    struct watcher
+    {
+        handler *h;
+        int events;
+        uint32_t generation; // tells this registration of the fd from later ones
+    };
+
+    int poll_fd_;
+    std::unordered_map<int, watcher> watchers_;
+    uint32_t next_generation_;
+
+    using timer_key = std::pair<uint64_t, int>; // deadline, id
+    std::map<timer_key, timer_callback> timers_;
+    int next_timer_id_;
+};
@@ -1,54 +1,335 @@
 #include "render.h"
 #include "noncopyable.h"
 
+#include "common.h"
+#include "log.h"
 #include "programs.h"
 
+#include <guava2d/framebuffer.h>
 #include <guava2d/g2dgl.h>
+#include <guava2d/gl_state.h>
 #include <guava2d/font.h>
 #include <guava2d/program.h>
 #include <guava2d/rgb.h>
 #include <guava2d/texture.h>
+#include <guava2d/transform.h>
 #include <guava2d/gl_buffer.h>
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <limits>
 #include <stack>
+#include <string>
 #include <tuple>
 
 namespace render {
 
 namespace {
 
-void gl_set_blend_mode(blend_mode mode)
+// quads are handed to g2d::transform_points as arrays of four points
+static_assert(sizeof(quad) == 4 * sizeof(g2d::vec2), "quad must be packed");
+
+struct sprite
+{
+    int layer;
+    const g2d::program *program;
+    const g2d::texture *texture;
+    const offscreen_layer::impl *offscreen; // instead of texture, to composite a layer
+    int num_vert_colors; // for now always 1 or 2
+    quad verts;
+    quad texcoords;
+    vert_colors colors[2];
+    blend_mode blend;
+    bool scissor_test;
+};
+
+struct scissor_box
+{
+    int x, y;
+    int width, height;
+};
+
+struct command
+{
+    enum class type
+    {
+        DRAW_SPRITES,
+        SET_PROJECTION,
+        CALL,
+        BEGIN_OFFSCREEN,
+        END_OFFSCREEN,
+    } kind;
+
+    // DRAW_SPRITES: range in command_list::impl::sprites, sorted and drawn together
+    int first_sprite, num_sprites;
+    scissor_box scissor;
+
+    // SET_PROJECTION
+    std::array<GLfloat, 16> proj_matrix;
+
+    // CALL
+    std::function<void()> fn;
+
+    // BEGIN_OFFSCREEN: draw into the layer's framebuffer, of this size in pixels
+    offscreen_layer::impl *offscreen;
+    int width, height;
+};
+
+std::array<GLfloat, 16> ortho_projection(float x_min, float x_max, float y_min, float y_max)
+{
+    const float a = 2.f / (x_max - x_min);
+    const float b = 2.f / (y_max - y_min);
+
+    const float tx = -(x_max + x_min) / (x_max - x_min);
+    const float ty = -(y_max + y_min) / (y_max - y_min);
+
+    return {a, 0, 0, 0, 0, b, 0, 0, 0, 0, 0, 0, tx, ty, 0, 1};
+}
+
+int area(const scissor_box &b)
+{
+    return b.width * b.height;
+}
+
+scissor_box bounding_box(const scissor_box &a, const scissor_box &b)
+{
+    const int x0 = std::min(a.x, b.x);
+    const int y0 = std::min(a.y, b.y);
+    const int x1 = std::max(a.x + a.width, b.x + b.width);
+    const int y1 = std::max(a.y + a.height, b.y + b.height);
+
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+scissor_box intersection(const scissor_box &a, const scissor_box &b)
+{
+    const int x0 = std::max(a.x, b.x);
+    const int y0 = std::max(a.y, b.y);
+    const int x1 = std::min(a.x + a.width, b.x + b.width);
+    const int y1 = std::min(a.y + a.height, b.y + b.height);
+
+    return {x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0)};
+}
+
+// Every damaged rectangle costs a pass over the frame, so merge the ones
+// whose bounding box isn't larger than the two of them apart (overlapping
+// or adjacent), and then the pairs whose bounding box adds the fewest pixels
+// until no more than max_boxes are left.
+void merge_damage(std::vector<scissor_box> &boxes, size_t max_boxes)
+{
+    while (boxes.size() > 1) {
+        size_t merge_i = 0, merge_j = 1;
+        int min_waste = std::numeric_limits<int>::max();
+
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            for (size_t j = i + 1; j < boxes.size(); ++j) {
+                const int waste = area(bounding_box(boxes[i], boxes[j])) - area(boxes[i]) - area(boxes[j]);
+                if (waste < min_waste) {
+                    min_waste = waste;
+                    merge_i = i;
+                    merge_j = j;
+                }
+            }
+        }
+
+        if (min_waste > 0 && boxes.size() <= max_boxes)
+            break;
+
+        boxes[merge_i] = bounding_box(boxes[merge_i], boxes[merge_j]);
+        boxes.erase(boxes.begin() + merge_j);
+    }
+}
+
+// What a matrix does to a vertex, from cheapest to most general. Tracked as
+// the matrix is built, so that vertices can skip the multiplications by 1
+// and additions of 0 that most UI draws would otherwise pay for.
+enum class transform_class
+{
+    IDENTITY,
+    TRANSLATE,
+    SCALE_TRANSLATE,
+    GENERAL,
+};
+
+struct transform
+{
+    g2d::mat3 matrix = g2d::mat3::identity();
+    transform_class kind = transform_class::IDENTITY;
+
+    void translate(float x, float y);
+    void scale(float sx, float sy);
+    void rotate(float a);
+
+    // same results as g2d::transform_points with the full matrix
+    void apply(const quad &in, quad &out, bool fast_paths) const;
+};
+
+void transform::translate(float x, float y)
+{
+    matrix *= g2d::mat3::translation(x, y);
+    if (kind == transform_class::IDENTITY && (x != 0 || y != 0))
+        kind = transform_class::TRANSLATE;
+}
+
+void transform::scale(float sx, float sy)
+{
+    matrix *= g2d::mat3::scale(sx, sy);
+    if (kind < transform_class::SCALE_TRANSLATE && (sx != 1 || sy != 1))
+        kind = transform_class::SCALE_TRANSLATE;
+}
+
+void transform::rotate(float a)
+{
+    matrix *= g2d::mat3::rotation(a);
+    if (a != 0)
+        kind = transform_class::GENERAL;
+}
+
+void transform::apply(const quad &in, quad &out, bool fast_paths) const
+{
+    switch (fast_paths ? kind : transform_class::GENERAL) {
+        case transform_class::IDENTITY:
+            out = in;
+            break;
+
+        case transform_class::TRANSLATE: {
+            const g2d::vec2 offset(matrix.m02, matrix.m12);
+            out.v00 = in.v00 + offset;
+            out.v01 = in.v01 + offset;
+            out.v10 = in.v10 + offset;
+            out.v11 = in.v11 + offset;
+            break;
+        }
+
+        case transform_class::SCALE_TRANSLATE: {
+            const auto scale_translate = [this](const g2d::vec2 &v) {
+                // separate statements: clang only fuses a multiply and an
+                // add within one expression, and a fused multiply-add would
+                // round differently from the full matrix path
+                const float x = matrix.m00 * v.x;
+                const float y = matrix.m11 * v.y;
+                return g2d::vec2(x + matrix.m02, y + matrix.m12);
+            };
+            out.v00 = scale_translate(in.v00);
+            out.v01 = scale_translate(in.v01);
+            out.v10 = scale_translate(in.v10);
+            out.v11 = scale_translate(in.v11);
+            break;
+        }
+
+        case transform_class::GENERAL:
+            g2d::transform_points(matrix, &in.v00, &out.v00, 4);
+            break;
+    }
+}
+
+} // anonymous namespace
+
+struct command_list::impl
+{
+    std::vector<sprite> sprites;
+    std::vector<command> commands;
+
+    // set_damage() was called: drawn into the kept framebuffer, either in
+    // full or only within the damaged rectangles (in pixels)
+    bool retained;
+    bool full_repaint;
+    std::vector<scissor_box> damage;
+};
+
+command_list::command_list()
+    : impl_(new impl)
+{
+}
+
+command_list::~command_list() = default;
+
+struct offscreen_layer::impl
+{
+    explicit impl(const char *name)
+        : name(name)
+    {
+    }
+
+    std::string name;
+
+    // recording side: contents were recorded for this pixel rectangle and
+    // not invalidated since
+    bool valid = false;
+    int x, y, width, height;
+
+    // GL side, (re)created when the contents are drawn at a new size
+    std::unique_ptr<g2d::framebuffer> framebuffer;
+};
+
+namespace {
+
+// for reload_offscreen_layers()
+std::vector<offscreen_layer::impl *> offscreen_layers;
+
+} // anonymous namespace
+
+offscreen_layer::offscreen_layer(const char *name)
+    : impl_(new impl(name))
+{
+    offscreen_layers.push_back(impl_.get());
+}
+
+offscreen_layer::~offscreen_layer()
+{
+    offscreen_layers.erase(std::find(offscreen_layers.begin(), offscreen_layers.end(), impl_.get()));
+}
+
+void offscreen_layer::invalidate()
+{
+    impl_->valid = false;
+}
+
+namespace {
+
+// Offscreen, the alpha channel has to end up as the layer's coverage and
+// the colors premultiplied by it, so that compositing with PREMULTIPLIED_BLEND
+// gives the same result as drawing the contents on screen directly.
+void gl_set_blend_mode(blend_mode mode, bool offscreen)
 {
     switch (mode) {
         case blend_mode::NO_BLEND:
-            GL_CHECK(glDisable(GL_BLEND));
+            g2d::gl_state::set_blend(false);
             break;
 
         case blend_mode::ALPHA_BLEND:
-            GL_CHECK(glEnable(GL_BLEND));
-            GL_CHECK(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+            g2d::gl_state::set_blend(true);
+            if (offscreen)
+                g2d::gl_state::set_blend_func_separate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                                                       GL_ONE_MINUS_SRC_ALPHA);
+            else
+                g2d::gl_state::set_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             break;
 
         case blend_mode::ADDITIVE_BLEND:
-            GL_CHECK(glEnable(GL_BLEND));
-            GL_CHECK(glBlendFunc(GL_ONE, GL_ONE));
+            g2d::gl_state::set_blend(true);
+            if (offscreen)
+                g2d::gl_state::set_blend_func_separate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE);
+            else
+                g2d::gl_state::set_blend_func(GL_ONE, GL_ONE);
+            break;
+
+        case blend_mode::PREMULTIPLIED_BLEND:
+            g2d::gl_state::set_blend(true);
+            g2d::gl_state::set_blend_func(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
             break;
 
         case blend_mode::INVERSE_BLEND:
-            GL_CHECK(glEnable(GL_BLEND));
-            GL_CHECK(glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_COLOR));
+            g2d::gl_state::set_blend(true);
+            g2d::gl_state::set_blend_func(GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
             break;
     }
 }
 
 void gl_set_scissor_test(bool enabled)
 {
-    if (enabled)
-        GL_CHECK(glEnable(GL_SCISSOR_TEST));
-    else
-        GL_CHECK(glDisable(GL_SCISSOR_TEST));
+    g2d::gl_state::set_scissor_test(enabled);
 }
 
 class sprite_batch : private noncopyable
@@ -56,13 +337,25 @@ class sprite_batch : private noncopyable
 public:
     sprite_batch();
 
+    // recording, on the simulation side
+
+    void begin_frame(command_list &list);
+    void end_frame();
+
     void set_viewport(int x_min, int x_max, int y_min, int y_max);
 
+    void set_damage(const std::vector<box> &damage);
+
     void set_scissor_box(int x, int y, int width, int height);
 
     void begin_batch();
     void end_batch();
 
+    void defer(std::function<void()> fn);
+
+    void draw_offscreen_layer(offscreen_layer &l, const box &bounds, int layer,
+                              const std::function<void()> &draw_contents);
+
     void push_matrix();
     void pop_matrix();
 
@@ -70,6 +363,8 @@ public:
     void scale(float sx, float sy);
     void rotate(float a);
 
+    void set_transform_fast_paths(bool enabled);
+
     void set_blend_mode(blend_mode mode);
     void set_scissor_test(bool enabled);
     void set_color(const g2d::rgba &color);
@@ -89,54 +384,88 @@ public:
                   const g2d::rgba &top_outline_color, const g2d::rgba &top_text_color,
                   const g2d::rgba &bottom_outline_color, const g2d::rgba &bottom_text_color,
                   const wchar_t *str);
+    void add_text(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos, int layer);
+    void add_text(const text_layout &layout, const g2d::vec2 &pos, int layer, const vert_colors &outline_colors,
+                  const vert_colors &text_colors);
+
+    // playback, on the thread that owns the GL context
+
+    void submit(const command_list &list);
+
+    void set_show_damage(bool enabled);
 
 private:
-    struct sprite
-    {
-        int layer;
-        const g2d::program *program;
-        const g2d::texture *texture;
-        int num_vert_colors; // for now always 1 or 2
-        quad verts;
-        quad texcoords;
-        vert_colors colors[2];
-        blend_mode blend;
-        bool scissor_test;
-    };
+    sprite &add_sprite();
+
+    scissor_box pixel_bounds(const g2d::vec2 &p0, const g2d::vec2 &p1) const;
+
+    void record_offscreen_layer(offscreen_layer::impl *l, const std::function<void()> &draw_contents);
+
+    void play(const command_list::impl &list, bool draw_offscreen);
+    void set_projection(const std::array<GLfloat, 16> &proj_matrix);
+
+    void begin_offscreen(offscreen_layer::impl *l, int width, int height);
+    void end_offscreen();
+
+    void clear_retained(const scissor_box &b) const;
+    void composite_retained(bool full_repaint, const std::vector<scissor_box> &damage);
+    box unproject(const scissor_box &b) const;
+    void apply_scissor_test(bool enabled, const scissor_box &scissor) const;
+
+    void add_glyphs(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos, int layer,
+                    const vert_colors &colors0, const vert_colors &colors1, int num_vert_colors);
 
     void init_vbos();
     void init_vaos();
+    void init_frame_uniforms();
 
-    void flush_queue();
+    void draw_sprites(const sprite *sprites, int num_sprites, const scissor_box &scissor);
     void render_sprites_texture(const sprite *const *sprites, int num_sprites) const;
     void render_sprites_texture_2c(const sprite *const *sprites, int num_sprites) const;
     void render_sprites_flat(const sprite *const *sprites, int num_sprites) const;
 
-    struct scissor_box
-    {
-        int x, y;
-        int width, height;
-    };
-    scissor_box scissor_box_;
-
+    // sprites per draw call, sizes the vertex and index buffers
     static constexpr int SPRITE_QUEUE_CAPACITY = 1024;
 
-    int sprite_queue_size_;
-    sprite sprite_queue_[SPRITE_QUEUE_CAPACITY];
+    // recording state
+
+    command_list::impl *list_;
+    int batch_start_; // first sprite not yet in a DRAW_SPRITES command
+    scissor_box scissor_box_;
+    std::array<float, 4> projection_; // x_min, x_max, y_min, y_max of the last set_viewport()
+    bool recording_offscreen_;
 
     blend_mode blend_mode_;
     bool scissor_test_;
     g2d::rgba color_;
-    g2d::mat3 matrix_;
+    transform transform_;
     text_align text_align_;
-    std::stack<g2d::mat3> matrix_stack_;
+    std::stack<transform> transform_stack_;
+    bool transform_fast_paths_;
+
+    // The frame kept for set_damage(), as a layer the size of the screen.
+    // Recording side, valid if the last frame recorded will be in it once
+    // submitted; GL side, the framebuffer.
+    offscreen_layer retained_;
+
+    // playback state
+
+    std::vector<const sprite *> sorted_sprites_;
+    bool drawing_offscreen_;
+    std::array<GLint, 4> screen_viewport_; // to go back to after drawing offscreen
+    bool drawing_retained_;
+    const scissor_box *damage_clip_; // the damaged rectangle being redrawn, if any
+    bool show_damage_;
+    std::vector<sprite> composite_sprites_;
 
     const g2d::program *program_texture_;
     const g2d::program *program_flat_;
+    const g2d::program *program_text_;
     const g2d::program *program_text_outline_;
 
     g2d::gl_buffer vertex_buffer_;
     g2d::gl_buffer index_buffer_;
+    g2d::gl_buffer frame_uniforms_;
 
     GLuint vao_flat_;
     GLuint vao_texture_;
@@ -146,32 +475,85 @@ private:
 } *g_sprite_batch;
 
 sprite_batch::sprite_batch()
-    : vertex_buffer_{GL_ARRAY_BUFFER}
-    , index_buffer_{GL_ELEMENT_ARRAY_BUFFER}
+    : list_{nullptr}
+    , recording_offscreen_{false}
+    , transform_fast_paths_{true}
+    , retained_{"screen"}
+    , drawing_offscreen_{false}
+    , drawing_retained_{false}
+    , damage_clip_{nullptr}
+    , show_damage_{false}
     , program_texture_{get_program(program::sprite_2d)}
     , program_flat_{get_program(program::flat)}
+    , program_text_{get_program(program::text)}
     , program_text_outline_{get_program(program::text_gradient)}
+    , vertex_buffer_{GL_ARRAY_BUFFER}
+    , index_buffer_{GL_ELEMENT_ARRAY_BUFFER}
+    , frame_uniforms_{GL_UNIFORM_BUFFER}
 {
     init_vbos();
     init_vaos();
+    init_frame_uniforms();
 }
 
 void sprite_batch::set_viewport(int x_min, int x_max, int y_min, int y_max)
 {
-    const float a = 2.f / (x_max - x_min);
-    const float b = 2.f / (y_max - y_min);
+    assert(list_);
 
-    const float tx = -(x_max + x_min) / (x_max - x_min);
-    const float ty = -(y_max + y_min) / (y_max - y_min);
+    projection_ = {static_cast<float>(x_min), static_cast<float>(x_max), static_cast<float>(y_min),
+                   static_cast<float>(y_max)};
+
+    command c;
+    c.kind = command::type::SET_PROJECTION;
+    c.proj_matrix = ortho_projection(x_min, x_max, y_min, y_max);
+    list_->commands.push_back(std::move(c));
+}
 
-    proj_matrix_ = {a, 0, 0, 0, 0, b, 0, 0, 0, 0, 0, 0, tx, ty, 0, 1};
+void sprite_batch::set_damage(const std::vector<box> &damage)
+{
+    assert(list_);
+
+    // passes over the frame; past this, merged rectangles usually cover
+    // enough of the screen to redraw all of it
+    static constexpr size_t MAX_DAMAGE_BOXES = 16;
+
+    list_->retained = true;
+    list_->full_repaint = !retained_.get_impl()->valid;
 
-    program_texture_->use();
-    program_texture_->set_uniform_matrix4("proj_modelview", &proj_matrix_[0]);
-    program_texture_->set_uniform_i("tex", 0);
+    auto &boxes = list_->damage;
+    boxes.clear();
+
+    const scissor_box screen = {0, 0, viewport_width, viewport_height};
+
+    for (const auto &b : damage) {
+        const auto r = intersection(pixel_bounds(b.v0, b.v1), screen);
+        if (r.width > 0 && r.height > 0)
+            boxes.push_back(r);
+    }
 
-    program_flat_->use();
-    program_flat_->set_uniform_matrix4("proj_modelview", &proj_matrix_[0]);
+    merge_damage(boxes, MAX_DAMAGE_BOXES);
+
+    int damaged_area = 0;
+    for (const auto &b : boxes)
+        damaged_area += area(b);
+
+    if (2 * damaged_area > area(screen))
+        list_->full_repaint = true;
+}
+
+// the pixels touched by the axis-aligned rectangle with corners p0 and p1,
+// in the coordinates of the last set_viewport()
+scissor_box sprite_batch::pixel_bounds(const g2d::vec2 &p0, const g2d::vec2 &p1) const
+{
+    const float sx = viewport_width / (projection_[1] - projection_[0]);
+    const float sy = viewport_height / (projection_[3] - projection_[2]);
+
+    const int x0 = std::floor((std::min(p0.x, p1.x) - projection_[0]) * sx);
+    const int x1 = std::ceil((std::max(p0.x, p1.x) - projection_[0]) * sx);
+    const int y0 = std::floor((std::min(p0.y, p1.y) - projection_[2]) * sy);
+    const int y1 = std::ceil((std::max(p0.y, p1.y) - projection_[2]) * sy);
+
+    return {x0, y0, x1 - x0, y1 - y0};
 }
 
 void sprite_batch::set_scissor_box(int x, int y, int width, int height)
@@ -182,48 +564,219 @@ void sprite_batch::set_scissor_box(int x, int y, int width, int height)
     scissor_box_.height = height;
 }
 
+void sprite_batch::begin_frame(command_list &list)
+{
+    list_ = list.get_impl();
+    list_->sprites.clear();
+    list_->commands.clear();
+    list_->retained = false;
+    list_->full_repaint = false;
+    list_->damage.clear();
+    batch_start_ = 0;
+}
+
+void sprite_batch::end_frame()
+{
+    assert(batch_start_ == static_cast<int>(list_->sprites.size()));
+
+    // the next frame's damage is relative to this one
+    retained_.get_impl()->valid = list_->retained;
+
+    list_ = nullptr;
+}
+
 void sprite_batch::begin_batch()
 {
-    sprite_queue_size_ = 0;
+    assert(list_);
+    batch_start_ = list_->sprites.size();
     blend_mode_ = blend_mode::NO_BLEND;
     color_ = {1, 1, 1, 1};
     text_align_ = text_align::LEFT;
-    matrix_ = g2d::mat3::identity();
-    matrix_stack_ = std::stack<g2d::mat3>();
+    transform_ = transform();
+    transform_stack_ = std::stack<transform>();
     scissor_test_ = false;
     set_scissor_box(-1, -1, 0, 0);
 }
 
 void sprite_batch::end_batch()
 {
-    flush_queue();
+    assert(list_);
+    assert(!recording_offscreen_);
+
+    const int num_sprites = static_cast<int>(list_->sprites.size()) - batch_start_;
+    if (num_sprites == 0)
+        return;
+
+    command c;
+    c.kind = command::type::DRAW_SPRITES;
+    c.first_sprite = batch_start_;
+    c.num_sprites = num_sprites;
+    c.scissor = scissor_box_;
+    list_->commands.push_back(std::move(c));
+
+    batch_start_ = list_->sprites.size();
+}
+
+void sprite_batch::defer(std::function<void()> fn)
+{
+    assert(list_);
+
+    command c;
+    c.kind = command::type::CALL;
+    c.fn = std::move(fn);
+    list_->commands.push_back(std::move(c));
+}
+
+void sprite_batch::draw_offscreen_layer(offscreen_layer &l, const box &bounds, int layer,
+                                        const std::function<void()> &draw_contents)
+{
+    assert(list_);
+    assert(!recording_offscreen_);
+    assert(transform_.kind != transform_class::GENERAL);
+
+    // snap the bounds outwards to whole pixels, so that the layer's pixels
+    // line up with the screen's
+    const auto pixels = pixel_bounds(transform_.matrix * bounds.v0, transform_.matrix * bounds.v1);
+
+    if (pixels.width <= 0 || pixels.height <= 0)
+        return;
+
+    const int x0 = pixels.x;
+    const int x1 = pixels.x + pixels.width;
+    const int y0 = pixels.y;
+    const int y1 = pixels.y + pixels.height;
+
+    auto *impl = l.get_impl();
+
+    if (!impl->valid || impl->x != x0 || impl->y != y0 || impl->width != x1 - x0 || impl->height != y1 - y0) {
+        impl->valid = true;
+        impl->x = x0;
+        impl->y = y0;
+        impl->width = x1 - x0;
+        impl->height = y1 - y0;
+
+        record_offscreen_layer(impl, draw_contents);
+    }
+
+    // composite it, in the current projection's coordinates
+    const float sx = viewport_width / (projection_[1] - projection_[0]);
+    const float sy = viewport_height / (projection_[3] - projection_[2]);
+
+    const float u0 = projection_[0] + x0 / sx;
+    const float u1 = projection_[0] + x1 / sx;
+    const float v0 = projection_[2] + y0 / sy;
+    const float v1 = projection_[2] + y1 / sy;
+
+    auto &s = add_sprite();
+
+    s.program = program_texture_;
+    s.texture = nullptr;
+    s.offscreen = impl;
+
+    s.verts = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+    s.texcoords = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+    s.layer = layer;
+    s.blend = blend_mode::PREMULTIPLIED_BLEND;
+    s.scissor_test = scissor_test_;
+
+    s.num_vert_colors = 1;
+    s.colors[0] = {{1, 1, 1, 1}, {1, 1, 1, 1}, {1, 1, 1, 1}, {1, 1, 1, 1}};
+}
+
+void sprite_batch::record_offscreen_layer(offscreen_layer::impl *l, const std::function<void()> &draw_contents)
+{
+    const int contents_start = list_->sprites.size();
+
+    command begin;
+    begin.kind = command::type::BEGIN_OFFSCREEN;
+    begin.offscreen = l;
+    begin.width = l->width;
+    begin.height = l->height;
+    list_->commands.push_back(std::move(begin));
+
+    // map the layer's rectangle onto its whole framebuffer
+    const float sx = viewport_width / (projection_[1] - projection_[0]);
+    const float sy = viewport_height / (projection_[3] - projection_[2]);
+
+    command projection;
+    projection.kind = command::type::SET_PROJECTION;
+    projection.proj_matrix = ortho_projection(projection_[0] + l->x / sx, projection_[0] + (l->x + l->width) / sx,
+                                              projection_[2] + l->y / sy, projection_[2] + (l->y + l->height) / sy);
+    list_->commands.push_back(std::move(projection));
+
+    const auto saved_blend_mode = blend_mode_;
+    const auto saved_color = color_;
+    const auto saved_scissor_test = scissor_test_;
+    scissor_test_ = false;
+
+    recording_offscreen_ = true;
+    draw_contents();
+    recording_offscreen_ = false;
+
+    blend_mode_ = saved_blend_mode;
+    color_ = saved_color;
+    scissor_test_ = saved_scissor_test;
+
+    // The sprites recorded before the layer belong to the batch it's
+    // composited in, which is drawn after it; move the contents in front of
+    // them so they are a range of their own.
+    auto &sprites = list_->sprites;
+    const int num_contents = static_cast<int>(sprites.size()) - contents_start;
+
+    if (num_contents > 0) {
+        std::rotate(sprites.begin() + batch_start_, sprites.begin() + contents_start, sprites.end());
+
+        command draw;
+        draw.kind = command::type::DRAW_SPRITES;
+        draw.first_sprite = batch_start_;
+        draw.num_sprites = num_contents;
+        draw.scissor = {-1, -1, 0, 0};
+        list_->commands.push_back(std::move(draw));
+
+        batch_start_ += num_contents;
+    }
+
+    command end;
+    end.kind = command::type::END_OFFSCREEN;
+    list_->commands.push_back(std::move(end));
+
+    command restore;
+    restore.kind = command::type::SET_PROJECTION;
+    restore.proj_matrix = ortho_projection(projection_[0], projection_[1], projection_[2], projection_[3]);
+    list_->commands.push_back(std::move(restore));
 }
 
 void sprite_batch::push_matrix()
 {
-    matrix_stack_.push(matrix_);
+    transform_stack_.push(transform_);
 }
 
 void sprite_batch::pop_matrix()
 {
-    assert(!matrix_stack_.empty());
-    matrix_ = matrix_stack_.top();
-    matrix_stack_.pop();
+    assert(!transform_stack_.empty());
+    transform_ = transform_stack_.top();
+    transform_stack_.pop();
 }
 
 void sprite_batch::translate(float x, float y)
 {
-    matrix_ *= g2d::mat3::translation(x, y);
+    transform_.translate(x, y);
 }
 
 void sprite_batch::scale(float sx, float sy)
 {
-    matrix_ *= g2d::mat3::scale(sx, sy);
+    transform_.scale(sx, sy);
 }
 
 void sprite_batch::rotate(float a)
 {
-    matrix_ *= g2d::mat3::rotation(a);
+    transform_.rotate(a);
+}
+
+void sprite_batch::set_transform_fast_paths(bool enabled)
+{
+    transform_fast_paths_ = enabled;
 }
 
 void sprite_batch::set_blend_mode(blend_mode mode)
@@ -241,21 +794,23 @@ void sprite_batch::set_color(const g2d::rgba &color)
     color_ = color;
 }
 
+sprite &sprite_batch::add_sprite()
+{
+    assert(list_);
+    list_->sprites.emplace_back();
+    return list_->sprites.back();
+}
+
 void sprite_batch::add_quad(const g2d::program *program, const g2d::texture *texture, const quad &verts,
                             const quad &texcoords, const vert_colors &colors0, const vert_colors &colors1, int layer)
 {
-    if (sprite_queue_size_ == SPRITE_QUEUE_CAPACITY)
-        flush_queue();
-
-    auto &s = sprite_queue_[sprite_queue_size_++];
+    auto &s = add_sprite();
 
     s.program = program;
     s.texture = texture;
+    s.offscreen = nullptr;
 
-    s.verts.v00 = matrix_ * verts.v00;
-    s.verts.v01 = matrix_ * verts.v01;
-    s.verts.v10 = matrix_ * verts.v10;
-    s.verts.v11 = matrix_ * verts.v11;
+    transform_.apply(verts, s.verts, transform_fast_paths_);
 
     s.texcoords = texcoords;
 
@@ -271,18 +826,13 @@ void sprite_batch::add_quad(const g2d::program *program, const g2d::texture *tex
 void sprite_batch::add_quad(const g2d::program *program, const g2d::texture *texture, const quad &verts,
                             const quad &texcoords, const vert_colors &colors, int layer)
 {
-    if (sprite_queue_size_ == SPRITE_QUEUE_CAPACITY)
-        flush_queue();
-
-    auto &s = sprite_queue_[sprite_queue_size_++];
+    auto &s = add_sprite();
 
     s.program = program;
     s.texture = texture;
+    s.offscreen = nullptr;
 
-    s.verts.v00 = matrix_ * verts.v00;
-    s.verts.v01 = matrix_ * verts.v01;
-    s.verts.v10 = matrix_ * verts.v10;
-    s.verts.v11 = matrix_ * verts.v11;
+    transform_.apply(verts, s.verts, transform_fast_paths_);
 
     s.texcoords = texcoords;
 
@@ -316,6 +866,9 @@ void sprite_batch::add_text(const g2d::program *program, const g2d::font *font,
 
     const auto texture = font->get_texture();
 
+    if (!program)
+        program = program_text_;
+
     for (const wchar_t *p = str; *p; ++p) {
         const auto g = font->find_glyph(*p);
 
@@ -391,6 +944,48 @@ void sprite_batch::add_text(const g2d::font *font, const g2d::vec2 &pos, int lay
     }
 }
 
+void sprite_batch::add_text(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos, int layer)
+{
+    add_glyphs(program ? program : program_text_, layout, pos, layer, {color_, color_, color_, color_}, {}, 1);
+}
+
+void sprite_batch::add_text(const text_layout &layout, const g2d::vec2 &pos, int layer,
+                            const vert_colors &outline_colors, const vert_colors &text_colors)
+{
+    add_glyphs(program_text_outline_, layout, pos, layer, outline_colors, text_colors, 2);
+}
+
+void sprite_batch::add_glyphs(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos,
+                              int layer, const vert_colors &colors0, const vert_colors &colors1,
+                              int num_vert_colors)
+{
+    const auto texture = layout.get_texture();
+    const auto &glyphs = layout.get_glyphs();
+
+    auto t = transform_;
+    t.translate(pos.x, pos.y);
+
+    for (const auto &glyph : glyphs) {
+        auto &s = add_sprite();
+
+        s.program = program;
+        s.texture = texture;
+        s.offscreen = nullptr;
+
+        t.apply(glyph.verts, s.verts, transform_fast_paths_);
+
+        s.texcoords = glyph.texcoords;
+
+        s.layer = layer;
+        s.blend = blend_mode_;
+        s.scissor_test = scissor_test_;
+
+        s.num_vert_colors = num_vert_colors;
+        s.colors[0] = colors0;
+        s.colors[1] = colors1;
+    }
+}
+
 void sprite_batch::init_vbos()
 {
     vertex_buffer_.bind();
@@ -427,14 +1022,14 @@ void sprite_batch::init_vaos()
     };
 
     GL_CHECK(glGenVertexArrays(1, &vao_flat_));
-    GL_CHECK(glBindVertexArray(vao_flat_));
+    g2d::gl_state::bind_vertex_array(vao_flat_);
     vertex_buffer_.bind();
     enable_vertex_attrib_array(0, 2, 6 * sizeof(GLfloat), 0);
     enable_vertex_attrib_array(1, 4, 6 * sizeof(GLfloat), 2);
     vertex_buffer_.unbind();
 
     GL_CHECK(glGenVertexArrays(1, &vao_texture_));
-    GL_CHECK(glBindVertexArray(vao_texture_));
+    g2d::gl_state::bind_vertex_array(vao_texture_);
     vertex_buffer_.bind();
     enable_vertex_attrib_array(0, 2, 8 * sizeof(GLfloat), 0);
     enable_vertex_attrib_array(1, 2, 8 * sizeof(GLfloat), 2);
@@ -442,7 +1037,7 @@ void sprite_batch::init_vaos()
     vertex_buffer_.unbind();
 
     GL_CHECK(glGenVertexArrays(1, &vao_texture_2c_));
-    GL_CHECK(glBindVertexArray(vao_texture_2c_));
+    g2d::gl_state::bind_vertex_array(vao_texture_2c_);
     vertex_buffer_.bind();
     enable_vertex_attrib_array(0, 2, 12 * sizeof(GLfloat), 0);
     enable_vertex_attrib_array(1, 2, 12 * sizeof(GLfloat), 2);
@@ -451,30 +1046,294 @@ void sprite_batch::init_vaos()
     vertex_buffer_.unbind();
 }
 
-void sprite_batch::flush_queue()
+void sprite_batch::init_frame_uniforms()
+{
+    frame_uniforms_.bind();
+    frame_uniforms_.buffer_data(sizeof(proj_matrix_), nullptr, GL_DYNAMIC_DRAW);
+    frame_uniforms_.bind_base(FRAME_UNIFORMS_BINDING);
+    frame_uniforms_.unbind();
+}
+
+void sprite_batch::submit(const command_list &list)
+{
+    const auto *l = list.get_impl();
+
+    if (!l->retained) {
+        play(*l, true);
+        return;
+    }
+
+    auto &fb = retained_.get_impl()->framebuffer;
+    bool full_repaint = l->full_repaint;
+
+    if (!fb || fb->get_width() != viewport_width || fb->get_height() != viewport_height) {
+        log_debug("kept frame: %dx%d", viewport_width, viewport_height);
+        fb.reset(new g2d::framebuffer(viewport_width, viewport_height));
+        full_repaint = true;
+    }
+
+    fb->bind();
+    drawing_retained_ = true;
+
+    if (full_repaint) {
+        clear_retained({0, 0, viewport_width, viewport_height});
+        play(*l, true);
+    } else if (l->damage.empty()) {
+        // nothing on screen to redraw, but the offscreen layers recorded in
+        // the frame still have to be
+        const scissor_box none = {0, 0, 0, 0};
+        damage_clip_ = &none;
+        play(*l, true);
+    } else {
+        for (size_t i = 0; i < l->damage.size(); ++i) {
+            damage_clip_ = &l->damage[i];
+            clear_retained(*damage_clip_);
+            play(*l, i == 0);
+        }
+    }
+
+    damage_clip_ = nullptr;
+    drawing_retained_ = false;
+    g2d::framebuffer::unbind();
+
+    composite_retained(full_repaint, l->damage);
+}
+
+void sprite_batch::set_show_damage(bool enabled)
+{
+    show_damage_ = enabled;
+}
+
+// draw_offscreen is false to skip the offscreen layers' contents, drawn
+// already in an earlier pass over the same list
+void sprite_batch::play(const command_list::impl &list, bool draw_offscreen)
+{
+    bool skipping = false;
+
+    for (const auto &c : list.commands) {
+        if (skipping) {
+            if (c.kind == command::type::END_OFFSCREEN)
+                skipping = false;
+            continue;
+        }
+
+        switch (c.kind) {
+            case command::type::DRAW_SPRITES:
+                draw_sprites(&list.sprites[c.first_sprite], c.num_sprites, c.scissor);
+                break;
+
+            case command::type::SET_PROJECTION:
+                set_projection(c.proj_matrix);
+                break;
+
+            case command::type::CALL:
+                c.fn();
+                break;
+
+            case command::type::BEGIN_OFFSCREEN:
+                if (draw_offscreen)
+                    begin_offscreen(c.offscreen, c.width, c.height);
+                else
+                    skipping = true;
+                break;
+
+            case command::type::END_OFFSCREEN:
+                end_offscreen();
+                break;
+        }
+    }
+}
+
+void sprite_batch::set_projection(const std::array<GLfloat, 16> &proj_matrix)
+{
+    proj_matrix_ = proj_matrix;
+
+    // seen by every program through the frame_uniforms block
+    frame_uniforms_.bind();
+    frame_uniforms_.buffer_sub_data(0, sizeof(proj_matrix_), &proj_matrix_[0]);
+    frame_uniforms_.unbind();
+}
+
+void sprite_batch::begin_offscreen(offscreen_layer::impl *l, int width, int height)
+{
+    auto &fb = l->framebuffer;
+
+    if (!fb || fb->get_width() != width || fb->get_height() != height) {
+        log_debug("offscreen layer %s: %dx%d", l->name.c_str(), width, height);
+        fb.reset(new g2d::framebuffer(width, height));
+    }
+
+    g2d::gl_state::get_viewport(screen_viewport_[0], screen_viewport_[1], screen_viewport_[2], screen_viewport_[3]);
+
+    fb->bind();
+    g2d::gl_state::set_viewport(0, 0, width, height);
+
+    g2d::gl_state::set_scissor_test(false);
+    GL_CHECK(glClearColor(0, 0, 0, 0));
+    GL_CHECK(glClear(GL_COLOR_BUFFER_BIT));
+
+    drawing_offscreen_ = true;
+}
+
+void sprite_batch::end_offscreen()
+{
+    if (drawing_retained_)
+        retained_.get_impl()->framebuffer->bind();
+    else
+        g2d::framebuffer::unbind();
+
+    g2d::gl_state::set_viewport(screen_viewport_[0], screen_viewport_[1], screen_viewport_[2], screen_viewport_[3]);
+
+    drawing_offscreen_ = false;
+}
+
+// Nothing is drawn under the background on screen either, but whatever was
+// in a damaged rectangle mustn't show through what's drawn over it again.
+void sprite_batch::clear_retained(const scissor_box &b) const
+{
+    g2d::gl_state::set_scissor(b.x, b.y, b.width, b.height);
+    g2d::gl_state::set_scissor_test(true);
+
+    GL_CHECK(glClearColor(0, 0, 0, 1));
+    GL_CHECK(glClear(GL_COLOR_BUFFER_BIT));
+}
+
+void sprite_batch::composite_retained(bool full_repaint, const std::vector<scissor_box> &damage)
+{
+    const float width = viewport_width;
+    const float height = viewport_height;
+
+    set_projection(ortho_projection(0, width, 0, height));
+
+    auto &sprites = composite_sprites_;
+    sprites.clear();
+
+    const auto add_box = [&sprites](const scissor_box &b, const g2d::rgba &color, blend_mode blend, int layer) {
+        const float x0 = b.x;
+        const float x1 = b.x + b.width;
+        const float y0 = b.y;
+        const float y1 = b.y + b.height;
+
+        sprites.emplace_back();
+        auto &s = sprites.back();
+
+        s.program = nullptr;
+        s.texture = nullptr;
+        s.offscreen = nullptr;
+
+        s.verts = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+        s.texcoords = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+        s.layer = layer;
+        s.blend = blend;
+        s.scissor_test = false;
+
+        s.num_vert_colors = 1;
+        s.colors[0] = {color, color, color, color};
+
+        return &s;
+    };
+
+    const scissor_box screen = {0, 0, viewport_width, viewport_height};
+
+    auto *frame = add_box(screen, {1, 1, 1, 1}, blend_mode::NO_BLEND, 0);
+    frame->program = program_texture_;
+    frame->offscreen = retained_.get_impl();
+
+    if (show_damage_) {
+        if (full_repaint) {
+            add_box(screen, {1, 0, 0, .25}, blend_mode::ALPHA_BLEND, 1);
+        } else {
+            for (const auto &b : damage)
+                add_box(b, {0, 1, 0, .25}, blend_mode::ALPHA_BLEND, 1);
+        }
+    }
+
+    draw_sprites(sprites.data(), static_cast<int>(sprites.size()), {-1, -1, 0, 0});
+}
+
+// b in the coordinates of the current projection
+box sprite_batch::unproject(const scissor_box &b) const
 {
-    if (sprite_queue_size_ == 0)
+    const auto unproject_x = [this](int x) {
+        return (2.f * x / viewport_width - 1.f - proj_matrix_[12]) / proj_matrix_[0];
+    };
+
+    const auto unproject_y = [this](int y) {
+        return (2.f * y / viewport_height - 1.f - proj_matrix_[13]) / proj_matrix_[5];
+    };
+
+    return {{unproject_x(b.x), unproject_y(b.y)}, {unproject_x(b.x + b.width), unproject_y(b.y + b.height)}};
+}
+
+// Within a damaged rectangle, the scissor test stays enabled to keep the
+// redraw inside it, and a sprite's own scissor box is narrowed down to it.
+void sprite_batch::apply_scissor_test(bool enabled, const scissor_box &scissor) const
+{
+    if (!damage_clip_ || drawing_offscreen_) {
+        gl_set_scissor_test(enabled);
         return;
+    }
+
+    const auto b = enabled && scissor.x != -1 ? intersection(*damage_clip_, scissor) : *damage_clip_;
+
+    g2d::gl_state::set_scissor(b.x, b.y, b.width, b.height);
+    g2d::gl_state::set_scissor_test(true);
+}
+
+void sprite_batch::draw_sprites(const sprite *sprites, int num_sprites, const scissor_box &scissor)
+{
+    sorted_sprites_.clear();
+
+    if (damage_clip_ && !drawing_offscreen_) {
+        // redrawing a damaged rectangle, leave out what's outside of it
+        if (damage_clip_->width == 0 || damage_clip_->height == 0)
+            return;
+
+        const auto clip = unproject(*damage_clip_);
+
+        const float clip_x0 = std::min(clip.v0.x, clip.v1.x);
+        const float clip_x1 = std::max(clip.v0.x, clip.v1.x);
+        const float clip_y0 = std::min(clip.v0.y, clip.v1.y);
+        const float clip_y1 = std::max(clip.v0.y, clip.v1.y);
 
-    static const sprite *sorted_sprites[SPRITE_QUEUE_CAPACITY];
+        for (int i = 0; i < num_sprites; ++i) {
+            const auto &v = sprites[i].verts;
 
-    for (int i = 0; i < sprite_queue_size_; ++i)
-        sorted_sprites[i] = &sprite_queue_[i];
+            const float x0 = std::min({v.v00.x, v.v01.x, v.v10.x, v.v11.x});
+            const float x1 = std::max({v.v00.x, v.v01.x, v.v10.x, v.v11.x});
+            const float y0 = std::min({v.v00.y, v.v01.y, v.v10.y, v.v11.y});
+            const float y1 = std::max({v.v00.y, v.v01.y, v.v10.y, v.v11.y});
 
-    std::stable_sort(&sorted_sprites[0], &sorted_sprites[sprite_queue_size_], [](const auto *s0, const auto *s1) {
-        return std::tie(s0->layer, s0->blend, s0->scissor_test, s0->program, s0->texture) <
-               std::tie(s1->layer, s1->blend, s1->scissor_test, s1->program, s1->texture);
+            if (x1 >= clip_x0 && x0 <= clip_x1 && y1 >= clip_y0 && y0 <= clip_y1)
+                sorted_sprites_.push_back(&sprites[i]);
+        }
+
+        num_sprites = static_cast<int>(sorted_sprites_.size());
+        if (num_sprites == 0)
+            return;
+    } else {
+        sorted_sprites_.resize(num_sprites);
+
+        for (int i = 0; i < num_sprites; ++i)
+            sorted_sprites_[i] = &sprites[i];
+    }
+
+    auto &sorted_sprites = sorted_sprites_;
+
+    std::stable_sort(sorted_sprites.begin(), sorted_sprites.end(), [](const auto *s0, const auto *s1) {
+        return std::tie(s0->layer, s0->blend, s0->scissor_test, s0->program, s0->texture, s0->offscreen) <
+               std::tie(s1->layer, s1->blend, s1->scissor_test, s1->program, s1->texture, s1->offscreen);
     });
 
-    const auto bind_texture = [this](auto *program, auto *texture) {
+    const auto bind_texture = [this](auto *program, auto *texture, auto *offscreen) {
         if (texture)
             texture->bind();
+        else if (offscreen)
+            offscreen->framebuffer->bind_texture();
 
         if (program != nullptr) {
             program->use();
-            program->set_uniform_matrix4("proj_modelview", &proj_matrix_[0]);
-            if (texture)
-                program->set_uniform_i("tex", 0);
         } else {
             if (texture != nullptr)
                 program_texture_->use();
@@ -485,21 +1344,22 @@ void sprite_batch::flush_queue()
 
     auto cur_program = sorted_sprites[0]->program;
     auto cur_texture = sorted_sprites[0]->texture;
+    auto cur_offscreen = sorted_sprites[0]->offscreen;
     auto cur_blend_mode = sorted_sprites[0]->blend;
     auto cur_num_vert_colors = sorted_sprites[0]->num_vert_colors;
     auto cur_scissor_test = sorted_sprites[0]->scissor_test;
 
-    if (scissor_box_.x != -1)
-        GL_CHECK(glScissor(scissor_box_.x, scissor_box_.y, scissor_box_.width, scissor_box_.height));
+    if (scissor.x != -1)
+        g2d::gl_state::set_scissor(scissor.x, scissor.y, scissor.width, scissor.height);
 
-    bind_texture(cur_program, cur_texture);
-    gl_set_blend_mode(cur_blend_mode);
-    gl_set_scissor_test(cur_scissor_test);
+    bind_texture(cur_program, cur_texture, cur_offscreen);
+    gl_set_blend_mode(cur_blend_mode, drawing_offscreen_);
+    apply_scissor_test(cur_scissor_test, scissor);
 
     int batch_start = 0;
 
     const auto render_sprites = [&](int batch_end) {
-        if (cur_texture) {
+        if (cur_texture || cur_offscreen) {
             if (cur_num_vert_colors == 1)
                 render_sprites_texture(&sorted_sprites[batch_start], batch_end - batch_start);
             else
@@ -509,38 +1369,38 @@ void sprite_batch::flush_queue()
         }
     };
 
-    for (int i = 1; i < sprite_queue_size_; ++i) {
+    for (int i = 1; i < num_sprites; ++i) {
         const auto p = sorted_sprites[i];
 
         if (p->blend != cur_blend_mode || p->scissor_test != cur_scissor_test || p->texture != cur_texture ||
-            p->program != cur_program || p->num_vert_colors != cur_num_vert_colors) {
+            p->offscreen != cur_offscreen || p->program != cur_program ||
+            p->num_vert_colors != cur_num_vert_colors || i - batch_start == SPRITE_QUEUE_CAPACITY) {
             render_sprites(i);
 
             batch_start = i;
 
-            if (p->texture != cur_texture || p->program != cur_program) {
+            if (p->texture != cur_texture || p->offscreen != cur_offscreen || p->program != cur_program) {
                 cur_texture = p->texture;
+                cur_offscreen = p->offscreen;
                 cur_program = p->program;
-                bind_texture(cur_program, cur_texture);
+                bind_texture(cur_program, cur_texture, cur_offscreen);
             }
 
             if (p->blend != cur_blend_mode) {
                 cur_blend_mode = p->blend;
-                gl_set_blend_mode(cur_blend_mode);
+                gl_set_blend_mode(cur_blend_mode, drawing_offscreen_);
             }
 
             if (p->scissor_test != cur_scissor_test) {
                 cur_scissor_test = p->scissor_test;
-                gl_set_scissor_test(cur_scissor_test);
+                apply_scissor_test(cur_scissor_test, scissor);
             }
 
             cur_num_vert_colors = p->num_vert_colors;
         }
     }
 
-    render_sprites(sprite_queue_size_);
-
-    sprite_queue_size_ = 0;
+    render_sprites(num_sprites);
 }
 
 void sprite_batch::render_sprites_texture(const sprite *const *sprites, int num_sprites) const
@@ -573,7 +1433,7 @@ void sprite_batch::render_sprites_texture(const sprite *const *sprites, int num_
 
     vertex_buffer_.unmap();
 
-    GL_CHECK(glBindVertexArray(vao_texture_));
+    g2d::gl_state::bind_vertex_array(vao_texture_);
     index_buffer_.bind();
     GL_CHECK(glDrawElements(GL_TRIANGLES, 6 * num_sprites, GL_UNSIGNED_SHORT, 0));
 }
@@ -613,7 +1473,7 @@ void sprite_batch::render_sprites_texture_2c(const sprite *const *sprites, int n
 
     vertex_buffer_.unmap();
 
-    GL_CHECK(glBindVertexArray(vao_texture_2c_));
+    g2d::gl_state::bind_vertex_array(vao_texture_2c_);
     index_buffer_.bind();
     GL_CHECK(glDrawElements(GL_TRIANGLES, 6 * num_sprites, GL_UNSIGNED_SHORT, 0));
 }
@@ -645,23 +1505,87 @@ void sprite_batch::render_sprites_flat(const sprite *const *sprites, int num_spr
 
     vertex_buffer_.unmap();
 
-    GL_CHECK(glBindVertexArray(vao_flat_));
+    g2d::gl_state::bind_vertex_array(vao_flat_);
     index_buffer_.bind();
     GL_CHECK(glDrawElements(GL_TRIANGLES, 6 * num_sprites, GL_UNSIGNED_SHORT, 0));
 }
 
 } // anonymous namespace
 
+text_layout::text_layout(const g2d::font *font, text_align align, const wchar_t *str)
+{
+    set_text(font, align, str);
+}
+
+void text_layout::set_text(const g2d::font *font, text_align align, const wchar_t *str)
+{
+    texture_ = font->get_texture();
+    width_ = font->get_string_width(str);
+
+    float x = 0;
+
+    if (align == text_align::RIGHT)
+        x -= width_;
+    else if (align == text_align::CENTER)
+        x -= .5f * width_;
+
+    glyphs_.clear();
+
+    for (const wchar_t *p = str; *p; ++p) {
+        const auto g = font->find_glyph(*p);
+
+        const float x0 = x + g->left;
+        const float x1 = x0 + g->width;
+        const float y0 = g->top;
+        const float y1 = y0 - g->height;
+
+        glyphs_.push_back({{{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}},
+                           {g->texuv[0], g->texuv[1], g->texuv[2], g->texuv[3]}});
+
+        x += g->advance_x;
+    }
+}
+
 void init()
 {
     g_sprite_batch = new sprite_batch();
 }
 
+void begin_frame(command_list &list)
+{
+    g_sprite_batch->begin_frame(list);
+}
+
+void end_frame()
+{
+    g_sprite_batch->end_frame();
+}
+
+void submit(const command_list &list)
+{
+    g_sprite_batch->submit(list);
+}
+
+void defer(std::function<void()> fn)
+{
+    g_sprite_batch->defer(std::move(fn));
+}
+
 void set_viewport(int x_min, int x_max, int y_min, int y_max)
 {
     g_sprite_batch->set_viewport(x_min, x_max, y_min, y_max);
 }
 
+void set_damage(const std::vector<box> &damage)
+{
+    g_sprite_batch->set_damage(damage);
+}
+
+void set_show_damage(bool enabled)
+{
+    g_sprite_batch->set_show_damage(enabled);
+}
+
 void set_scissor_box(int x, int y, int width, int height)
 {
     g_sprite_batch->set_scissor_box(x, y, width, height);
@@ -677,6 +1601,27 @@ void end_batch()
     g_sprite_batch->end_batch();
 }
 
+void draw_offscreen_layer(offscreen_layer &l, const box &bounds, int layer, const std::function<void()> &draw_contents)
+{
+    g_sprite_batch->draw_offscreen_layer(l, bounds, layer, draw_contents);
+}
+
+void reload_offscreen_layers()
+{
+    for (auto *l : offscreen_layers) {
+        if (l->framebuffer)
+            l->framebuffer->load();
+    }
+
+    invalidate_offscreen_layers();
+}
+
+void invalidate_offscreen_layers()
+{
+    for (auto *l : offscreen_layers)
+        l->valid = false;
+}
+
 void push_matrix()
 {
     g_sprite_batch->push_matrix();
@@ -707,6 +1652,11 @@ void rotate(float a)
     g_sprite_batch->rotate(a);
 }
 
+void set_transform_fast_paths(bool enabled)
+{
+    g_sprite_batch->set_transform_fast_paths(enabled);
+}
+
 void set_blend_mode(blend_mode mode)
 {
     g_sprite_batch->set_blend_mode(mode);
@@ -814,4 +1764,31 @@ void draw_text(const g2d::font *font, const g2d::vec2 &pos, int layer,
     g_sprite_batch->add_text(font, pos, layer, top_outline_color, top_text_color,
             bottom_outline_color, bottom_text_color, str);
 }
+
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer)
+{
+    draw_text(nullptr, layout, pos, layer);
+}
+
+void draw_text(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos, int layer)
+{
+    g_sprite_batch->add_text(program, layout, pos, layer);
+}
+
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer, const g2d::rgba &outline_color,
+               const g2d::rgba &text_color)
+{
+    g_sprite_batch->add_text(layout, pos, layer,
+                             {outline_color, outline_color, outline_color, outline_color},
+                             {text_color, text_color, text_color, text_color});
+}
+
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer,
+               const g2d::rgba &top_outline_color, const g2d::rgba &top_text_color,
+               const g2d::rgba &bottom_outline_color, const g2d::rgba &bottom_text_color)
+{
+    g_sprite_batch->add_text(layout, pos, layer,
+                             {top_outline_color, top_outline_color, bottom_outline_color, bottom_outline_color},
+                             {top_text_color, top_text_color, bottom_text_color, bottom_text_color});
+}
 }
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <array>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include <guava2d/rgb.h>
 #include <guava2d/vec2.h>
 
+#include "noncopyable.h"
+
 namespace g2d {
 class program;
 class texture;
@@ -17,7 +22,8 @@ enum class blend_mode
     NO_BLEND,
     ALPHA_BLEND,
     ADDITIVE_BLEND,
-    INVERSE_BLEND
+    INVERSE_BLEND,
+    PREMULTIPLIED_BLEND // colors already multiplied by alpha, like offscreen layers
 };
 
 enum class text_align
@@ -44,15 +50,118 @@ struct vert_colors
     g2d::rgba c00, c01, c10, c11;
 };
 
+// glyph quads for a string, laid out once and reused every time it's drawn
+
+class text_layout
+{
+public:
+    text_layout() = default;
+    text_layout(const g2d::font *font, text_align align, const wchar_t *str);
+
+    void set_text(const g2d::font *font, text_align align, const wchar_t *str);
+
+    struct glyph
+    {
+        quad verts;
+        quad texcoords;
+    };
+
+    const g2d::texture *get_texture() const { return texture_; }
+    const std::vector<glyph> &get_glyphs() const { return glyphs_; }
+
+    float get_width() const { return width_; }
+
+private:
+    const g2d::texture *texture_ = nullptr;
+    std::vector<glyph> glyphs_;
+    float width_ = 0;
+};
+
+// Everything drawn between begin_frame() and end_frame(). Recording only
+// touches memory, so it can happen on another thread than the one that
+// owns the GL context; submit() replays the list there.
+
+class command_list : private noncopyable
+{
+public:
+    command_list();
+    ~command_list();
+
+    struct impl;
+    impl *get_impl() const { return impl_.get(); }
+
+private:
+    std::unique_ptr<impl> impl_;
+};
+
+// Part of the frame that is drawn into an offscreen framebuffer and
+// composited from there, redrawn only after invalidate() or when its bounds
+// move. Worth it for things that are expensive to draw but rarely change.
+
+class offscreen_layer : private noncopyable
+{
+public:
+    explicit offscreen_layer(const char *name);
+    ~offscreen_layer();
+
+    void invalidate();
+
+    struct impl;
+    impl *get_impl() const { return impl_.get(); }
+
+private:
+    std::unique_ptr<impl> impl_;
+};
+
 void init();
 
+void begin_frame(command_list &list);
+void end_frame();
+
+// GL thread only
+void submit(const command_list &list);
+
+// GL thread only, after the context was recreated: gives every offscreen
+// layer a new framebuffer and redraws it
+void reload_offscreen_layers();
+
+// After dropping recorded command lists without submitting them, since the
+// layer contents they carried were never drawn, and the next frame's damage
+// would be relative to one that was never shown. Not while recording.
+void invalidate_offscreen_layers();
+
+// Runs fn when the list is submitted, after the batches ended before it and
+// before the ones that follow. For GL work that doesn't fit in a batch, like
+// uniforms; fn must capture by value anything the simulation may change.
+void defer(std::function<void()> fn);
+
 void set_viewport(int x_min, int x_max, int y_min, int y_max);
 
+// The rectangles, in the coordinates of the last set_viewport(), outside of
+// which the frame looks the same as the one recorded before it. A frame that
+// sets its damage is drawn into a framebuffer kept from one frame to the
+// next, redrawing only the damaged rectangles (or all of it, if they cover
+// most of the screen or the previous frame wasn't kept), and copied to the
+// screen from there. Frames that don't are drawn to the screen in full.
+void set_damage(const std::vector<box> &damage);
+
+// Tints what frames with damage redraw: green over the damaged rectangles,
+// red over the whole screen when it's redrawn in full. For debugging.
+void set_show_damage(bool enabled);
+
 void set_scissor_box(int x, int y, int width, int height);
 
 void begin_batch();
 void end_batch();
 
+// Composites l at the given layer of the current batch. When l isn't
+// valid, draw_contents is called first to draw it, with the current state
+// and matrix but into l's framebuffer instead of the screen, and the result
+// is kept. The contents must stay within bounds (given in the current,
+// axis-aligned, coordinates), may only use the NO_BLEND, ALPHA_BLEND and
+// ADDITIVE_BLEND modes, and must not end the batch.
+void draw_offscreen_layer(offscreen_layer &l, const box &bounds, int layer, const std::function<void()> &draw_contents);
+
 void push_matrix();
 void pop_matrix();
 
@@ -61,6 +170,11 @@ void translate(const g2d::vec2 &v);
 void scale(float sx, float sy);
 void rotate(float a);
 
+// When disabled, every vertex goes through the full matrix instead of the
+// cheaper path for what the matrix does (identity, translation, scale and
+// translation); the output is the same. For benchmarking, call between frames.
+void set_transform_fast_paths(bool enabled);
+
 void set_blend_mode(blend_mode mode);
 void set_scissor_test(bool enable);
 void set_color(const g2d::rgba &color);
@@ -93,4 +207,12 @@ void draw_text(const g2d::font *font, const g2d::vec2 &pos, int layer,
                const g2d::rgba &top_outline_color, const g2d::rgba &top_text_color,
                const g2d::rgba &bottom_outline_color, const g2d::rgba &bottom_text_color,
                const wchar_t *str);
+
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer);
+void draw_text(const g2d::program *program, const text_layout &layout, const g2d::vec2 &pos, int layer);
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer, const g2d::rgba &outline_color,
+               const g2d::rgba &text_color);
+void draw_text(const text_layout &layout, const g2d::vec2 &pos, int layer,
+               const g2d::rgba &top_outline_color, const g2d::rgba &top_text_color,
+               const g2d::rgba &bottom_outline_color, const g2d::rgba &bottom_text_color);
 }
@@ -0,0 +1,239 @@
+#include "resolver.h"
+
+#include "log.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// getaddrinfo doesn't tell us the record TTLs, so use a fixed one
+const unsigned CACHE_TTL = 5 * 60 * 1000;
+const size_t MAX_CACHE_ENTRIES = 16;
+
+resolver::address_list resolve_host(const std::string &host)
+{
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *result;
+
+    int rv = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (rv != 0) {
+        log_err("failed to resolve `%s': %s", host.c_str(), gai_strerror(rv));
+        return {};
+    }
+
+    resolver::address_list addrs;
+
+    for (auto *p = result; p; p = p->ai_next)
+        addrs.push_back(reinterpret_cast<struct sockaddr_in *>(p->ai_addr)->sin_addr.s_addr);
+
+    freeaddrinfo(result);
+
+    return addrs;
+}
+
+} // namespace
+
+// Owned jointly by the resolver and its worker thread, so that a worker
+// stuck in getaddrinfo doesn't hold up the app on exit.
+
+struct resolver::query_queue
+{
+    query_queue()
+        : quit(false)
+    {
+        if (pipe(wake_fds) == -1) {
+            log_err("pipe: %s", strerror(errno));
+            wake_fds[0] = wake_fds[1] = -1;
+        } else {
+            for (int fd : wake_fds)
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        }
+    }
+
+    ~query_queue()
+    {
+        for (int fd : wake_fds) {
+            if (fd != -1)
+                close(fd);
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            cond.wait(lock, [this] { return quit || !queries.empty(); });
+
+            if (quit)
+                break;
+
+            const std::string host = std::move(queries.front());
+            queries.pop_front();
+
+            lock.unlock();
+            auto addrs = resolve_host(host);
+            lock.lock();
+
+            results.emplace_back(host, std::move(addrs));
+
+            const char ch = 0;
+            if (write(wake_fds[1], &ch, 1) == -1 && errno != EAGAIN)
+                log_err("write: %s", strerror(errno));
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::string> queries;
+    std::vector<std::pair<std::string, address_list>> results;
+    bool quit;
+    int wake_fds[2];
+};
+
+resolver::resolver(reactor &r)
+    : reactor_(r)
+    , queue_(std::make_shared<query_queue>())
+    , next_id_(0)
+{
+    reactor_.watch(queue_->wake_fds[0], reactor::READABLE, this);
+
+    auto queue = queue_;
+    std::thread([queue] { queue->run(); }).detach();
+}
+
+resolver::~resolver()
+{
+    reactor_.unwatch(queue_->wake_fds[0]);
+
+    std::lock_guard<std::mutex> lock(queue_->mutex);
+    queue_->quit = true;
+    queue_->cond.notify_one();
+}
+
+bool resolver::lookup(const std::string &host, address_list &addrs)
+{
+    auto it = cache_.find(host);
+    if (it == cache_.end())
+        return false;
+
+    if (it->second.expires < reactor::now()) {
+        cache_.erase(it);
+        return false;
+    }
+
+    addrs = it->second.addrs;
+    return true;
+}
+
+int resolver::resolve(const std::string &host, const callback &cb)
+{
+    const int id = next_id_++;
+
+    // there's an entry for the host from when it's queried until the result
+    // comes in, even if every request waiting for it was canceled; only
+    // the first request queries it, the others just wait
+    auto it = waiters_.find(host);
+    const bool in_flight = it != waiters_.end();
+
+    if (!in_flight)
+        it = waiters_.emplace(host, std::vector<waiter>()).first;
+
+    it->second.push_back(waiter{id, cb});
+
+    if (!in_flight) {
+        std::lock_guard<std::mutex> lock(queue_->mutex);
+        queue_->queries.push_back(host);
+        queue_->cond.notify_one();
+    }
+
+    return id;
+}
+
+void resolver::cancel(int id)
+{
+    for (auto &p : waiters_) {
+        auto &w = p.second;
+
+        for (auto it = w.begin(); it != w.end(); ++it) {
+            if (it->id == id) {
+                // leave the (now empty) list around so the pending query
+                // isn't issued again
+                w.erase(it);
+                return;
+            }
+        }
+    }
+}
+
+void resolver::on_ready(int fd, int)
+{
+    char buf[64];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    std::vector<std::pair<std::string, address_list>> results;
+
+    {
+        std::lock_guard<std::mutex> lock(queue_->mutex);
+        results.swap(queue_->results);
+    }
+
+    for (const auto &result : results) {
+        const auto &host = result.first;
+        const auto &addrs = result.second;
+
+        if (!addrs.empty())
+            add_to_cache(host, addrs);
+
+        auto it = waiters_.find(host);
+        if (it == waiters_.end())
+            continue;
+
+        // callbacks may start new queries
+        auto waiters = std::move(it->second);
+        waiters_.erase(it);
+
+        for (const auto &w : waiters)
+            w.cb(addrs);
+    }
+}
+
+void resolver::add_to_cache(const std::string &host, const address_list &addrs)
+{
+    const uint64_t now = reactor::now();
+
+    if (cache_.size() >= MAX_CACHE_ENTRIES && cache_.find(host) == cache_.end()) {
+        // make room: drop expired entries, or else the one closest to expiring
+        for (auto it = cache_.begin(); it != cache_.end();) {
+            if (it->second.expires < now)
+                it = cache_.erase(it);
+            else
+                ++it;
+        }
+
+        if (cache_.size() >= MAX_CACHE_ENTRIES) {
+            cache_.erase(std::min_element(cache_.begin(), cache_.end(), [](const auto &a, const auto &b) {
+                return a.second.expires < b.second.expires;
+            }));
+        }
+    }
+
+    cache_[host] = cache_entry{addrs, now + CACHE_TTL};
+}
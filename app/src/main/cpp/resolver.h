@@ -0,0 +1,61 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "reactor.h"
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Resolves host names with getaddrinfo on a worker thread, so a slow or
+// unreachable nameserver never stalls a frame. Results are delivered on the
+// reactor's thread and cached for a while.
+
+class resolver : public reactor::handler, private noncopyable
+{
+public:
+    using address_list = std::vector<in_addr_t>;
+
+    // called with an empty list if the lookup failed
+    using callback = std::function<void(const address_list &)>;
+
+    resolver(reactor &r);
+    ~resolver();
+
+    // returns true and fills in addrs if host is in the cache
+    bool lookup(const std::string &host, address_list &addrs);
+
+    // returns an id that can be passed to cancel
+    int resolve(const std::string &host, const callback &cb);
+    void cancel(int id);
+
+    void on_ready(int fd, int events) override;
+
+private:
+    struct query_queue;
+
+    struct cache_entry
+    {
+        address_list addrs;
+        uint64_t expires;
+    };
+
+    struct waiter
+    {
+        int id;
+        callback cb;
+    };
+
+    void add_to_cache(const std::string &host, const address_list &addrs);
+
+    reactor &reactor_;
+    std::shared_ptr<query_queue> queue_; // shared with the worker thread
+    std::map<std::string, cache_entry> cache_;
+    std::map<std::string, std::vector<waiter>> waiters_;
+    int next_id_;
+};
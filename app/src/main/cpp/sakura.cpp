@@ -69,12 +69,26 @@ void sakura_petal::reset(bool from_start)
     }
 }
 
-void sakura_petal::draw(const g2d::texture *texture) const
+g2d::vec2 sakura_petal::get_center() const
 {
     const float a = cosf(phi_0 * tics + phase_0);
     const float b = cosf(phi_1 * tics + phase_1);
 
-    const g2d::vec2 p = pos + g2d::vec2(a * radius_0, b * radius_1);
+    return pos + g2d::vec2(a * radius_0, b * radius_1);
+}
+
+render::box sakura_petal::get_bounds() const
+{
+    // whatever the angle, the corners are at most size/sqrt(2) away
+    const g2d::vec2 p = get_center();
+    const float r = .71f * size;
+
+    return {{p.x - r, p.y - r}, {p.x + r, p.y + r}};
+}
+
+void sakura_petal::draw(const g2d::texture *texture) const
+{
+    const g2d::vec2 p = get_center();
 
     const float s = sinf(angle);
     const float c = cosf(angle);
@@ -117,8 +131,22 @@ void sakura_fubuki::update(uint32_t dt)
 
 void sakura_fubuki::reset()
 {
-    for (auto &p : petals_)
-        p.reset(false);
+    for (size_t i = 0; i < petals_.size(); ++i) {
+        petals_[i].reset(false);
+        drawn_bounds_[i] = petals_[i].get_bounds();
+    }
+}
+
+void sakura_fubuki::get_damage(std::vector<render::box> &damage)
+{
+    for (size_t i = 0; i < petals_.size(); ++i) {
+        const auto bounds = petals_[i].get_bounds();
+
+        damage.push_back(drawn_bounds_[i]);
+        damage.push_back(bounds);
+
+        drawn_bounds_[i] = bounds;
+    }
 }
 
 void sakura_fubuki::draw() const
@@ -2,7 +2,10 @@
 
 #include <guava2d/vec2.h>
 
+#include "render.h"
+
 #include <array>
+#include <vector>
 
 namespace g2d {
 class texture;
@@ -21,6 +24,9 @@ struct sakura_petal
     void reset(bool);
     void draw(const g2d::texture *texture) const;
     void update(uint32_t dt);
+
+    g2d::vec2 get_center() const;
+    render::box get_bounds() const;
 };
 
 class sakura_fubuki
@@ -32,9 +38,13 @@ public:
     void draw() const;
     void update(uint32_t dt);
 
+    // appends where the petals were at the last call and where they are now
+    void get_damage(std::vector<render::box> &damage);
+
 private:
     static constexpr int NUM_PETALS = 20;
     std::array<sakura_petal, NUM_PETALS> petals_;
+    std::array<render::box, NUM_PETALS> drawn_bounds_;
 
     const g2d::texture *petal_texture_;
 };
@@ -0,0 +1,164 @@
+#include "save_file.h"
+
+#include "log.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <zlib.h>
+
+namespace {
+
+const char MAGIC[4] = {'K', 'S', 'A', 'V'};
+
+enum
+{
+    FORMAT_VERSION = 1,
+    HEADER_SIZE = 16,
+};
+
+uint32_t checksum(const char *data, size_t size)
+{
+    return crc32(crc32(0, Z_NULL, 0), reinterpret_cast<const Bytef *>(data), size);
+}
+
+} // namespace
+
+save_data_reader::save_data_reader(const std::string &data)
+    : p_(data.data())
+    , end_(data.data() + data.size())
+{
+}
+
+bool save_data_reader::get_u32(uint32_t &value)
+{
+    if (end_ - p_ < 4)
+        return false;
+
+    const auto *b = reinterpret_cast<const unsigned char *>(p_);
+    value = b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    p_ += 4;
+
+    return true;
+}
+
+bool save_data_reader::get_string(std::string &value)
+{
+    uint32_t size;
+    if (!get_u32(size) || static_cast<size_t>(end_ - p_) < size)
+        return false;
+
+    value.assign(p_, size);
+    p_ += size;
+
+    return true;
+}
+
+void save_data_writer::put_u32(uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        data_.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void save_data_writer::put_string(const std::string &value)
+{
+    put_u32(value.size());
+    data_.append(value);
+}
+
+bool save_file::load(const std::string &path)
+{
+    std::string contents;
+
+    if (FILE *in = fopen(path.c_str(), "rb")) {
+        fseek(in, 0, SEEK_END);
+        const long size = ftell(in);
+        fseek(in, 0, SEEK_SET);
+
+        if (size > 0) {
+            contents.resize(size);
+            if (fread(&contents[0], 1, size, in) != static_cast<size_t>(size))
+                contents.clear();
+        }
+
+        fclose(in);
+    }
+
+    if (contents.size() < HEADER_SIZE || memcmp(contents.data(), MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+
+    save_data_reader reader(contents);
+
+    uint32_t magic, format_version, num_sections, header_crc;
+    reader.get_u32(magic);
+    reader.get_u32(format_version);
+    reader.get_u32(num_sections);
+    reader.get_u32(header_crc);
+
+    if (header_crc != checksum(contents.data(), HEADER_SIZE - 4)) {
+        log_err("%s: bad header checksum", path.c_str());
+        return false;
+    }
+
+    if (format_version != FORMAT_VERSION) {
+        log_err("%s: unsupported format version %u", path.c_str(), format_version);
+        return false;
+    }
+
+    sections_.clear();
+
+    for (uint32_t i = 0; i < num_sections; i++) {
+        uint32_t id, crc;
+        std::string data;
+
+        if (!reader.get_u32(id) || !reader.get_string(data) || !reader.get_u32(crc)) {
+            log_err("%s: truncated", path.c_str());
+            break;
+        }
+
+        if (crc != checksum(data.data(), data.size())) {
+            log_err("%s: bad checksum for section %u", path.c_str(), id);
+            continue;
+        }
+
+        sections_[static_cast<save_section>(id)] = section{std::move(data), crc};
+    }
+
+    return true;
+}
+
+const std::string *save_file::get_section(save_section id) const
+{
+    auto it = sections_.find(id);
+    return it != sections_.end() ? &it->second.data : nullptr;
+}
+
+bool save_file::set_section(save_section id, std::string data)
+{
+    auto it = sections_.find(id);
+    if (it != sections_.end() && it->second.data == data)
+        return false;
+
+    const uint32_t crc = checksum(data.data(), data.size());
+    sections_[id] = section{std::move(data), crc};
+
+    return true;
+}
+
+std::string save_file::serialize() const
+{
+    save_data_writer writer;
+
+    writer.get_data().append(MAGIC, sizeof(MAGIC));
+    writer.put_u32(FORMAT_VERSION);
+    writer.put_u32(sections_.size());
+    writer.put_u32(checksum(writer.get_data().data(), writer.get_data().size()));
+
+    for (const auto &p : sections_) {
+        writer.put_u32(static_cast<uint32_t>(p.first));
+        writer.put_string(p.second.data);
+        writer.put_u32(p.second.crc);
+    }
+
+    return std::move(writer.get_data());
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Everything the game persists, in one file: a header followed by sections,
+// each with its own CRC so a damaged section doesn't take the others with it.
+// All integers are little-endian.
+//
+//   "KSAV" format_version num_sections header_crc
+//   num_sections x { id size data[size] crc }
+//
+// Sections are kept serialized between saves, and only the ones whose
+// contents changed are checksummed again. A save still writes the whole file,
+// replacing the old one atomically, but is skipped if no section changed.
+
+enum class save_section : uint32_t
+{
+    OPTIONS = 1,
+    PROGRESS = 2,
+    JUKUGO_HITS = 3,
+};
+
+class save_file
+{
+public:
+    // one read; returns false if the file is missing or its header is bad.
+    // Sections that fail their CRC are dropped
+    bool load(const std::string &path);
+
+    // nullptr if the section isn't there
+    const std::string *get_section(save_section id) const;
+
+    // returns true if the section changed
+    bool set_section(save_section id, std::string data);
+
+    // contents of the file
+    std::string serialize() const;
+
+private:
+    struct section
+    {
+        std::string data;
+        uint32_t crc;
+    };
+
+    std::map<save_section, section> sections_;
+};
+
+// Helpers for the section contents.
+
+class save_data_writer
+{
+public:
+    void put_u32(uint32_t value);
+    void put_string(const std::string &value);
+
+    std::string &get_data() { return data_; }
+
+private:
+    std::string data_;
+};
+
+class save_data_reader
+{
+public:
+    save_data_reader(const std::string &data);
+
+    // return false if there isn't enough data left
+    bool get_u32(uint32_t &value);
+    bool get_string(std::string &value);
+
+    bool at_end() const { return p_ == end_; }
+
+private:
+    const char *p_;
+    const char *end_;
+};
@@ -0,0 +1,84 @@
+#include "save_queue.h"
+
+#include "log.h"
+#include "utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <unistd.h>
+
+save_queue::save_queue()
+    : writing_(false)
+    , quit_(false)
+{
+    thread_ = std::thread(&save_queue::run, this);
+}
+
+save_queue::~save_queue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    queued_.notify_one();
+
+    thread_.join();
+}
+
+void save_queue::save(const std::string &path, std::string data)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[path] = pending_file{false, std::move(data)};
+    }
+    queued_.notify_one();
+}
+
+void save_queue::remove(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_[path] = pending_file{true, std::string()};
+    }
+    queued_.notify_one();
+}
+
+void save_queue::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    written_.wait(lock, [this] { return pending_.empty() && !writing_; });
+}
+
+void save_queue::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        queued_.wait(lock, [this] { return quit_ || !pending_.empty(); });
+
+        if (pending_.empty())
+            break; // quitting, nothing left to write
+
+        std::map<std::string, pending_file> files;
+        files.swap(pending_);
+        writing_ = true;
+
+        lock.unlock();
+
+        for (const auto &p : files) {
+            if (p.second.remove) {
+                if (unlink(p.first.c_str()) == -1 && errno != ENOENT)
+                    log_err("failed to remove %s: %s", p.first.c_str(), strerror(errno));
+            } else {
+                write_file_atomically(p.first, p.second.data.data(), p.second.data.size());
+            }
+        }
+
+        lock.lock();
+
+        writing_ = false;
+        written_.notify_all();
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes files on a background thread, so the frame loop never waits on the
+// disk. Callers hand over a complete snapshot of the file's contents; if a
+// file is saved again before the thread gets to it, only the latest snapshot
+// is written. Files are replaced atomically. remove() is queued the same way,
+// so it can't be undone by a save that was still waiting.
+
+class save_queue : private noncopyable
+{
+public:
+    save_queue();
+    ~save_queue(); // writes whatever is still queued
+
+    void save(const std::string &path, std::string data);
+    void remove(const std::string &path);
+
+    // blocks until everything queued so far is on disk
+    void flush();
+
+private:
+    struct pending_file
+    {
+        bool remove;
+        std::string data;
+    };
+
+    void run();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable written_;
+    std::map<std::string, pending_file> pending_; // by path
+    bool writing_;
+    bool quit_;
+};
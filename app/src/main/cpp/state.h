@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include "kasui.h"
+#include "render.h"
 
 class state
 {
@@ -13,6 +15,16 @@ public:
 
     virtual void redraw() const = 0;
     virtual void update(uint32_t dt) = 0;
+
+    // false if update() wouldn't change anything on screen until the next
+    // input event, which lets the main loop stop rendering
+    virtual bool is_animating() const { return true; }
+
+    // Called once per frame, after update(): appends the rectangles, in
+    // window coordinates, where the screen may have changed since the last
+    // frame. False if that can't be told, and the whole screen is redrawn.
+    virtual bool get_damage(std::vector<render::box> &) { return false; }
+
     virtual void on_touch_down(float x, float y) = 0;
     virtual void on_touch_up() = 0;
     virtual void on_touch_move(float x, float y) = 0;
@@ -65,7 +65,10 @@ public:
 private:
     const g2d::program *program_;
     const kanji_info *kanji_;
-    std::wstring kanji_text_;
+    render::text_layout kanji_text_;
+    render::text_layout on_text_;
+    render::text_layout kun_text_;
+    render::text_layout meaning_text_;
 };
 
 class jukugo_info_item : public stats_page_item
@@ -87,8 +90,9 @@ private:
     const jukugo *jukugo_;
 
     int height_;
-    std::vector<std::wstring> meaning_text_;
-    std::wstring hits_text_;
+    render::text_layout kanji_text_;
+    std::vector<render::text_layout> meaning_text_;
+    render::text_layout hits_text_;
 
     static constexpr int MAX_MEANING_WIDTH = 360;
     static constexpr int LINE_HEIGHT = 30;
@@ -105,6 +109,9 @@ public:
     void draw(float alpha) const;
     void update(uint32_t dt);
 
+    // appends the list if it scrolled since the last call
+    void get_damage(std::vector<render::box> &damage);
+
     void on_drag_start();
     void on_drag_end();
     void on_drag(float dy);
@@ -116,8 +123,9 @@ private:
     void update_y_offset(float dy);
 
     std::vector<stats_page_item *> items_;
-    std::wstring title_text_;
+    render::text_layout title_text_;
     float y_offset_;
+    float drawn_y_offset_; // at the last get_damage()
     float top_y_;
     int touch_start_tic_;
     float total_drag_dy_;
@@ -134,6 +142,7 @@ public:
     void reset();
     void redraw() const;
     void update(uint32_t dt);
+    bool get_damage(std::vector<render::box> &damage);
     void on_touch_down(float x, float y);
     void on_touch_up();
     void on_touch_move(float x, float y);
@@ -164,6 +173,7 @@ private:
     } cur_state_;
 
     int state_tics_;
+    bool was_settled_; // at the last get_damage()
 
     static const int TRANSITION_TICS = 10 * MS_PER_TIC;
     static const int INTRO_TICS = 15 * MS_PER_TIC;
@@ -218,7 +228,12 @@ kanji_info_item::kanji_info_item(const kanji_info *kanji)
     , program_{get_program(program::text_inner)}
     , kanji_{kanji}
 {
-    kanji_text_.push_back(kanji->code);
+    const wchar_t kanji_text[] = {kanji->code, L'\0'};
+
+    kanji_text_.set_text(get_font(font::large), text_align::LEFT, kanji_text);
+    on_text_.set_text(get_font(font::micro), text_align::LEFT, kanji->on);
+    kun_text_.set_text(get_font(font::micro), text_align::LEFT, kanji->kun);
+    meaning_text_.set_text(get_font(font::small), text_align::RIGHT, kanji->meaning);
 }
 
 void kanji_info_item::draw(float alpha) const
@@ -228,13 +243,10 @@ void kanji_info_item::draw(float alpha) const
     const int height = get_height();
 
     const auto draw_text = [this, height]() {
-        render::set_text_align(text_align::LEFT);
-        render::draw_text(program_, get_font(font::large), {10.f, -.5f * height - 28.f}, TEXT_LAYER, kanji_text_.c_str());
-        render::draw_text(program_, get_font(font::micro), {110.f, -.5f * height + 6.f}, TEXT_LAYER, kanji_->on);
-        render::draw_text(program_, get_font(font::micro), {110.f, -.5f * height - 24.f}, TEXT_LAYER, kanji_->kun);
-
-        render::set_text_align(text_align::RIGHT);
-        render::draw_text(program_, get_font(font::small), {window_width - 20.f, -.5f * height - 12.f}, TEXT_LAYER, kanji_->meaning);
+        render::draw_text(program_, kanji_text_, {10.f, -.5f * height - 28.f}, TEXT_LAYER);
+        render::draw_text(program_, on_text_, {110.f, -.5f * height + 6.f}, TEXT_LAYER);
+        render::draw_text(program_, kun_text_, {110.f, -.5f * height - 24.f}, TEXT_LAYER);
+        render::draw_text(program_, meaning_text_, {window_width - 20.f, -.5f * height - 12.f}, TEXT_LAYER);
     };
 
     render::set_blend_mode(blend_mode::ALPHA_BLEND);
@@ -260,9 +272,11 @@ jukugo_info_item::jukugo_info_item(const jukugo *jukugo)
         line_splitter ls(get_font(font::micro), meaning_buf);
         std::wstring line;
         while (line = ls.next_line(MAX_MEANING_WIDTH), !line.empty())
-            meaning_text_.push_back(line);
+            meaning_text_.emplace_back(get_font(font::micro), text_align::LEFT, line.c_str());
     }
 
+    kanji_text_.set_text(get_font(font::medium), text_align::LEFT, jukugo->kanji);
+
     static constexpr int MIN_HEIGHT = 72;
     height_ = std::max(MIN_HEIGHT, 14 + static_cast<int>(meaning_text_.size()) * LINE_HEIGHT);
 
@@ -273,7 +287,7 @@ void jukugo_info_item::reset_contents()
 {
     wchar_t hits_buf[80];
     xswprintf(hits_buf, L"%d", jukugo_->hits);
-    hits_text_ = hits_buf;
+    hits_text_.set_text(get_font(font::micro), text_align::RIGHT, hits_buf);
 }
 
 void jukugo_info_item::draw(float alpha) const
@@ -283,19 +297,16 @@ void jukugo_info_item::draw(float alpha) const
     render::set_blend_mode(blend_mode::INVERSE_BLEND);
     render::set_color({alpha, alpha, alpha, 1.f});
 
-    render::set_text_align(text_align::LEFT);
-    render::draw_text(get_font(font::medium), {30.f, -.5f * height_ - 16.f}, TEXT_LAYER, jukugo_->kanji);
+    render::draw_text(kanji_text_, {30.f, -.5f * height_ - 16.f}, TEXT_LAYER);
 
-    wchar_t *line;
     int y = -.5 * height_ + .5 * meaning_text_.size() * LINE_HEIGHT + 2;
 
     for (const auto& line : meaning_text_) {
-        render::draw_text(get_font(font::micro), {160.f, y - 22.f}, TEXT_LAYER, line.c_str());
+        render::draw_text(line, {160.f, y - 22.f}, TEXT_LAYER);
         y -= LINE_HEIGHT;
     }
 
-    render::set_text_align(text_align::RIGHT);
-    render::draw_text(get_font(font::micro), {window_width - 20.f, -.5f * height_ - 8.f}, TEXT_LAYER, hits_text_.c_str());
+    render::draw_text(hits_text_, {window_width - 20.f, -.5f * height_ - 8.f}, TEXT_LAYER);
 }
 
 stats_page::stats_page(int level, float top_y)
@@ -354,12 +365,12 @@ stats_page::stats_page(int level, float top_y)
 
     wchar_t title_buf[80];
     xswprintf(title_buf, L"level %d", level + 1);
-    title_text_ = title_buf;
+    title_text_.set_text(get_font(font::medium), text_align::CENTER, title_buf);
 }
 
 void stats_page::reset()
 {
-    y_offset_ = 0;
+    y_offset_ = drawn_y_offset_ = 0;
     speed_ = 0;
     tics_ = 0;
 }
@@ -403,8 +414,7 @@ void stats_page::draw_title(float alpha) const
 {
     render::set_blend_mode(blend_mode::INVERSE_BLEND);
     render::set_color({alpha, alpha, alpha, 1.f});
-    render::set_text_align(text_align::CENTER);
-    render::draw_text(get_font(font::medium), {.5f * window_width, window_height - .5f * TITLE_HEIGHT - 14.f}, TEXT_LAYER, title_text_.c_str());
+    render::draw_text(title_text_, {.5f * window_width, window_height - .5f * TITLE_HEIGHT - 14.f}, TEXT_LAYER);
 }
 
 void stats_page::update(uint32_t dt)
@@ -421,6 +431,14 @@ void stats_page::update(uint32_t dt)
     }
 }
 
+void stats_page::get_damage(std::vector<render::box> &damage)
+{
+    if (y_offset_ != drawn_y_offset_) {
+        damage.push_back({{0, 0}, {window_width, top_y_}});
+        drawn_y_offset_ = y_offset_;
+    }
+}
+
 void stats_page::on_drag_start()
 {
     speed_ = total_drag_dy_ = 0;
@@ -469,6 +487,7 @@ void stats_state_impl::reset()
     cur_state_ = INTRO;
 
     state_tics_ = 0;
+    was_settled_ = false;
 
     for (auto &level_stat : level_stats_) {
         level_stat->reset_contents();
@@ -598,6 +617,19 @@ void stats_state_impl::update(uint32_t dt)
     }
 }
 
+bool stats_state_impl::get_damage(std::vector<render::box> &damage)
+{
+    const bool background_settled = get_main_menu_state()->get_damage(damage);
+    level_stats_[cur_level_]->get_damage(damage);
+
+    // pages sliding, or just done; dragging only changes things with input
+    const bool settled = cur_state_ != INTRO && cur_state_ != OUTRO && cur_state_ != TRANSITION;
+    const bool was_settled = was_settled_;
+    was_settled_ = settled;
+
+    return background_settled && settled && was_settled;
+}
+
 int stats_state_impl::get_next_level() const
 {
     if (fabs(x_offset_) > .25 * window_width) {
@@ -734,6 +766,11 @@ void stats_page_state::update(uint32_t dt)
     impl_->update(dt);
 }
 
+bool stats_page_state::get_damage(std::vector<render::box> &damage)
+{
+    return impl_->get_damage(damage);
+}
+
 void stats_page_state::on_touch_down(float x, float y)
 {
     impl_->on_touch_down(x, y);
@@ -6,6 +6,7 @@
 #include "render.h"
 #include "text_box.h"
 #include "fonts.h"
+#include "programs.h"
 
 #include <tuple>
 #include <algorithm>
@@ -100,6 +101,7 @@ text_box::text_box(float width)
     : width_(width)
     , height_(0)
     , frame_texture_(g2d::load_texture("images/w-button-border.png"))
+    , program_(get_program(program::text))
 {
 }
 
@@ -208,5 +210,5 @@ void text_box::draw_text(float alpha) const
     render::set_color({alpha, alpha, alpha, 1.f});
 
     for (const auto &p : quads_)
-        render::draw_quad(std::get<0>(p), std::get<1>(p), std::get<2>(p), 21);
+        render::draw_quad(program_, std::get<0>(p), std::get<1>(p), std::get<2>(p), 21);
 }
@@ -5,6 +5,7 @@
 #include <vector>
 
 namespace g2d {
+class program;
 class texture;
 };
 
@@ -30,5 +31,6 @@ private:
 
     float width_, height_;
     const g2d::texture *frame_texture_;
+    const g2d::program *program_;
     std::vector<std::tuple<const g2d::texture *, render::quad, render::quad>> quads_;
 };
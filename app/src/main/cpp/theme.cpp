@@ -6,18 +6,37 @@ theme_animation::~theme_animation()
 {
 }
 
-std::unique_ptr<theme_animation> make_theme(int index)
+#include <array>
+#include <cassert>
+
+namespace {
+
+std::array<std::unique_ptr<theme_animation>, NUM_THEMES> themes;
+
+theme_animation *make_theme(int index)
+{
+    switch (index)
+    {
+    case THEME_CLOUDS:
+        return new clouds_theme;
+    case THEME_FALLING_LEAVES:
+        return new falling_leaves_theme;
+    case THEME_FLOWERS:
+    default:
+        return new flowers_theme;
+    }
+}
+
+}
+
+void initialize_themes()
+{
+    for (int i = 0; i < NUM_THEMES; ++i)
+        themes[i].reset(make_theme(i));
+}
+
+theme_animation *get_theme(int index)
 {
-    return std::unique_ptr<theme_animation>([index]() -> theme_animation * {
-        switch (index)
-        {
-        case THEME_CLOUDS:
-            return new clouds_theme;
-        case THEME_FALLING_LEAVES:
-            return new falling_leaves_theme;
-        case THEME_FLOWERS:
-        default:
-            return new flowers_theme;
-        }
-    }());
+    assert(themes[index]);
+    return themes[index].get();
 }
@@ -21,4 +21,7 @@ enum
     NUM_THEMES,
 };
 
-std::unique_ptr<theme_animation> make_theme(int index);
+// themes own GL resources, so they're all created up front on the GL thread
+// rather than whenever a level starts
+void initialize_themes();
+theme_animation *get_theme(int index);
@@ -8,6 +8,8 @@
 
 #include <guava2d/texture_manager.h>
 
+#include <algorithm>
+
 class title_background::widget
 {
 public:
@@ -17,6 +19,9 @@ public:
     virtual void reset();
     virtual void draw() const = 0;
 
+    // false while sliding in or out, or right after, when it moves
+    virtual bool get_damage(std::vector<render::box> &damage);
+
     enum class state
     {
         OUTSIDE,
@@ -35,6 +40,7 @@ protected:
 
     state cur_state_ = state::INSIDE;
     uint32_t state_t_ = 0;
+    state drawn_state_ = state::ENTERING; // at the last get_damage()
 };
 
 void title_background::widget::reset()
@@ -80,6 +86,13 @@ void title_background::widget::update(uint32_t dt)
     }
 }
 
+bool title_background::widget::get_damage(std::vector<render::box> &)
+{
+    const bool settled = cur_state_ == drawn_state_ && (cur_state_ == state::INSIDE || cur_state_ == state::OUTSIDE);
+    drawn_state_ = cur_state_;
+    return settled;
+}
+
 namespace {
 
 class kasui_logo : public title_background::widget
@@ -90,12 +103,14 @@ public:
     void reset() override;
     void update(uint32_t dt) override;
     void draw() const override;
+    bool get_damage(std::vector<render::box> &damage) override;
 
 private:
     const g2d::sprite *bg_, *ka_, *sui_;
     float ka_scale_, sui_scale_;
     float ka_mix_, sui_mix_;
-    std::unique_ptr<abstract_action> action_;
+    float drawn_ka_scale_, drawn_sui_scale_; // at the last get_damage()
+    timeline action_;
 };
 
 kasui_logo::kasui_logo()
@@ -106,26 +121,30 @@ kasui_logo::kasui_logo()
     , sui_scale_(1)
     , ka_mix_(0)
     , sui_mix_(0)
+    , drawn_ka_scale_(1)
+    , drawn_sui_scale_(1)
 {
     constexpr float max_scale = 1.15;
 
-    action_.reset(
-        (new parallel_action_group)
-            ->add((new sequential_action_group)
-                      ->add(new property_change_action<in_back_tween<float>>(&ka_scale_, 1, max_scale, 12 * MS_PER_TIC))
-                      ->add(new property_change_action<out_bounce_tween<float>>(&ka_scale_, max_scale, 1,
-                                                                                12 * MS_PER_TIC))
-                      ->add(new delay_action(80 * MS_PER_TIC)))
-            ->add(new property_change_action<linear_tween<float>>(&ka_mix_, 1, 0, 20 * MS_PER_TIC))
-            ->add(
-                (new sequential_action_group)
-                    ->add(new delay_action(30 * MS_PER_TIC))
-                    ->add(new property_change_action<in_back_tween<float>>(&sui_scale_, 1, max_scale, 12 * MS_PER_TIC))
-                    ->add(new property_change_action<out_bounce_tween<float>>(&sui_scale_, max_scale, 1,
-                                                                              12 * MS_PER_TIC)))
-            ->add((new sequential_action_group)
-                      ->add(new delay_action(30 * MS_PER_TIC))
-                      ->add(new property_change_action<linear_tween<float>>(&sui_mix_, 1, 0, 20 * MS_PER_TIC))));
+    parallel_action_group p;
+
+    p.add((new sequential_action_group)
+               ->add(new property_change_action<in_back_tween<float>>(&ka_scale_, 1, max_scale, 12 * MS_PER_TIC))
+               ->add(new property_change_action<out_bounce_tween<float>>(&ka_scale_, max_scale, 1, 12 * MS_PER_TIC))
+               ->add(new delay_action(80 * MS_PER_TIC)));
+
+    p.add(new property_change_action<linear_tween<float>>(&ka_mix_, 1, 0, 20 * MS_PER_TIC));
+
+    p.add((new sequential_action_group)
+               ->add(new delay_action(30 * MS_PER_TIC))
+               ->add(new property_change_action<in_back_tween<float>>(&sui_scale_, 1, max_scale, 12 * MS_PER_TIC))
+               ->add(new property_change_action<out_bounce_tween<float>>(&sui_scale_, max_scale, 1, 12 * MS_PER_TIC)));
+
+    p.add((new sequential_action_group)
+               ->add(new delay_action(30 * MS_PER_TIC))
+               ->add(new property_change_action<linear_tween<float>>(&sui_mix_, 1, 0, 20 * MS_PER_TIC)));
+
+    action_.add(p);
 }
 
 void kasui_logo::reset()
@@ -134,17 +153,40 @@ void kasui_logo::reset()
 
     ka_scale_ = sui_scale_ = 1;
     ka_mix_ = sui_mix_ = 0;
-    action_->reset();
+    action_.reset();
 }
 
 void kasui_logo::update(uint32_t dt)
 {
     widget::update(dt);
 
-    action_->step(dt);
+    action_.step(dt);
+
+    if (action_.done())
+        action_.reset();
+}
+
+bool kasui_logo::get_damage(std::vector<render::box> &damage)
+{
+    if (!widget::get_damage(damage))
+        return false;
+
+    // the letters bounce every now and then, growing upwards from the
+    // bottom of the logo and off the top of the screen
+    if (cur_state_ == state::INSIDE && (ka_scale_ != drawn_ka_scale_ || sui_scale_ != drawn_sui_scale_)) {
+        const float w = std::max({bg_->get_width(), ka_->get_width(), sui_->get_width()});
+        const float h = bg_->get_height();
+
+        const float x = .5 * (window_width - bg_->get_width());
+        const float y = window_height - h;
+
+        damage.push_back({{x, y}, {x + w, window_height}});
+    }
+
+    drawn_ka_scale_ = ka_scale_;
+    drawn_sui_scale_ = sui_scale_;
 
-    if (action_->done())
-        action_->reset();
+    return true;
 }
 
 void kasui_logo::draw() const
@@ -301,6 +343,16 @@ void title_background::update(uint32_t dt)
     logo_->update(dt);
 }
 
+bool title_background::get_damage(std::vector<render::box> &damage)
+{
+    sakura_.get_damage(damage);
+
+    const bool billboard_settled = billboard_->get_damage(damage);
+    const bool logo_settled = logo_->get_damage(damage);
+
+    return billboard_settled && logo_settled;
+}
+
 void title_background::draw() const
 {
     render::set_blend_mode(blend_mode::NO_BLEND);
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include "render.h"
 #include "sakura.h"
 
 class title_background
@@ -14,6 +16,9 @@ public:
     void update(uint32_t dt);
     void draw() const;
 
+    // see state::get_damage()
+    bool get_damage(std::vector<render::box> &damage);
+
     void show_billboard();
     void hide_billboard();
 
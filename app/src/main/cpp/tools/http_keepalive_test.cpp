@@ -0,0 +1,332 @@
+// Loopback test for http_request's connection reuse. Runs an HTTP/1.1 server
+// on a thread and checks that:
+//
+// - back to back requests to it share one connection, and how much time
+//   that saves over a connection per request
+// - a pooled connection the server silently stopped answering on is given
+//   up on, and the request is retried once on a fresh connection
+//
+//   http_keepalive_test [-n requests] [-d delay_ms] [-v]
+//
+// Exits with a non-zero status if either check fails.
+
+#include "http_request.h"
+#include "reactor.h"
+#include "resolver.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Serves every connection on its own thread:
+//
+//   /        200, kept alive
+//   /close   200 with Connection: close
+//   /stall   200 if it's the connection's first request, otherwise reads the
+//            request and never answers, like a peer that went away
+class test_server
+{
+public:
+    explicit test_server(int delay_ms);
+    ~test_server();
+
+    int get_port() const { return port_; }
+    int get_connections() const { return connections_; }
+
+private:
+    void accept_loop();
+    void serve(int fd);
+
+    int listen_fd_;
+    int port_;
+    int delay_ms_;
+    std::atomic<int> connections_;
+};
+
+test_server::test_server(int delay_ms)
+    : listen_fd_(socket(AF_INET, SOCK_STREAM, 0))
+    , port_(0)
+    , delay_ms_(delay_ms)
+    , connections_(0)
+{
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in sin = {};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t len = sizeof(sin);
+
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&sin), sizeof(sin)) == -1 ||
+        listen(listen_fd_, 16) == -1 ||
+        getsockname(listen_fd_, reinterpret_cast<struct sockaddr *>(&sin), &len) == -1) {
+        perror("test_server");
+        exit(1);
+    }
+
+    port_ = ntohs(sin.sin_port);
+
+    std::thread([this] { accept_loop(); }).detach();
+}
+
+test_server::~test_server()
+{
+    // the threads are left blocked; this only goes away at exit
+    close(listen_fd_);
+}
+
+void test_server::accept_loop()
+{
+    for (;;) {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd == -1)
+            return;
+
+        ++connections_;
+        std::thread([this, fd] { serve(fd); }).detach();
+    }
+}
+
+void test_server::serve(int fd)
+{
+    std::string buf;
+    int num_requests = 0;
+
+    for (;;) {
+        size_t end;
+        while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+            char chunk[1024];
+            const ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) {
+                close(fd);
+                return;
+            }
+            buf.append(chunk, n);
+        }
+
+        const std::string request = buf.substr(0, end);
+        buf.erase(0, end + 4);
+
+        const bool first = num_requests++ == 0;
+
+        if (request.compare(0, 11, "GET /stall ") == 0 && !first) {
+            // keep the socket open, but never answer
+            char chunk[1024];
+            while (read(fd, chunk, sizeof(chunk)) > 0)
+                ;
+            close(fd);
+            return;
+        }
+
+        if (delay_ms_ > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+
+        const bool keep_alive = request.compare(0, 11, "GET /close ") != 0;
+
+        const std::string response = std::string("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n") +
+                                     (keep_alive ? "" : "Connection: close\r\n") + "\r\nok";
+
+        if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(response.size()) ||
+            !keep_alive) {
+            close(fd);
+            return;
+        }
+    }
+}
+
+class client
+{
+public:
+    client()
+        : resolver_(reactor_)
+    {
+    }
+
+    // runs a request to completion, returns whether it got a 200 with the
+    // expected body
+    bool get(const std::string &url);
+
+private:
+    reactor reactor_;
+    resolver resolver_;
+};
+
+bool client::get(const std::string &url)
+{
+    http_request req(reactor_, resolver_);
+
+    std::string body;
+    bool ok = false;
+
+    if (!req.get(url.c_str(), [&body](int, const byte_span &chunk) { body.append(chunk.data, chunk.size); },
+                 [&ok](const http_response &resp) { ok = resp.success && resp.status == 200; }))
+        return false;
+
+    while (!req.done())
+        reactor_.poll(-1);
+
+    return ok && body == "ok";
+}
+
+// http_request logs every read and write; keep that out of the results
+class quiet_stderr
+{
+public:
+    explicit quiet_stderr(bool verbose)
+        : saved_(-1)
+    {
+        if (verbose)
+            return;
+
+        fflush(stderr);
+        saved_ = dup(STDERR_FILENO);
+
+        const int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+
+    ~quiet_stderr()
+    {
+        if (saved_ == -1)
+            return;
+
+        fflush(stderr);
+        dup2(saved_, STDERR_FILENO);
+        close(saved_);
+    }
+
+private:
+    int saved_;
+};
+
+double run_sequential(client &c, const std::string &url, int requests, int &failures)
+{
+    const auto start = clock_type::now();
+
+    for (int i = 0; i < requests; i++) {
+        if (!c.get(url))
+            ++failures;
+    }
+
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-n requests] [-d delay_ms] [-v]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int requests = 500;
+    int delay_ms = 2;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:v")) != -1) {
+        switch (opt) {
+            case 'n':
+                requests = atoi(optarg);
+                break;
+
+            case 'd':
+                delay_ms = atoi(optarg);
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    bool passed = true;
+
+    // every test gets its own server, so the pool never holds a connection
+    // from an earlier one
+
+    {
+        test_server server(delay_ms);
+        const std::string base = "http://127.0.0.1:" + std::to_string(server.get_port());
+
+        client c;
+        int keep_alive_failures = 0, close_failures = 0;
+
+        double keep_alive_ms, close_ms;
+        int keep_alive_connections;
+
+        {
+            quiet_stderr quiet(verbose);
+            keep_alive_ms = run_sequential(c, base + "/", requests, keep_alive_failures);
+            keep_alive_connections = server.get_connections();
+            close_ms = run_sequential(c, base + "/close", requests, close_failures);
+        }
+
+        const int close_connections = server.get_connections() - keep_alive_connections;
+
+        printf("keep-alive: %d requests in %.0f ms over %d connection(s), %d failed\n", requests, keep_alive_ms,
+               keep_alive_connections, keep_alive_failures);
+        printf("close:      %d requests in %.0f ms over %d connection(s), %d failed\n", requests, close_ms,
+               close_connections, close_failures);
+
+        if (keep_alive_failures || close_failures || keep_alive_connections != 1) {
+            printf("FAIL: connections weren't reused\n");
+            passed = false;
+        }
+    }
+
+    {
+        test_server server(0);
+        const std::string url = "http://127.0.0.1:" + std::to_string(server.get_port()) + "/stall";
+
+        client c;
+        bool first_ok, second_ok;
+        double second_ms;
+
+        {
+            quiet_stderr quiet(verbose);
+            first_ok = c.get(url);
+
+            const auto start = clock_type::now();
+            second_ok = c.get(url);
+            second_ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+        }
+
+        printf("stalled pooled connection: %s after %.0f ms over %d connection(s)\n",
+               second_ok ? "succeeded" : "failed", second_ms, server.get_connections());
+
+        if (!first_ok || !second_ok || server.get_connections() != 2) {
+            printf("FAIL: request on a stalled pooled connection wasn't retried\n");
+            passed = false;
+        }
+    }
+
+    printf("%s\n", passed ? "PASS" : "FAIL");
+
+    return passed ? 0 : 1;
+}
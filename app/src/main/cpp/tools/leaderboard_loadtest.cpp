@@ -0,0 +1,227 @@
+// Load generator for the leaderboard server: keeps a number of http_request
+// clients busy on one reactor, the same way the game drives them, and reports
+// latency percentiles and throughput.
+//
+//   leaderboard_loadtest [-c concurrency] [-n requests] [-s submit_percent] [-t] url
+
+#include "http_request.h"
+#include "leaderboard_format.h"
+#include "log.h"
+#include "reactor.h"
+#include "resolver.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct stats
+{
+    int started = 0;
+    int succeeded = 0;
+    int failed = 0;
+    int parse_errors = 0;
+    size_t body_bytes = 0;
+    std::vector<double> latencies; // in ms
+};
+
+class load_generator
+{
+public:
+    load_generator(const std::string &url, bool binary, int submit_percent);
+
+    void run(int concurrency, int requests);
+    void report(double elapsed) const;
+
+private:
+    void start_request();
+
+    reactor reactor_;
+    resolver resolver_;
+    std::string url_;
+    bool binary_;
+    int submit_percent_;
+    std::mt19937 rng_;
+    std::list<http_request *> requests_;
+    int in_flight_;
+    stats stats_;
+};
+
+load_generator::load_generator(const std::string &url, bool binary, int submit_percent)
+    : resolver_(reactor_)
+    , url_(url)
+    , binary_(binary)
+    , submit_percent_(submit_percent)
+    , rng_(std::random_device()())
+    , in_flight_(0)
+{
+}
+
+void load_generator::start_request()
+{
+    auto req = new http_request(reactor_, resolver_);
+
+    std::string url = url_;
+
+    if (static_cast<int>(rng_() % 100) < submit_percent_) {
+        url += "?count=1&key0=" + std::to_string(rng_()) + std::to_string(rng_()) +
+               "&score0=" + std::to_string(rng_() % 100000) + "&name0=loadtest";
+    }
+
+    if (binary_)
+        req->set_header("Accept", "application/x-kasui-leaderboard");
+
+    // one parser per request, the responses are interleaved
+    auto parser = std::make_shared<leaderboard_parser>([](const leaderboard_entry &) {});
+    const auto start = clock_type::now();
+
+    ++stats_.started;
+    ++in_flight_;
+
+    bool ok = req->get(url.c_str(),
+                       [this, parser](int status, const byte_span &chunk) {
+                           stats_.body_bytes += chunk.size;
+                           if (status == 200)
+                               parser->feed(chunk.data, chunk.size);
+                       },
+                       [this, parser, start](const http_response &resp) {
+                           --in_flight_;
+
+                           if (!resp.success || resp.status != 200) {
+                               ++stats_.failed;
+                               return;
+                           }
+
+                           if (!parser->finish())
+                               ++stats_.parse_errors;
+
+                           ++stats_.succeeded;
+                           stats_.latencies.push_back(
+                                   std::chrono::duration<double, std::milli>(clock_type::now() - start).count());
+                       });
+
+    if (!ok) {
+        --in_flight_;
+        ++stats_.failed;
+        delete req;
+        return;
+    }
+
+    requests_.push_back(req);
+}
+
+void load_generator::run(int concurrency, int requests)
+{
+    while (stats_.started < requests || in_flight_ > 0) {
+        while (stats_.started < requests && in_flight_ < concurrency)
+            start_request();
+
+        reactor_.poll(10);
+
+        for (auto it = requests_.begin(); it != requests_.end();) {
+            if ((*it)->done()) {
+                delete *it;
+                it = requests_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void load_generator::report(double elapsed) const
+{
+    auto latencies = stats_.latencies;
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto percentile = [&latencies](double p) {
+        if (latencies.empty())
+            return 0.;
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+
+    printf("requests:     %d ok, %d failed, %d malformed\n", stats_.succeeded, stats_.failed, stats_.parse_errors);
+    printf("elapsed:      %.2f s\n", elapsed);
+    printf("throughput:   %.1f req/s, %.1f KiB/s\n", stats_.succeeded / elapsed, stats_.body_bytes / 1024. / elapsed);
+    printf("latency (ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n", percentile(.5), percentile(.9),
+           percentile(.99), latencies.empty() ? 0. : latencies.back());
+}
+
+void raise_fd_limit()
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-c concurrency] [-n requests] [-s submit_percent] [-t] url\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int concurrency = 100;
+    int requests = 10000;
+    int submit_percent = 0;
+    bool binary = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:s:t")) != -1) {
+        switch (opt) {
+            case 'c':
+                concurrency = atoi(optarg);
+                break;
+
+            case 'n':
+                requests = atoi(optarg);
+                break;
+
+            case 's':
+                submit_percent = atoi(optarg);
+                break;
+
+            case 't':
+                binary = false;
+                break;
+
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
+
+    load_generator gen(argv[optind], binary, submit_percent);
+
+    const auto start = clock_type::now();
+    gen.run(concurrency, requests);
+    gen.report(std::chrono::duration<double>(clock_type::now() - start).count());
+
+    return 0;
+}
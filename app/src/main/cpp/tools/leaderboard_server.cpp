@@ -0,0 +1,533 @@
+// Stand-in for the leaderboard server, so net_leaderboard can be exercised
+// on loopback. Keeps the list in memory and speaks both the text and the
+// binary formats, including delta updates and batched hiscore submissions.
+//
+//   leaderboard_server [-p port] [-n max_entries]
+
+#include "leaderboard_format.h"
+#include "log.h"
+#include "reactor.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const int DEFAULT_PORT = 8080;
+const int DEFAULT_MAX_ENTRIES = 40;
+
+const size_t MAX_REQUEST_SIZE = 16 * 1024;
+const size_t MAX_HISTORY = 16; // versions we can send deltas against
+
+const char *BINARY_CONTENT_TYPE = "application/x-kasui-leaderboard";
+
+// Scores, best first. Every change bumps the version and remembers which
+// entry was at each rank, so deltas against recent versions are cheap.
+
+class leaderboard_store
+{
+public:
+    leaderboard_store(int max_entries);
+
+    // returns the id of the new entry, or 0 if key was already submitted or
+    // the score didn't make it into the list
+    uint64_t insert(const std::string &key, int score, const std::string &name);
+
+    // call after a batch of inserts
+    void commit();
+
+    uint32_t get_version() const { return version_; }
+
+    // entries that changed since base_version, or all of them if it's too old
+    // (base_version is then set to 0)
+    std::vector<leaderboard_entry> get_entries(uint32_t &base_version, const std::set<uint64_t> &highlight) const;
+
+    int size() const { return entries_.size(); }
+
+private:
+    struct entry
+    {
+        uint64_t id;
+        int score;
+        std::string name;
+    };
+
+    int max_entries_;
+    std::vector<entry> entries_;
+    std::set<std::string> seen_keys_;
+    uint64_t next_id_;
+    bool dirty_;
+
+    uint32_t version_;
+    std::deque<std::pair<uint32_t, std::vector<uint64_t>>> history_; // ids by rank
+};
+
+leaderboard_store::leaderboard_store(int max_entries)
+    : max_entries_(max_entries)
+    , next_id_(1)
+    , dirty_(false)
+    , version_(1)
+{
+    history_.emplace_back(version_, std::vector<uint64_t>());
+}
+
+uint64_t leaderboard_store::insert(const std::string &key, int score, const std::string &name)
+{
+    if (!key.empty() && !seen_keys_.insert(key).second)
+        return 0;
+
+    // ties go to whoever got there first
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), score,
+                               [](int score, const entry &e) { return score > e.score; });
+
+    if (it - entries_.begin() >= max_entries_)
+        return 0;
+
+    const uint64_t id = next_id_++;
+    entries_.insert(it, entry{id, score, name});
+
+    if (static_cast<int>(entries_.size()) > max_entries_)
+        entries_.pop_back();
+
+    dirty_ = true;
+
+    return id;
+}
+
+void leaderboard_store::commit()
+{
+    if (!dirty_)
+        return;
+
+    std::vector<uint64_t> ids;
+    ids.reserve(entries_.size());
+    for (const auto &e : entries_)
+        ids.push_back(e.id);
+
+    history_.emplace_back(++version_, std::move(ids));
+    if (history_.size() > MAX_HISTORY)
+        history_.pop_front();
+
+    dirty_ = false;
+}
+
+std::vector<leaderboard_entry> leaderboard_store::get_entries(uint32_t &base_version,
+                                                              const std::set<uint64_t> &highlight) const
+{
+    const std::vector<uint64_t> *base = nullptr;
+
+    for (const auto &p : history_) {
+        if (p.first == base_version)
+            base = &p.second;
+    }
+
+    if (!base)
+        base_version = 0;
+
+    std::vector<leaderboard_entry> result;
+
+    for (size_t i = 0; i < entries_.size(); i++) {
+        const auto &e = entries_[i];
+
+        const bool changed = !base || i >= base->size() || (*base)[i] != e.id;
+        if (!changed && !highlight.count(e.id))
+            continue;
+
+        result.push_back(
+                leaderboard_entry{static_cast<int>(i + 1), e.score, e.name, highlight.count(e.id) ? LEADERBOARD_HIGHLIGHT_FLAG : 0});
+    }
+
+    return result;
+}
+
+//
+//  r e q u e s t   p a r s i n g
+//
+
+struct request
+{
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers; // names in lower case
+};
+
+int hex_value(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+std::string url_decode(const std::string &s)
+{
+    std::string result;
+
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '%' && i + 2 < s.size() && hex_value(s[i + 1]) != -1 && hex_value(s[i + 2]) != -1) {
+            result.push_back(static_cast<char>(hex_value(s[i + 1]) * 16 + hex_value(s[i + 2])));
+            i += 2;
+        } else if (s[i] == '+') {
+            result.push_back(' ');
+        } else {
+            result.push_back(s[i]);
+        }
+    }
+
+    return result;
+}
+
+bool parse_request(const std::string &head, request &req)
+{
+    std::istringstream in(head);
+    std::string line;
+
+    if (!std::getline(in, line))
+        return false;
+
+    std::istringstream request_line(line);
+    std::string target;
+    if (!(request_line >> req.method >> target))
+        return false;
+
+    const size_t query_start = target.find('?');
+    req.path = target.substr(0, query_start);
+
+    if (query_start != std::string::npos) {
+        std::istringstream query(target.substr(query_start + 1));
+        std::string param;
+
+        while (std::getline(query, param, '&')) {
+            const size_t eq = param.find('=');
+            if (eq == std::string::npos)
+                req.query[url_decode(param)] = "";
+            else
+                req.query[url_decode(param.substr(0, eq))] = url_decode(param.substr(eq + 1));
+        }
+    }
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+        size_t value_start = colon + 1;
+        while (value_start < line.size() && line[value_start] == ' ')
+            ++value_start;
+
+        req.headers[name] = line.substr(value_start);
+    }
+
+    return true;
+}
+
+//
+//  c o n n e c t i o n s
+//
+
+class connection : public reactor::handler
+{
+public:
+    connection(reactor &r, leaderboard_store &store, int fd);
+    ~connection();
+
+    void on_ready(int fd, int events) override;
+
+private:
+    bool on_readable();
+    bool on_writeable();
+    void handle_request(const request &req);
+    void update_watch();
+
+    reactor &reactor_;
+    leaderboard_store &store_;
+    int fd_;
+    std::string in_;
+    std::string out_;
+    bool close_after_write_;
+};
+
+connection::connection(reactor &r, leaderboard_store &store, int fd)
+    : reactor_(r)
+    , store_(store)
+    , fd_(fd)
+    , close_after_write_(false)
+{
+    update_watch();
+}
+
+connection::~connection()
+{
+    reactor_.unwatch(fd_);
+    close(fd_);
+}
+
+void connection::update_watch()
+{
+    reactor_.watch(fd_, out_.empty() ? reactor::READABLE : reactor::WRITEABLE, this);
+}
+
+void connection::on_ready(int, int events)
+{
+    bool ok = true;
+
+    if (ok && (events & reactor::READABLE))
+        ok = on_readable();
+
+    if (ok && !out_.empty())
+        ok = on_writeable();
+
+    if (!ok || (close_after_write_ && out_.empty())) {
+        delete this;
+        return;
+    }
+
+    update_watch();
+}
+
+bool connection::on_readable()
+{
+    char buf[4096];
+
+    ssize_t n = recv(fd_, buf, sizeof buf, 0);
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+    if (n == 0)
+        return false;
+
+    in_.append(buf, n);
+
+    size_t end;
+    while (!close_after_write_ && (end = in_.find("\r\n\r\n")) != std::string::npos) {
+        request req;
+        if (!parse_request(in_.substr(0, end), req))
+            return false;
+        in_.erase(0, end + 4);
+
+        handle_request(req);
+    }
+
+    return in_.size() < MAX_REQUEST_SIZE;
+}
+
+bool connection::on_writeable()
+{
+    ssize_t n = send(fd_, out_.data(), out_.size(), MSG_NOSIGNAL);
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+
+    out_.erase(0, n);
+    return true;
+}
+
+void connection::handle_request(const request &req)
+{
+    const auto header = [&req](const char *name) {
+        auto it = req.headers.find(name);
+        return it != req.headers.end() ? it->second : std::string();
+    };
+
+    const auto param = [&req](const std::string &name) {
+        auto it = req.query.find(name);
+        return it != req.query.end() ? it->second : std::string();
+    };
+
+    close_after_write_ = header("connection") == "close";
+
+    int status = 200;
+    std::string content_type = "text/plain";
+    std::string body;
+
+    if (req.method != "GET") {
+        status = 405;
+    } else {
+        // submissions, either the original single one or a batch
+        std::set<uint64_t> inserted;
+
+        if (!param("score").empty()) {
+            if (uint64_t id = store_.insert("", atoi(param("score").c_str()), param("name")))
+                inserted.insert(id);
+        }
+
+        const int count = atoi(param("count").c_str());
+        for (int i = 0; i < count; i++) {
+            const std::string n = std::to_string(i);
+            if (uint64_t id = store_.insert(param("key" + n), atoi(param("score" + n).c_str()), param("name" + n)))
+                inserted.insert(id);
+        }
+
+        store_.commit();
+
+        uint32_t base_version = 0;
+        const std::string etag = header("if-none-match");
+        if (etag.size() > 2 && etag.front() == '"' && etag.back() == '"')
+            base_version = strtoul(etag.substr(1, etag.size() - 2).c_str(), nullptr, 10);
+
+        const bool binary = header("accept").find(BINARY_CONTENT_TYPE) != std::string::npos;
+
+        if (base_version == store_.get_version() && inserted.empty()) {
+            status = 304;
+        } else if (binary) {
+            content_type = BINARY_CONTENT_TYPE;
+            const auto entries = store_.get_entries(base_version, inserted);
+            encode_leaderboard(body, store_.get_version(), base_version, store_.size(), entries);
+        } else {
+            uint32_t full = 0;
+            for (const auto &e : store_.get_entries(full, inserted))
+                body += std::to_string(e.score) + ':' + e.name + ':' + (e.flags ? '1' : '0') + '\n';
+        }
+    }
+
+    std::ostringstream ss;
+
+    ss << "HTTP/1.1 " << status << (status == 200 ? " OK" : status == 304 ? " Not Modified" : " Error") << "\r\n";
+    ss << "Content-Type: " << content_type << "\r\n";
+    ss << "ETag: \"" << store_.get_version() << "\"\r\n";
+    if (status != 304)
+        ss << "Content-Length: " << body.size() << "\r\n";
+    if (close_after_write_)
+        ss << "Connection: close\r\n";
+    ss << "\r\n";
+
+    out_ += ss.str();
+    out_ += body;
+}
+
+class listener : public reactor::handler
+{
+public:
+    listener(reactor &r, leaderboard_store &store)
+        : reactor_(r)
+        , store_(store)
+    {
+    }
+
+    void on_ready(int fd, int events) override;
+
+private:
+    reactor &reactor_;
+    leaderboard_store &store_;
+};
+
+void listener::on_ready(int fd, int)
+{
+    for (;;) {
+        int client_fd = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                log_err("accept: %s", strerror(errno));
+            break;
+        }
+
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        new connection(reactor_, store_, client_fd);
+    }
+}
+
+int listen_on(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_err("socket: %s", strerror(errno));
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) < 0 || listen(fd, SOMAXCONN) < 0) {
+        log_err("failed to listen on port %d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void raise_fd_limit()
+{
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int port = DEFAULT_PORT;
+    int max_entries = DEFAULT_MAX_ENTRIES;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:n:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                break;
+
+            case 'n':
+                max_entries = atoi(optarg);
+                break;
+
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-n max_entries]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
+
+    int fd = listen_on(port);
+    if (fd < 0)
+        return 1;
+
+    reactor r;
+    leaderboard_store store(max_entries);
+    listener l(r, store);
+
+    r.watch(fd, reactor::READABLE, &l);
+
+    log_debug("listening on 127.0.0.1:%d", port);
+
+    for (;;)
+        r.poll(1000);
+}
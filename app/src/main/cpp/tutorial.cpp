@@ -62,7 +62,7 @@ private:
 
     world world_;
     text_box text_box_;
-    std::unique_ptr<theme_animation> theme_;
+    theme_animation *theme_ = nullptr;
     const color_scheme *colors_;
     float grid_base_x_, grid_base_y_;
 
@@ -374,7 +374,7 @@ void tutorial_state_impl::reset()
 {
     const auto theme_index = rand() % NUM_THEMES;
 
-    theme_ = make_theme(theme_index);
+    theme_ = get_theme(theme_index);
     colors_ = &cur_settings.color_schemes[theme_index];
 
     theme_->reset();
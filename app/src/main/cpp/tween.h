@@ -3,6 +3,16 @@
 
 #include <cmath>
 
+enum class tween_kind
+{
+    linear,
+    quadratic,
+    in_cos,
+    out_cos,
+    in_back,
+    out_bounce,
+};
+
 template <class T>
 struct tween
 {
@@ -12,18 +22,24 @@ struct tween
 template <class T>
 struct linear_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::linear;
+
     T operator()(const T &a, const T &b, float t) const { return a + t * (b - a); }
 };
 
 template <class T>
 struct quadratic_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::quadratic;
+
     T operator()(const T &a, const T &b, float t) const { return a + t * t * (b - a); }
 };
 
 template <class T>
 struct in_cos_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::in_cos;
+
     T operator()(const T &a, const T &b, float t) const
     {
         const float f = cos((1 - t) * .5 * M_PI);
@@ -34,6 +50,8 @@ struct in_cos_tween : tween<T>
 template <class T>
 struct out_cos_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::out_cos;
+
     T operator()(const T &a, const T &b, float t) const
     {
         const float f = 1 - cos(t * .5 * M_PI);
@@ -46,6 +64,8 @@ struct out_cos_tween : tween<T>
 template <class T>
 struct in_back_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::in_back;
+
     T operator()(const T &a, const T &b, float t) const
     {
         const float s = 1.70158;
@@ -56,6 +76,8 @@ struct in_back_tween : tween<T>
 template <class T>
 struct out_bounce_tween : tween<T>
 {
+    static constexpr tween_kind kind = tween_kind::out_bounce;
+
     T operator()(const T &a, const T &b, float t) const
     {
         float f;
@@ -1,7 +1,15 @@
 #include "utils.h"
 
+#include "log.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <functional>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 std::wstring format_number(int n)
 {
     std::wstring result;
@@ -29,3 +37,44 @@ std::wstring format_number(int n)
 
     return result;
 }
+
+bool write_file_atomically(const std::string &path, const void *data, size_t size)
+{
+    const std::string temp_path = path + ".tmp";
+
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        log_err("failed to open %s: %s", temp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = true;
+
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t rv = write(fd, p, size);
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+            ok = false;
+            break;
+        }
+
+        p += rv;
+        size -= rv;
+    }
+
+    if (ok && fsync(fd) < 0)
+        ok = false;
+
+    if (close(fd) < 0)
+        ok = false;
+
+    if (!ok || rename(temp_path.c_str(), path.c_str()) < 0) {
+        log_err("failed to write %s: %s", path.c_str(), strerror(errno));
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 std::wstring format_number(int n);
+
+// Writes to a temporary file that's synced and renamed over path, so readers
+// see either the old contents or the new ones, even after a crash.
+bool write_file_atomically(const std::string &path, const void *data, size_t size);
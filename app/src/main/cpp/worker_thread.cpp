@@ -0,0 +1,68 @@
+#include "worker_thread.h"
+
+#include <cassert>
+
+worker_thread::worker_thread()
+    : busy_(false)
+    , quit_(false)
+{
+    thread_ = std::thread(&worker_thread::run, this);
+}
+
+worker_thread::~worker_thread()
+{
+    // a job may end the program with exit(), which gets us here on our own
+    // thread; nothing is left to wait for then
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        thread_.detach();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    cond_.notify_all();
+
+    thread_.join();
+}
+
+void worker_thread::start(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(!busy_);
+        job_ = std::move(job);
+        busy_ = true;
+    }
+    cond_.notify_all();
+}
+
+void worker_thread::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !busy_; });
+}
+
+void worker_thread::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        cond_.wait(lock, [this] { return quit_ || busy_; });
+
+        // finish a started job even when quitting, the owner may be waiting for it
+        if (busy_) {
+            auto job = std::move(job_);
+
+            lock.unlock();
+            job();
+            lock.lock();
+
+            busy_ = false;
+            cond_.notify_all();
+        } else if (quit_) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs one job at a time on its own thread. The owner starts a job and later
+// waits for it; in between the two threads must not share anything the job
+// touches.
+
+class worker_thread : private noncopyable
+{
+public:
+    worker_thread();
+    ~worker_thread();
+
+    // the previous job must have been waited for
+    void start(std::function<void()> job);
+
+    // blocks until the current job, if any, is done
+    void wait();
+
+private:
+    void run();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::function<void()> job_;
+    bool busy_;
+    bool quit_;
+};
@@ -9,6 +9,7 @@
 #include "bakudan_sprite.h"
 #include "combo_sprite.h"
 #include "common.h"
+#include "effect_pool.h"
 #include "hint_animation.h"
 #include "jukugo.h"
 #include "jukugo_info_sprite.h"
@@ -70,7 +71,7 @@ bool rand_bakudan()
     return (rand() % cur_settings.game.bakudan_period) == 0;
 }
 
-class dead_block_sprite : public sprite
+class dead_block_sprite final : public sprite
 {
 public:
     dead_block_sprite(const g2d::vec2 &pos, float cell_size, const g2d::texture *texture, const g2d::vec2 &uv0,
@@ -134,7 +135,7 @@ void dead_block_sprite::draw() const
     render::draw_box(texture_, {{x0, y0}, {x1, y1}}, {{u0, v1}, {u1, v0}}, 10);
 }
 
-class drop_trail_sprite : public sprite
+class drop_trail_sprite final : public sprite
 {
 public:
     drop_trail_sprite(const g2d::vec2 &pos, float cell_size, const g2d::texture *texture, const g2d::vec2 &uv0,
@@ -206,7 +207,7 @@ void drop_trail_sprite::draw() const
     }
 }
 
-class explosion_particles : public sprite
+class explosion_particles final : public sprite
 {
 public:
     explosion_particles(const g2d::vec2 &pos, const gradient& g);
@@ -314,6 +315,52 @@ void explosion_particles::draw() const
 
 } // anonymous namespace
 
+struct world::effects
+{
+    void update(uint32_t dt)
+    {
+        dead_blocks.update(dt);
+        drop_trails.update(dt);
+        explosions.update(dt);
+        bakudans.update(dt);
+        jukugo_infos.update(dt);
+        combos.update(dt);
+    }
+
+    void draw() const
+    {
+        dead_blocks.draw();
+        drop_trails.draw();
+        explosions.draw();
+        bakudans.draw();
+        jukugo_infos.draw();
+        combos.draw();
+    }
+
+    void clear()
+    {
+        dead_blocks.clear();
+        drop_trails.clear();
+        explosions.clear();
+        bakudans.clear();
+        jukugo_infos.clear();
+        combos.clear();
+    }
+
+    bool empty() const
+    {
+        return dead_blocks.empty() && drop_trails.empty() && explosions.empty() && bakudans.empty() &&
+               jukugo_infos.empty() && combos.empty();
+    }
+
+    effect_pool<dead_block_sprite> dead_blocks;
+    effect_pool<drop_trail_sprite> drop_trails;
+    effect_pool<explosion_particles> explosions;
+    effect_pool<bakudan_sprite> bakudans;
+    effect_pool<jukugo_info_sprite> jukugo_infos;
+    effect_pool<combo_sprite, 4> combos;
+};
+
 void world_init()
 {
     initialize_match_map();
@@ -597,7 +644,10 @@ world::world(int rows, int cols, int wanted_height)
     , blocks_texture_(g2d::load_texture("images/blocks.png"))
     , flare_texture_(g2d::load_texture("images/flare.png"))
     , program_grid_background_(get_program(program::grid_background))
+    , grid_layer_(new render::offscreen_layer("grid"))
+    , settled_blocks_(rows_ * cols_, 0)
     , falling_block_queue_{*this, *this}
+    , effects_(new effects)
     , event_listener_(nullptr)
 {
     const float wanted_cell_size = wanted_height / rows_;
@@ -617,7 +667,8 @@ void world::reset()
 {
     score_ = 0;
 
-    sprites_.clear();
+    effects_->clear();
+    hint_box_.reset();
 }
 
 void world::set_level(int level, bool practice_mode, bool enable_hints)
@@ -786,7 +837,7 @@ bool world::find_matches()
 
                         const float x = (c + 1) * cell_size_;
                         const float y = (r + .5) * cell_size_ + y_offset;
-                        sprites_.emplace_front(new jukugo_info_sprite(p, x, y, text_gradient_));
+                        effects_->jukugo_infos.spawn(p, x, y, text_gradient_);
 
                         if (!practice_mode_)
                             p->hits++;
@@ -803,7 +854,7 @@ bool world::find_matches()
 
                         const float x = (c + .5) * cell_size_;
                         const float y = r * cell_size_ + y_offset;
-                        sprites_.emplace_front(new jukugo_info_sprite(p, x, y, text_gradient_));
+                        effects_->jukugo_infos.spawn(p, x, y, text_gradient_);
 
                         if (!practice_mode_)
                             p->hits++;
@@ -830,9 +881,9 @@ bool world::find_matches()
                 const float y = (r + .5) * cell_size_;
 
                 if ((grid_[i] & BAKUDAN_FLAG))
-                    sprites_.emplace_front(new bakudan_sprite(x, y));
+                    effects_->bakudans.spawn(x, y);
 
-                sprites_.emplace_front(new explosion_particles(g2d::vec2(x, y), text_gradient_));
+                effects_->explosions.spawn(g2d::vec2(x, y), text_gradient_);
             }
         }
 
@@ -918,7 +969,7 @@ void world::solve_matches()
     }
 
     if (combo_size_ > 1)
-        sprites_.emplace_back(new combo_sprite(combo_size_, 0, .6 * rows_ * cell_size_, text_gradient_));
+        effects_->combos.spawn(combo_size_, 0, .6 * rows_ * cell_size_, text_gradient_);
 }
 
 bool world::has_hanging_blocks() const
@@ -1009,7 +1060,7 @@ void world::set_state_falling_block_or_hint()
         else
             box->set_pos(g2d::vec2(base_x, to_pos.y - cell_size_ - .5 * box->get_height()));
 
-        sprites_.emplace_front(box);
+        hint_box_.reset(box);
 
         set_state(STATE_HINT);
     } else {
@@ -1046,7 +1097,7 @@ bool world::on_up_pressed()
     if (cur_state_ == STATE_FALLING_BLOCK) {
         return CUR_FALLING_BLOCK->on_up_pressed();
     } else if (cur_state_ == STATE_HINT) {
-        return static_cast<hint_text_box *>(sprites_.front().get())->close();
+        return hint_box_ && hint_box_->close();
     } else {
         return false;
     }
@@ -1076,15 +1127,15 @@ void world::set_game_over()
 
 void world::update_animations(uint32_t dt)
 {
-    auto it = sprites_.begin();
+    effects_->update(dt);
 
-    while (it != sprites_.end()) {
-        if (!(*it)->update(dt)) {
-            it = sprites_.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    if (hint_box_ && !hint_box_->update(dt))
+        hint_box_.reset();
+}
+
+bool world::has_sprites() const
+{
+    return hint_box_ || !effects_->empty();
 }
 
 void world::update(uint32_t dt)
@@ -1099,7 +1150,7 @@ void world::update(uint32_t dt)
             break;
 
         case STATE_HINT:
-            if (sprites_.empty())
+            if (!has_sprites())
                 set_state_falling_block();
             break;
 
@@ -1167,7 +1218,7 @@ void world::update(uint32_t dt)
 				}
 			}
 #else
-            if (sprites_.empty()) {
+            if (!has_sprites()) {
                 if (is_game_over()) {
                     set_state(STATE_GAME_OVER);
                 } else if (is_level_completed()) {
@@ -1191,41 +1242,91 @@ void world::update(uint32_t dt)
 void world::draw() const
 {
     render::set_blend_mode(blend_mode::ALPHA_BLEND);
-    draw_background();
+    draw_grid();
     draw_blocks();
 
     if (cur_state_ == STATE_FLARES)
         draw_flares();
 
-    for (const auto& p : sprites_)
-        p->draw();
+    if (hint_box_)
+        hint_box_->draw();
+
+    effects_->draw();
 }
 
-void world::draw_blocks() const
+void world::draw_grid() const
 {
+    update_settled_blocks();
+
+    render::draw_offscreen_layer(*grid_layer_, {{0, 0}, {get_width(), get_height()}}, -20, [this] {
+        draw_background();
+        draw_settled_blocks();
+    });
+}
+
+void world::update_settled_blocks() const
+{
+    const auto same_color = [](const g2d::rgb &a, const g2d::rgb &b) {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+    };
+
+    bool changed =
+            !same_color(settled_colors_[0], theme_color_) || !same_color(settled_colors_[1], theme_opposite_color_);
+
+    settled_colors_[0] = theme_color_;
+    settled_colors_[1] = theme_opposite_color_;
+
     for (int c = 0; c < cols_; c++) {
-        const float x = c * cell_size_;
+        bool hanging = false;
 
         for (int r = 0; r < rows_; r++) {
-            const float y = r * cell_size_;
+            int t = get_block_at(r, c);
 
-            if (int t = get_block_at(r, c)) {
-                if (cur_state_ == STATE_HINT && r == hint_r_ && c == hint_c_) {
-                    // OMG HACK
-                    const float alpha = static_cast<hint_text_box *>(sprites_.front().get())->get_alpha();
-                    const g2d::rgb base_color = !(t & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_;
-                    const g2d::rgb color = (1. - alpha) * base_color + alpha * g2d::rgb(1, 1, 1);
-                    draw_block(t - 1, x, y, 1, color);
-                } else {
-                    draw_block(t - 1, x, y, 1);
-                }
-            } else {
-                if (cur_state_ == STATE_DROPPING_HANGING)
-                    break;
+            // blocks above a gap are drawn as they drop, and the hinted one
+            // as it's highlighted
+            if (!t && cur_state_ == STATE_DROPPING_HANGING)
+                hanging = true;
+
+            if (hanging || (cur_state_ == STATE_HINT && hint_box_ && r == hint_r_ && c == hint_c_))
+                t = 0;
+
+            auto &settled = settled_blocks_[r * cols_ + c];
+            if (settled != t) {
+                settled = t;
+                changed = true;
             }
         }
     }
 
+    if (changed)
+        grid_layer_->invalidate();
+}
+
+void world::draw_settled_blocks() const
+{
+    for (int r = 0; r < rows_; r++) {
+        const float y = r * cell_size_;
+
+        for (int c = 0; c < cols_; c++) {
+            const float x = c * cell_size_;
+
+            if (int t = settled_blocks_[r * cols_ + c])
+                draw_block(t - 1, x, y, 1);
+        }
+    }
+}
+
+void world::draw_blocks() const
+{
+    if (cur_state_ == STATE_HINT && hint_box_) {
+        if (int t = get_block_at(hint_r_, hint_c_)) {
+            const float alpha = hint_box_->get_alpha();
+            const g2d::rgb base_color = !(t & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_;
+            const g2d::rgb color = (1. - alpha) * base_color + alpha * g2d::rgb(1, 1, 1);
+            draw_block(t - 1, hint_c_ * cell_size_, hint_r_ * cell_size_, 1, color);
+        }
+    }
+
     if (cur_state_ == STATE_FALLING_BLOCK && CUR_FALLING_BLOCK->get_is_active())
         CUR_FALLING_BLOCK->draw();
 
@@ -1446,9 +1547,15 @@ void world::drop_hanging_blocks()
 
 void world::draw_background() const
 {
-    program_grid_background_->use();
-    program_grid_background_->set_uniform("highlight_position", g2d::vec2(-.1 * cols_ * cell_size_, 1.1 * rows_ * cell_size_));
-    program_grid_background_->set_uniform_f("highlight_fade_factor", .5f * cols_ * cell_size_);
+    const auto program = program_grid_background_;
+    const g2d::vec2 highlight_position(-.1 * cols_ * cell_size_, 1.1 * rows_ * cell_size_);
+    const float highlight_fade_factor = .5f * cols_ * cell_size_;
+
+    render::defer([program, highlight_position, highlight_fade_factor] {
+        program->use();
+        program->set_uniform("highlight_position", highlight_position);
+        program->set_uniform_f("highlight_fade_factor", highlight_fade_factor);
+    });
 
     render::set_color({.8 * theme_color_, 1});
 
@@ -1518,8 +1625,8 @@ void world::spawn_drop_trail(int row, int col, int type)
     g2d::vec2 uv0(su * t.u0, sv * t.v0);
     g2d::vec2 uv1(su * t.u1, sv * t.v1);
 
-    sprites_.emplace_front(new drop_trail_sprite(cell_size_ * g2d::vec2(col, row), cell_size_, blocks_texture_, uv0, uv1,
-                                              !(type & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_));
+    effects_->drop_trails.spawn(cell_size_ * g2d::vec2(col, row), cell_size_, blocks_texture_, uv0, uv1,
+                                !(type & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_);
 }
 
 void world::spawn_dead_block_sprite(const g2d::vec2 &pos, int type)
@@ -1533,6 +1640,6 @@ void world::spawn_dead_block_sprite(const g2d::vec2 &pos, int type)
     g2d::vec2 uv0(su * t.u0, sv * t.v0);
     g2d::vec2 uv1(su * t.u1, sv * t.v1);
 
-    sprites_.emplace_front(new dead_block_sprite(pos, cell_size_, blocks_texture_, uv0, uv1,
-                                              !(type & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_));
+    effects_->dead_blocks.spawn(pos, cell_size_, blocks_texture_, uv0, uv1,
+                                !(type & BAKUDAN_FLAG) ? theme_color_ : theme_opposite_color_);
 }
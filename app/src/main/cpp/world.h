@@ -6,7 +6,6 @@
 #include <guava2d/vec2.h>
 
 #include <memory>
-#include <list>
 #include <vector>
 
 #include <cassert>
@@ -22,6 +21,10 @@ class texture;
 class program;
 };
 
+namespace render {
+class offscreen_layer;
+}
+
 enum
 {
     BAKUDAN_FLAG = 0x80,
@@ -29,6 +32,7 @@ enum
 
 class world;
 class jukugo;
+class hint_text_box;
 
 class falling_block
 {
@@ -227,7 +231,10 @@ public:
 private:
     bool get_hint(hint &h) const;
 
+    void draw_grid() const;
+    void update_settled_blocks() const;
     void draw_background() const;
+    void draw_settled_blocks() const;
     void draw_blocks() const;
     void draw_flares() const;
 
@@ -265,6 +272,8 @@ private:
 
     void set_falling_block_on_listener(const falling_block &p) const;
 
+    bool has_sprites() const;
+
     bool practice_mode_;
     bool enable_hints_;
 
@@ -281,6 +290,12 @@ private:
 
     const g2d::program *program_grid_background_;
 
+    // the grid background and the blocks at rest, redrawn only when these
+    // change
+    std::unique_ptr<render::offscreen_layer> grid_layer_;
+    mutable std::vector<int> settled_blocks_; // as in grid_, 0 where nothing is drawn
+    mutable g2d::rgb settled_colors_[2];
+
     game_state cur_state_;
     int state_tics_;
 
@@ -306,7 +321,9 @@ private:
 
     int hint_r_, hint_c_;
 
-    std::list<std::unique_ptr<sprite>> sprites_;
+    struct effects;
+    std::unique_ptr<effects> effects_;
+    std::unique_ptr<hint_text_box> hint_box_;
 
     world_event_listener *event_listener_;
 